@@ -0,0 +1,57 @@
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3, same as zlib) used by frames and image checks
+ *
+ * Three engines give the same crc, CRC32_ENGINE picks the one behind
+ * crc32_update(): the CRC unit (buffers fed by DMA), a 1 KB byte table, or
+ * a 64 byte nibble table when flash is short.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC32_INIT          (0xFFFFFFFFUL)
+#define CRC32_XOROUT        (0xFFFFFFFFUL)
+
+#define CRC32_ENGINE_NIBBLE (0)     /* 16 entry table, two lookups per byte */
+#define CRC32_ENGINE_TABLE  (1)     /* 256 entry table, one lookup per byte */
+#define CRC32_ENGINE_HW     (2)     /* CRC unit, crc32_hw.c */
+
+#ifndef CRC32_ENGINE
+#if defined(HOST_SIM)
+#define CRC32_ENGINE        CRC32_ENGINE_TABLE
+#else
+#define CRC32_ENGINE        CRC32_ENGINE_HW
+#endif
+#endif
+
+/** Continue a running crc, start with CRC32_INIT */
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+/** Finalize a running crc */
+uint32_t crc32_final(uint32_t crc);
+
+/** One shot crc of a buffer */
+uint32_t crc32_compute(const uint8_t *data, size_t len);
+
+/** crc of A followed by B from the final crcs of A and B, len2 bytes of B; nothing is read again */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+/* engines, crc32_update() calls the selected one */
+uint32_t crc32_update_nibble(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32_update_table(uint32_t crc, const uint8_t *data, size_t len);
+
+/** Clock the CRC unit and DMA1, before the first crc32_update_hw(), the fast path included */
+void crc32_hw_init(void);
+
+/**
+ * CRC unit: bytes up to a word boundary and the tail are written by the
+ * core, the aligned words by DMA memory to memory from CRC32_HW_DMA_MIN
+ * bytes. Blocking, not reentrant, main loop only.
+ */
+uint32_t crc32_update_hw(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif
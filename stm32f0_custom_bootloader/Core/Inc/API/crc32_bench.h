@@ -0,0 +1,35 @@
+/**
+ * @file crc32_bench.h
+ * @brief Cycles per KB of each crc32 engine, over flash and over SRAM.
+ */
+
+#ifndef CRC32_BENCH_H
+#define CRC32_BENCH_H
+
+#include <stdint.h>
+
+/* build with CRC32_BENCH=1, runs at startup and prints on the debug port */
+#ifndef CRC32_BENCH
+#define CRC32_BENCH                     (0)
+#endif
+
+#define CRC32_BENCH_BYTES               (8192)  /* of the bootloader image, from flash */
+#define CRC32_BENCH_RAM_BYTES           (2048)  /* a page buffer, from SRAM */
+
+typedef struct
+{
+    const char *name;
+    uint32_t flash_cycles;      /* per KB, read from flash (1 wait state) */
+    uint32_t ram_cycles;        /* per KB, read from SRAM */
+} crc32_bench_engine_t;
+
+typedef struct
+{
+    crc32_bench_engine_t engine[3];     /* nibble, table, hw */
+    uint32_t mismatches;        /* engines that disagree with the nibble table */
+} crc32_bench_t;
+
+void crc32_bench_run(crc32_bench_t *bench);
+void crc32_bench_report(crc32_bench_t *bench);
+
+#endif
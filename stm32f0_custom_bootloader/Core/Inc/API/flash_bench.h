@@ -0,0 +1,28 @@
+/**
+ * @file flash_bench.h
+ * @brief Page program time, HAL_FLASH_Program() loop against flash_driver_program().
+ */
+
+#ifndef FLASH_BENCH_H
+#define FLASH_BENCH_H
+
+#include <stdint.h>
+
+/* build with FLASH_BENCH=1, erases and programs the last flash page (delta scratch) at startup */
+#ifndef FLASH_BENCH
+#define FLASH_BENCH                     (0)
+#endif
+
+#define FLASH_BENCH_PAGES               (4)     /* pages programmed per method, averaged */
+
+typedef struct
+{
+    uint32_t hal_us;            /* one 2 KB page with HAL_FLASH_Program(), half-word per call */
+    uint32_t driver_us;         /* one 2 KB page with flash_driver_program(), PG set once */
+    uint32_t errors;            /* runs that failed or read back wrong */
+} flash_bench_t;
+
+void flash_bench_run(flash_bench_t *bench);
+void flash_bench_report(flash_bench_t *bench);
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @file flash_driver.h
+ * @brief Internal flash erase/program driver (STM32F030xC, 2 KB pages)
+ */
+
+#ifndef FLASH_DRIVER_H
+#define FLASH_DRIVER_H
+
+#include <stdint.h>
+
+#define FLASH_DRV_BASE_ADDR         (0x08000000UL)
+#define FLASH_DRV_SIZE              (256UL * 1024UL)
+#define FLASH_DRV_END_ADDR          (FLASH_DRV_BASE_ADDR + FLASH_DRV_SIZE)
+#define FLASH_DRV_PAGE_SIZE         (2048UL)
+#define FLASH_DRV_ERASED_HALFWORD   (0xFFFFU)
+
+typedef enum
+{
+    FLASH_DRV_OK = 0x00,
+    FLASH_DRV_ERROR,            /* PGERR / WRPRTERR reported by the controller */
+    FLASH_DRV_BAD_ADDRESS,      /* out of flash, or not page/half-word aligned */
+    FLASH_DRV_BUSY,             /* an operation started earlier is still running */
+} flash_drv_st_t;
+
+/** Erase consecutive pages starting at a page aligned address */
+flash_drv_st_t flash_driver_erase(uint32_t address, uint32_t pages);
+
+/** Start erasing one page and return, flash_driver_poll() tells when it is done */
+flash_drv_st_t flash_driver_erase_start(uint32_t address);
+
+/** State of the operation started by flash_driver_erase_start() */
+flash_drv_st_t flash_driver_poll(void);
+
+/** Program half-words, address aligned to 2 and even length, target must be erased */
+flash_drv_st_t flash_driver_program(uint32_t address, const uint8_t *data, uint32_t len);
+
+/** Pointer to read flash contents at an address */
+const uint8_t *flash_driver_map(uint32_t address);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+ * @file irq_latency.h
+ * @brief Worst case rx interrupt entry latency instrumentation.
+ */
+
+#ifndef IRQ_LATENCY_H
+#define IRQ_LATENCY_H
+
+#include <stdint.h>
+#include "stm32f0xx_hal.h"
+
+typedef struct
+{
+    uint32_t byte_cycles;       /* one byte on the wire in core cycles */
+    uint32_t last_entry;        /* timestamp of the previous rx entry */
+    uint32_t worst_cycles;      /* worst entry delay over the back-to-back best case */
+    uint32_t samples;           /* back-to-back bytes measured */
+    uint32_t overruns;          /* entries that found ORE set, delay above one byte */
+} irq_latency_t;
+
+void irq_latency_init(irq_latency_t *trace, UART_HandleTypeDef *huart);
+void irq_latency_rx_entry(irq_latency_t *trace, UART_HandleTypeDef *huart);
+void irq_latency_report(irq_latency_t *trace);
+
+#endif
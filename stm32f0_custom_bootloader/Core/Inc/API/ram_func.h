@@ -0,0 +1,24 @@
+/**
+ * @file ram_func.h
+ * @brief Placement of the code that must keep running while the flash is busy
+ *
+ * @note  On the F030 any fetch from flash stalls the core until the flash
+ *        controller is done: ~30 ms for a page erase, ~50 us per half-word.
+ *        Interrupts are not taken either, their vector and handler are
+ *        fetched from flash too. Functions marked RAM_FUNC go to .RamFunc,
+ *        copied to SRAM with .data by the startup code (see
+ *        STM32F030CCTX_FLASH.ld). They must not call into flash while it is
+ *        busy, integer division included: the M0 has no divide instruction
+ *        and __aeabi_uidiv lives in flash.
+ */
+
+#ifndef RAM_FUNC_H
+#define RAM_FUNC_H
+
+#if defined(__arm__)
+#define RAM_FUNC        __attribute__((section(".RamFunc"), long_call, noinline))
+#else
+#define RAM_FUNC        /* host build */
+#endif
+
+#endif
@@ -3,9 +3,30 @@
 
 #include "circular_buffer.h"
 #include "stm32f0xx_hal.h"
+#include "ram_func.h"
 
 #define MAX_DATA_CHUNK_SIZE           (20) 
 
+/* Software flow control (XON/XOFF) */
+#define UART_XON_CHAR                 (0x11)
+#define UART_XOFF_CHAR                (0x13)
+#define UART_ESC_CHAR                 (0x7D)   /* binary mode: ESC, byte ^ UART_ESC_MASK */
+#define UART_ESC_MASK                 (0x20)
+
+typedef struct
+{
+    uint8_t enabled;                /* in-band XON/XOFF active on this link */
+    uint8_t binary;                 /* escape XON/XOFF/ESC data bytes on the wire */
+    uint16_t high_watermark;        /* rx ring level that sends XOFF */
+    uint16_t low_watermark;         /* rx ring level that sends XON again */
+    volatile uint8_t rx_paused;     /* XOFF sent, peer must stop */
+    volatile uint8_t tx_paused;     /* XOFF received, we must stop */
+    volatile uint8_t hold;          /* peer paused on request, e.g. flash erase */
+    volatile uint8_t rx_escaped;    /* previous rx byte was UART_ESC_CHAR */
+    volatile uint8_t ctrl_pending;  /* XON/XOFF waiting for the transmitter */
+    uint8_t ctrl_byte;              /* XON/XOFF being transmitted */
+} uart_flow_t;
+
 
 typedef struct
 {
@@ -14,12 +35,19 @@ typedef struct
         uint8_t *buffer;        /* Received Data over UART are stored in this buffer */
         c_buff_handle_t cb;     /* pointer typedef to circular buffer struct */
         uint8_t byte;           /* used to active RX reception interrupt mode */ 
+        uint8_t *stash;         /* bytes taken by the SRAM rx path while the flash is busy, NULL if none */
+        uint16_t stash_mask;    /* stash size - 1, the size is a power of 2 */
+        volatile uint16_t stash_head;
+        volatile uint16_t stash_tail;
+        volatile uint32_t stash_overruns;   /* bytes dropped, stash full */
     } rx;
 
     struct
     {
         uint8_t *buffer;       /* Data to be transmitted via UART are stored in this buffer */
         c_buff_handle_t cb;    /* pointer typedef to circular buffer struct */
+        uint8_t chunk[MAX_DATA_CHUNK_SIZE]; /* data chunk being transmitted in it mode */
+        volatile uint32_t parked;   /* TXEIE / TCIE masked by the SRAM path while the flash was busy */
     } tx;
 
 }uart_data_t;
@@ -31,6 +59,7 @@ typedef struct
 typedef struct
 {
     uart_data_t data;
+    uart_flow_t flow;
     UART_HandleTypeDef handle;
     
 }uart_driver_t;
@@ -38,12 +67,20 @@ typedef struct
 
 uint8_t uart_init_it(uart_driver_t *driver, uint8_t *rx_buff, uint16_t rx_len,
                      uint8_t *tx_buff, uint16_t tx_len);
-uint8_t uart_get_rx_data_len(uart_driver_t *driver);
+uint8_t uart_set_baudrate(uart_driver_t *driver, uint32_t baudrate);
+uint16_t uart_get_rx_data_len(uart_driver_t *driver);
 uint8_t uart_read_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_fetch_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_clear_rx_data(uart_driver_t *driver);
 uint8_t uart_transmit(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len);
+uint8_t uart_tx_idle(uart_driver_t *driver);
 uint8_t uart_write_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
+void uart_flow_control_init(uart_driver_t *driver, uint8_t binary, uint16_t low_watermark, uint16_t high_watermark);
+void uart_flow_hold(uart_driver_t *driver, uint8_t hold);
+void uart_rx_stash_init(uart_driver_t *driver, uint8_t *buffer, uint16_t size);
+RAM_FUNC void uart_rx_stash_put(uart_driver_t *driver, uint8_t byte);
+RAM_FUNC void uart_tx_park(uart_driver_t *driver);
+void uart_tx_resume(uart_driver_t *driver);
 
 #endif
\ No newline at end of file
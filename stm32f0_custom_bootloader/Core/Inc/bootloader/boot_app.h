@@ -0,0 +1,56 @@
+/**
+ * @file boot_app.h
+ * @brief "User App Integrity ok?": the user app against its metadata record
+ */
+
+#ifndef BOOT_APP_H
+#define BOOT_APP_H
+
+#include <stdint.h>
+#include "boot_meta.h"
+
+typedef enum
+{
+    BOOT_APP_MISSING = 0x00,    /* no valid metadata record, no image header */
+    BOOT_APP_CORRUPT,           /* vectors or image crc do not match the record / header */
+    BOOT_APP_VALID,
+    BOOT_APP_INCOMPATIBLE,      /* image header asks for a newer bootloader */
+} boot_app_status_t;
+
+typedef struct
+{
+    boot_app_status_t status;
+    boot_meta_t meta;
+    uint8_t scanned;            /* the whole image was read, record not verified before */
+} boot_app_t;
+
+/**
+ * Check the record and the app vectors (initial SP in SRAM, reset handler
+ * in the image, thumb). The image crc is only computed if the record was
+ * never verified, a match then marks it verified. An image header is
+ * looked up at its fixed offset: its entry has to be the reset handler and
+ * its bootloader version met. Without a record, an app flashed some other
+ * way is taken over once its crc matches the header.
+ */
+boot_app_status_t boot_app_check(boot_app_t *app);
+
+/**
+ * Load the app initial SP and branch to its reset handler, target only.
+ * Meant for a core fresh from reset or the end of boot_app_handoff(): only
+ * the AHB clocks are put back, nothing else is torn down.
+ */
+void boot_app_jump(const boot_app_t *app) __attribute__((noreturn));
+
+/**
+ * Start a valid app from a running bootloader, once peripherals_deinit()
+ * has undone peripherals_init(): SysTick stopped, every NVIC line disabled
+ * and its pending bit cleared, flash mapped at 0x00000000 again, then
+ * boot_app_jump(). The latency from start_us is left in the RAM mailbox.
+ * On the host sim it soft-resets.
+ */
+void boot_app_handoff(const boot_app_t *app, uint32_t start_us) __attribute__((noreturn));
+
+/** Microseconds since reset, HAL tick and SysTick count */
+uint32_t boot_app_time_us(void);
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file boot_config.h
+ * @brief Bootloader memory map and protocol timing
+ *
+ *  0x08000000 +-----------------------+
+ *             | bootloader (28 KB)    |
+ *  0x08007000 +-----------------------+
+ *             | metadata (2 pages)    |  record log: image CRC and length, boot flag
+ *  0x08008000 +-----------------------+
+ *             | user app (222 KB)     |  stm32f0_dummy_app
+ *  0x0803F800 +-----------------------+
+ *             | scratch (1 page)      |  delta update: page copy before its erase
+ *  0x08040000 +-----------------------+
+ */
+
+#ifndef BOOT_CONFIG_H
+#define BOOT_CONFIG_H
+
+#include "flash_driver.h"
+
+#define BOOT_META_START_ADDR            (0x08007000UL)
+#define BOOT_META_PAGES                 (2)
+
+#define BOOT_SCRATCH_ADDR               (FLASH_DRV_END_ADDR - FLASH_DRV_PAGE_SIZE)
+
+#define BOOT_APP_START_ADDR             (0x08008000UL)
+#define BOOT_APP_END_ADDR               (BOOT_SCRATCH_ADDR)
+#define BOOT_APP_MAX_SIZE               (BOOT_APP_END_ADDR - BOOT_APP_START_ADDR)
+#define BOOT_APP_PAGES                  (BOOT_APP_MAX_SIZE / FLASH_DRV_PAGE_SIZE)
+
+/* major (8), minor (8), patch (8): ENTER_BOOT_OK, image headers name the oldest they run on */
+#define BOOT_VERSION                    (0x00010000UL)
+
+/* SRAM the app initial stack pointer must point into */
+#define BOOT_RAM_START                  (0x20000000UL)
+#define BOOT_RAM_END                    (0x20008000UL)
+
+/*
+ * 1: the rx interrupt path runs from flash, the core stalls while the flash
+ * is busy and bytes arriving during an erase are lost. Erases then wait for
+ * a silent link (receive window held).
+ * 0: vectors, link rx interrupt and flash loops run from SRAM (ram_func.h),
+ * bytes received meanwhile go to the link rx stash, sized for a page erase
+ * up to 230400 baud.
+ */
+#define BOOT_FLASH_STALLS_RX            (0)
+
+/*
+ * 1: in-band XON/XOFF on the gateway link, for 2-wire links without
+ * RTS/CTS; binary data is escaped both ways and the gateway has to run the
+ * same setting. The host is held with XOFF while the writer erases a page,
+ * links faster than the rx stash covers lose nothing.
+ */
+#ifndef BOOT_LINK_XONXOFF
+#define BOOT_LINK_XONXOFF               (0)
+#endif
+
+/*
+ * 1: LED1 (PA15) is driven high at the top of main() and low right before
+ * the fast path jumps to the app; NRST release to the falling edge on a
+ * scope is the reset to app entry time.
+ */
+#ifndef BOOT_FAST_TRACE
+#define BOOT_FAST_TRACE                 (0)
+#endif
+
+/*
+ * Binary download progress journaled to the metadata log every that many
+ * bytes committed to flash, what a power loss costs to send again at most.
+ */
+#define BOOT_RESUME_JOURNAL_STEP        (8 * FLASH_DRV_PAGE_SIZE)
+
+/* Timeouts from the bootloader flow, in ms */
+#define BOOT_START_DOWNLOAD_TIMEOUT     (60000)     /* BOOT MODE without BOOT_START_DOWNLOAD */
+#define BOOT_BLOCK_TIMEOUT              (10000)     /* no line / block received while downloading */
+#define BOOT_RESET_DELAY                (50)        /* let the last reply leave before a soft reset */
+#define BOOT_FRAME_GAP_TIMEOUT          (10)        /* no byte inside a frame: its rest was lost, hunt for SOF */
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file boot_delta.h
+ * @brief Streaming decoder of delta updates (BOOT_MODE_DELTA)
+ *
+ * The patch rebuilds the new image from the app in flash, one op after
+ * the other, each one producing the next bytes of the image:
+ *
+ *  | 0x01 INSERT | len (2) | data (len)            |
+ *  | 0x02 COPY   | len (2) | source (4)            |
+ *
+ * COPY takes len bytes of the old image at source, an offset from
+ * BOOT_APP_START_ADDR. The image is rebuilt in place, so an op never
+ * crosses a page of the new image and a copy only reads from the page it
+ * writes or the ones after it: those still hold the old image until that
+ * page leaves the scratch page. The patch ends with the op that reaches
+ * the announced image size.
+ *
+ * Input comes in pieces of any size (download blocks), an op may span
+ * them. Output leaves through a small buffer the caller drains into the
+ * writer, like boot_lz.h.
+ */
+
+#ifndef BOOT_DELTA_H
+#define BOOT_DELTA_H
+
+#include <stdint.h>
+#include "boot_protocol.h"
+
+#define BOOT_DELTA_INSERT               (0x01)
+#define BOOT_DELTA_COPY                 (0x02)
+#define BOOT_DELTA_OUT_SIZE             (64)    /* rebuilt bytes handed over at once */
+
+typedef enum
+{
+    BOOT_DELTA_OP = 0x00,
+    BOOT_DELTA_LEN,
+    BOOT_DELTA_SOURCE,
+    BOOT_DELTA_INSERTING,
+    BOOT_DELTA_COPYING,
+    BOOT_DELTA_DONE,            /* image size reached */
+} boot_delta_state_t;
+
+typedef struct
+{
+    boot_delta_state_t state;
+    uint8_t op;
+    uint8_t field;              /* bytes of len / source read */
+    uint32_t len;               /* left to produce */
+    uint32_t source;
+    uint32_t size;              /* new image size */
+    uint32_t limit;             /* old image bytes readable, from BOOT_APP_START_ADDR */
+    uint32_t in_total;          /* patch bytes consumed */
+    uint32_t out_total;         /* image bytes produced, from the image start */
+    boot_status_t error;        /* sticky, BOOT_ST_ERR_FORMAT */
+    uint16_t out_start;         /* pending output out[out_start, out_len) */
+    uint16_t out_len;
+    const uint8_t *old;         /* old image, mapped */
+    uint8_t out[BOOT_DELTA_OUT_SIZE];
+} boot_delta_t;
+
+/** Patch from the op that starts the image at offset from, a page boundary */
+void boot_delta_init(boot_delta_t *delta, const uint8_t *old, uint32_t limit, uint32_t size, uint32_t from);
+
+/**
+ * Decode until the output buffer is full or the input used up.
+ * Returns the input bytes consumed.
+ */
+uint32_t boot_delta_decode(boot_delta_t *delta, const uint8_t *in, uint32_t len);
+
+/** Pending output bytes, they belong at out_total - pending from the image start */
+static inline uint16_t boot_delta_pending(const boot_delta_t *delta)
+{
+    return (uint16_t)(delta->out_len - delta->out_start);
+}
+
+/** The caller took n pending bytes */
+void boot_delta_consume(boot_delta_t *delta, uint16_t n);
+
+/** Output left that needs no more input: pending, or the rest of a copy */
+static inline uint8_t boot_delta_busy(const boot_delta_t *delta)
+{
+    return boot_delta_pending(delta) || delta->state == BOOT_DELTA_COPYING;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/**
+ * @file boot_fsm.h
+ * @brief Bootloader download state machine (Doc/stm32-bootloader-fsm.drawio)
+ */
+
+#ifndef BOOT_FSM_H
+#define BOOT_FSM_H
+
+#include <time_event.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart_driver.h"
+#include "boot_config.h"
+#include "boot_protocol.h"
+#include "boot_hex.h"
+#include "boot_writer.h"
+#include "boot_window.h"
+#include "boot_lz.h"
+#include "boot_delta.h"
+#include "boot_seg.h"
+
+#define BOOT_RX_CHUNK_SIZE              (32)    /* bytes moved from the link ring per parser pass */
+
+typedef enum
+{
+    ev_boot_invalid = 0x00,
+    ev_boot_enter,
+    ev_boot_start_download,
+    ev_boot_download_line,
+    ev_boot_download_block,
+    ev_boot_download_finished,
+    ev_boot_cancel,
+    ev_boot_manifest,
+    ev_boot_last
+} boot_event_name_t;
+
+typedef enum
+{
+    st_boot_invalid = 0x00,
+    st_boot_idle,               /* BOOT MODE, waiting for BOOT_START_DOWNLOAD */
+    st_boot_download,           /* receiving hex lines / binary blocks */
+    st_boot_reset,              /* last reply leaving, then soft reset or app handoff */
+    st_boot_last
+} boot_state_t;
+
+typedef struct
+{
+    time_event_t start_download_timeout;
+    time_event_t block_timeout;
+    time_event_t reset_delay;
+    time_event_t frame_gap;     /* since the last link byte */
+} boot_event_time_t;
+
+typedef struct
+{
+    boot_event_name_t name;
+    boot_event_time_t time;
+} boot_event_t;
+
+typedef struct
+{
+    uart_driver_t *link;
+    boot_frame_parser_t parser;
+    boot_writer_t writer;
+    boot_window_t window;       /* binary mode, blocks in flight */
+    boot_lz_t lz;               /* BOOT_MODE_BINARY_LZ, ring in a lent window slot */
+    boot_delta_t delta;         /* BOOT_MODE_DELTA */
+    boot_seg_t seg;             /* BOOT_MODE_SEGMENTS */
+    boot_hex_t hex;
+    boot_mode_t mode;
+    uint32_t pending;           /* hex lines / blocks announced and not written yet */
+    uint32_t image_size;        /* announced at start, 0 if unknown (legacy hex hosts) */
+    uint32_t image_crc;         /* announced at start, binary and delta modes: the download can resume, else 0 */
+    uint32_t resumed;           /* bytes kept from an interrupted download */
+    uint32_t journaled;         /* bytes committed as of the last progress record */
+    uint16_t seq;               /* seq of the last data frame processed */
+    boot_status_t seq_status;   /* its reply, resent if the frame is repeated */
+    uint8_t handoff;            /* image verified at DOWNLOAD_FINISHED, start it instead of a reset */
+    uint32_t finished_us;       /* when, boot_app_time_us() */
+    uint8_t reply[BOOT_FRAME_OVERHEAD + BOOT_REPLY_MAX_PAYLOAD];
+    uint8_t reply_len;          /* reply waiting for room in the tx ring, 0 if none */
+    uint32_t replies_dropped;   /* replies lost, one was still waiting */
+} boot_iface_t;
+
+typedef struct
+{
+    boot_event_t event;
+    boot_state_t state;
+    boot_iface_t iface;
+} boot_fsm_t;
+
+void boot_fsm_init(boot_fsm_t *handle, uart_driver_t *link);
+/** BOOT MODE requested through the RAM mailbox: answer the app's ENTER_BOOT_MODE, own start timeout (0: default) */
+void boot_fsm_resume(boot_fsm_t *handle, uint16_t seq, uint8_t reply, uint32_t start_timeout);
+void boot_fsm_run(boot_fsm_t *handle);
+
+/** New image verified and the DOWNLOAD_FINISHED reply out: the app can be started */
+uint8_t boot_fsm_handoff_due(boot_fsm_t *handle);
+void boot_fsm_update_timers(boot_fsm_t *handle);
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file boot_hex.h
+ * @brief Intel HEX record decoder for the legacy DOWNLOAD_LINE mode
+ */
+
+#ifndef BOOT_HEX_H
+#define BOOT_HEX_H
+
+#include <stdint.h>
+
+#define BOOT_HEX_MAX_DATA               (255)
+
+typedef enum
+{
+    BOOT_HEX_DATA               = 0x00,
+    BOOT_HEX_EOF                = 0x01,
+    BOOT_HEX_EXT_SEGMENT_ADDR   = 0x02,
+    BOOT_HEX_START_SEGMENT_ADDR = 0x03,
+    BOOT_HEX_EXT_LINEAR_ADDR    = 0x04,
+    BOOT_HEX_START_LINEAR_ADDR  = 0x05,
+} boot_hex_type_t;
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t len;
+    uint16_t offset;
+    uint8_t data[BOOT_HEX_MAX_DATA];
+} boot_hex_record_t;
+
+typedef struct
+{
+    uint32_t base;              /* upper address from the last type 02/04 record */
+} boot_hex_t;
+
+void boot_hex_init(boot_hex_t *hex);
+
+/** Decode ":LLAAAATT<data>CC", trailing CR/LF allowed, returns 1 on success */
+uint8_t boot_hex_decode(const uint8_t *line, uint16_t len, boot_hex_record_t *record);
+
+/** Track extended address records, returns the absolute address of a data record */
+uint32_t boot_hex_address(boot_hex_t *hex, const boot_hex_record_t *record);
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file boot_image.h
+ * @brief Image header at a fixed offset of the user app
+ *
+ * The app carries its own description right after its 48 vectors, at
+ * BOOT_APP_START_ADDR + BOOT_IMAGE_HEADER_OFFSET: length, entry point,
+ * build id and the oldest bootloader it runs on are read there without a
+ * pass over the image. The app compiles the constant fields in, the
+ * post-link step (Host/Src/image_stamp.c) fills the length, build id and
+ * crcs. Same layout as stm32f0_dummy_app/Core/Inc/API/boot_image.h.
+ *
+ * header_crc covers the header after it up to header_size, image_crc the
+ * image from BOOT_APP_START_ADDR up to image_size without the two crc
+ * fields. Newer header versions append fields, header_size tells.
+ */
+
+#ifndef BOOT_IMAGE_H
+#define BOOT_IMAGE_H
+
+#include <stdint.h>
+
+#define BOOT_IMAGE_HEADER_OFFSET        (0xC0)          /* after the 48 vectors */
+#define BOOT_IMAGE_MAGIC                (0x474D4942UL)  /* "BIMG" */
+#define BOOT_IMAGE_HEADER_VERSION       (1)
+#define BOOT_IMAGE_CRC_OFFSET           (8)             /* header_crc, image_crc */
+#define BOOT_IMAGE_CRC_SIZE             (8)
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_IMAGE_MAGIC */
+    uint16_t header_version;    /* BOOT_IMAGE_HEADER_VERSION */
+    uint16_t header_size;       /* sizeof(boot_image_header_t) of that version */
+    uint32_t header_crc;
+    uint32_t image_crc;
+    uint32_t image_size;        /* bytes from BOOT_APP_START_ADDR, header included */
+    uint32_t entry;             /* reset handler, thumb bit set */
+    uint32_t build_id;
+    uint32_t min_boot_version;  /* BOOT_VERSION the app needs at least */
+} boot_image_header_t;
+
+/**
+ * Header of the image at image (size bytes readable): magic, a version and
+ * size this bootloader knows, header crc. NULL if there is none.
+ */
+const boot_image_header_t *boot_image_find(const uint8_t *image, uint32_t size);
+
+/** image_crc of size bytes at image, the header included; plain gets the crc32 of all of them, NULL if not needed */
+uint32_t boot_image_crc(const uint8_t *image, uint32_t size, uint32_t *plain);
+
+/** header_crc of a header */
+uint32_t boot_image_header_crc(const boot_image_header_t *header);
+
+/** The app runs on this bootloader */
+uint8_t boot_image_compatible(const boot_image_header_t *header);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file boot_log.h
+ * @brief Append-only record log over two flash pages
+ *
+ * Records are half-word sequences, programmed once and never rewritten:
+ *
+ *   | tag: type (8) payload half-words (8) | payload | crc32 (2 half-words) |
+ *
+ * A record without payload is its tag alone, one half-word write, no crc.
+ * The owner replays the records oldest first, the newest of a kind wins.
+ *
+ * One page is active, the one whose header carries the highest sequence.
+ * When it is full the other page is erased, the owner writes its live
+ * state there and the header is programmed last: a power loss in between
+ * leaves the old page active. Erases alternate between the two pages.
+ */
+
+#ifndef BOOT_LOG_H
+#define BOOT_LOG_H
+
+#include <stdint.h>
+#include "flash_driver.h"
+
+#define BOOT_LOG_PAGE_MAGIC             (0xB0071067UL)
+#define BOOT_LOG_HEADER_SIZE            (8)     /* magic, sequence */
+#define BOOT_LOG_MAX_PAYLOAD            (32)    /* bytes, even */
+
+/** A valid record of the active page, oldest first */
+typedef void (*boot_log_replay_t)(void *ctx, uint8_t type, const uint8_t *payload, uint8_t len);
+
+/** Append the live state to a fresh page with boot_log_append() */
+typedef flash_drv_st_t (*boot_log_snapshot_t)(void *ctx);
+
+typedef struct
+{
+    uint32_t start;             /* first of the two pages */
+    uint32_t page;              /* active page, 0 if none */
+    uint32_t sequence;          /* of the active page */
+    uint32_t next;              /* where the next record goes */
+    uint8_t dirty;              /* unreadable record at next, compact before appending */
+    uint8_t compacting;         /* snapshot being written */
+    uint32_t compactions;       /* since open, one page erase each */
+    boot_log_snapshot_t snapshot;
+    void *ctx;
+} boot_log_t;
+
+/** Find the active page and replay its records */
+void boot_log_open(boot_log_t *log, uint32_t start, boot_log_replay_t replay, boot_log_snapshot_t snapshot, void *ctx);
+
+/**
+ * Append a record, len even and up to BOOT_LOG_MAX_PAYLOAD. The owner
+ * updates its state first: if the page is full the snapshot written to the
+ * other page already holds the change and the record itself is dropped.
+ */
+flash_drv_st_t boot_log_append(boot_log_t *log, uint8_t type, const void *payload, uint8_t len);
+
+/** A record of len payload bytes goes in without a compaction, no page erase */
+uint8_t boot_log_fits(const boot_log_t *log, uint8_t len);
+
+#endif
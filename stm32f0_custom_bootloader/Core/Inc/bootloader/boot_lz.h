@@ -0,0 +1,84 @@
+/**
+ * @file boot_lz.h
+ * @brief Streaming decoder of LZ compressed images (BOOT_MODE_BINARY_LZ)
+ *
+ * LZ4 block format, offsets limited to BOOT_LZ_WINDOW:
+ *
+ *  | token | literal length + | literals | offset (2) | match length + |
+ *
+ * token high nibble: literals, 15 adds the bytes that follow up to one
+ * below 255; low nibble: match length - BOOT_LZ_MIN_MATCH, same extension.
+ * The offset counts back from the next output byte, little endian. The
+ * stream ends after the literals, or the match, that reach the announced
+ * image size.
+ *
+ * Input comes in pieces of any size (download blocks), a sequence may span
+ * them. Output leaves through a small buffer the caller drains into the
+ * writer; the last BOOT_LZ_WINDOW bytes are kept in a ring for the matches,
+ * so nothing is read back from flash. The ring is lent by the caller (a
+ * receive window slot), nothing is allocated.
+ */
+
+#ifndef BOOT_LZ_H
+#define BOOT_LZ_H
+
+#include <stdint.h>
+#include "boot_protocol.h"
+
+#define BOOT_LZ_WINDOW                  (2048)  /* power of 2, farthest match */
+#define BOOT_LZ_MIN_MATCH               (4)
+#define BOOT_LZ_OUT_SIZE                (64)    /* decoded bytes handed over at once */
+
+typedef enum
+{
+    BOOT_LZ_TOKEN = 0x00,
+    BOOT_LZ_LITERAL_LEN,
+    BOOT_LZ_LITERALS,
+    BOOT_LZ_OFFSET_LO,
+    BOOT_LZ_OFFSET_HI,
+    BOOT_LZ_MATCH_LEN,
+    BOOT_LZ_MATCH,
+    BOOT_LZ_DONE,               /* image size reached */
+} boot_lz_state_t;
+
+typedef struct
+{
+    boot_lz_state_t state;
+    uint8_t extend;             /* length nibble was 15 */
+    uint32_t literals;          /* left to copy */
+    uint32_t match;
+    uint16_t offset;
+    uint32_t size;              /* decompressed image size */
+    uint32_t in_total;          /* compressed bytes consumed */
+    uint32_t out_total;         /* bytes decoded */
+    boot_status_t error;        /* sticky, BOOT_ST_ERR_FORMAT */
+    uint16_t out_start;         /* pending output out[out_start, out_len) */
+    uint16_t out_len;
+    uint8_t *window;            /* BOOT_LZ_WINDOW bytes */
+    uint8_t out[BOOT_LZ_OUT_SIZE];
+} boot_lz_t;
+
+void boot_lz_init(boot_lz_t *lz, uint8_t *window, uint32_t size);
+
+/**
+ * Decode until the output buffer is full or the input used up.
+ * Returns the input bytes consumed.
+ */
+uint32_t boot_lz_decode(boot_lz_t *lz, const uint8_t *in, uint32_t len);
+
+/** Pending output bytes, they belong at out_total - pending from the image start */
+static inline uint16_t boot_lz_pending(const boot_lz_t *lz)
+{
+    return (uint16_t)(lz->out_len - lz->out_start);
+}
+
+/** The caller took n pending bytes */
+void boot_lz_consume(boot_lz_t *lz, uint16_t n);
+
+/** Output left that needs no more input: pending, or the rest of a match */
+static inline uint8_t boot_lz_busy(const boot_lz_t *lz)
+{
+    return boot_lz_pending(lz) || lz->state == BOOT_LZ_MATCH;
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file boot_mailbox.h
+ * @brief BOOT MODE request from the app, in SRAM kept across a soft reset
+ *
+ * The app fills the mailbox and resets instead of setting the boot flag in
+ * flash: no erase, no program. The bootloader takes it at the top of main()
+ * and clears it, a later reset boots normally. It sits in .noinit at the top
+ * of RAM, at the same address in both linker scripts and below both stacks;
+ * neither startup code touches it. Random power-on contents fail the check.
+ *
+ * The other way round the bootloader leaves the handoff latency there when
+ * it starts a new image without a reset (boot_app_handoff()).
+ *
+ * stm32f0_dummy_app/Core/Inc/API/boot_mailbox.h has the same layout.
+ */
+
+#ifndef BOOT_MAILBOX_H
+#define BOOT_MAILBOX_H
+
+#include <stdint.h>
+
+#define BOOT_MAILBOX_ADDR               (0x20007FE0UL)  /* .noinit, 32 bytes */
+#define BOOT_MAILBOX_MAGIC              (0xB0075E55UL)
+#define BOOT_HANDOFF_MAGIC              (0xB0074A4DUL)
+
+/* flags */
+#define BOOT_MAILBOX_REPLY              (0x0001U)       /* answer ENTER_BOOT_MODE seq from the bootloader */
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_MAILBOX_MAGIC: BOOT MODE requested */
+    uint32_t baudrate;          /* gateway link, 0 keeps the default */
+    uint16_t seq;               /* of the ENTER_BOOT_MODE frame the app took */
+    uint16_t flags;
+    uint32_t start_timeout;     /* ms to BOOT_START_DOWNLOAD, 0 keeps the default */
+    uint32_t check;             /* inverted xor of the words above */
+} boot_mailbox_t;
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_HANDOFF_MAGIC: started by boot_app_handoff() */
+    uint32_t latency_us;        /* DOWNLOAD_FINISHED handled to the app reset handler */
+    uint32_t check;             /* inverted xor of the words above */
+} boot_handoff_t;
+
+/** Copy a valid request out, 0 and a zeroed request if there is none. Always cleared. */
+uint8_t boot_mailbox_take(boot_mailbox_t *request);
+
+/** Leave the handoff latency for the app */
+void boot_mailbox_handoff(uint32_t latency_us);
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file boot_meta.h
+ * @brief User app length and CRC, boot flag and download counter, kept as
+ *        records in the metadata log (boot_log.h)
+ *
+ * Every change is one appended record: the image record once the download
+ * is confirmed, its verified mark once the image was checked against it,
+ * the invalid mark when a download first erases or programs the app area,
+ * and the boot flag set / clear as a single half-word each. A page is only erased when the log moves to
+ * the other one.
+ *
+ * While a binary download runs, progress records journal how much of the
+ * image is in flash, identified by its size and crc, so a download cut by
+ * a reset or a lost link resumes there. The next image record ends it.
+ * A delta update journals every page it copies to the scratch page before
+ * erasing it in place, that record is its progress.
+ */
+
+#ifndef BOOT_META_H
+#define BOOT_META_H
+
+#include <stdint.h>
+#include "flash_driver.h"
+#include "boot_log.h"
+
+/* record types, one bit each so no tag-only record reads as another one half programmed */
+#define BOOT_META_IMAGE                 (0x01)  /* size, crc, generation */
+#define BOOT_META_VERIFIED              (0x02)  /* generation */
+#define BOOT_META_INVALID               (0x04)  /* app no longer trusted */
+#define BOOT_META_FLAG_SET              (0x08)
+#define BOOT_META_FLAG_CLEAR            (0x10)
+#define BOOT_META_PROGRESS              (0x20)  /* image size, image crc, bytes committed */
+#define BOOT_META_STAGED                (0x40)  /* image size, image crc, page offset, page crc: delta update */
+
+#define BOOT_META_NO_STAGE              (0xFFFFFFFFUL)  /* delta update started, no page staged yet */
+
+typedef struct
+{
+    uint32_t image_size;        /* bytes from BOOT_APP_START_ADDR */
+    uint32_t image_crc;         /* crc32 of the image, as confirmed by the server */
+    uint32_t generation;        /* downloads confirmed on this device */
+    uint8_t verified;           /* the image was checked against this record */
+} boot_meta_t;
+
+/** Replay the metadata log, before any other call */
+void boot_meta_init(void);
+
+/** Current image record, returns 1 if there is one and it was not invalidated */
+uint8_t boot_meta_load(boot_meta_t *meta);
+
+/** New image record, next generation, not verified yet */
+flash_drv_st_t boot_meta_save(uint32_t image_size, uint32_t image_crc);
+
+/** The image was checked against this record */
+uint8_t boot_meta_is_verified(const boot_meta_t *meta);
+
+/** Mark the record verified */
+flash_drv_st_t boot_meta_set_verified(const boot_meta_t *meta);
+
+/** The app is no longer trusted, the generation is kept */
+flash_drv_st_t boot_meta_invalidate(void);
+
+/** Bytes of that image already in flash from an interrupted download, 0 if none */
+uint32_t boot_meta_progress(uint32_t image_size, uint32_t image_crc);
+
+/** Journal the download progress, committed 0 drops it. Nothing written if it did not change. */
+flash_drv_st_t boot_meta_save_progress(uint32_t image_size, uint32_t image_crc, uint32_t committed);
+
+/** A progress record fits in the log without erasing the other page */
+uint8_t boot_meta_progress_fits(void);
+
+/**
+ * Delta update of that image under way: returns 1 with the offset of the
+ * page last copied to the scratch page (BOOT_META_NO_STAGE if none yet) and
+ * the crc of the whole page. Every page before it holds the new image, the
+ * ones after it the old one.
+ */
+uint8_t boot_meta_staged(uint32_t image_size, uint32_t image_crc, uint32_t *offset, uint32_t *page_crc);
+
+/** Journal a delta update: page at offset in the scratch page, about to be erased */
+flash_drv_st_t boot_meta_save_staged(uint32_t image_size, uint32_t image_crc, uint32_t offset, uint32_t page_crc);
+
+/** A delta update of any image is journaled, it may need the scratch page to resume */
+uint8_t boot_meta_delta_staged(void);
+
+/** Boot Flag (flash): the app asked for BOOT MODE */
+uint8_t boot_meta_boot_flag(void);
+
+/** Set Boot Flag */
+flash_drv_st_t boot_meta_set_boot_flag(void);
+
+/** Clear Boot Flag */
+flash_drv_st_t boot_meta_clear_boot_flag(void);
+
+/** The log, for reports */
+const boot_log_t *boot_meta_log(void);
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * @file boot_protocol.h
+ * @brief Bootloader <-> gateway framing
+ *
+ * Every message, in both directions, travels in one binary frame:
+ *
+ *  | SOF 0xA5 | cmd | seq (2) | len (2) | payload (len) | crc32 (4) |
+ *
+ * Multi-byte fields are little endian, the CRC-32 covers cmd..payload.
+ * Replies carry the request cmd | BOOT_CMD_REPLY, the request seq and a
+ * boot_status_t as first payload byte.
+ *
+ * Download modes, selected at BOOT_START_DOWNLOAD:
+ *  - BOOT_MODE_HEX_LINE : legacy hosts, one ASCII Intel HEX record per
+ *    BOOT_CMD_DOWNLOAD_LINE, confirmed one by one.
+ *  - BOOT_MODE_BINARY   : BOOT_CMD_DOWNLOAD_BLOCK, payload is the 32 bit
+ *    load address followed by up to BOOT_BLOCK_MAX_DATA raw bytes.
+ *  - BOOT_MODE_BINARY_LZ: blocks as above carrying the image LZ compressed
+ *    (boot_lz.h), the address is the offset in the compressed stream. The
+ *    image size is required; it and the final crc32 are those of the
+ *    decompressed image, count is the number of compressed blocks.
+ *  - BOOT_MODE_DELTA    : blocks as above carrying a patch (boot_delta.h)
+ *    against the app in flash, the address is the offset in the patch.
+ *    BOOT_START_DOWNLOAD adds the size and crc32 of that base image, the
+ *    one the target has verified, else BOOT_ST_ERR_BASE. The new image is
+ *    rebuilt in place page by page through the scratch page; a reset in
+ *    between resumes from the journal, never from the base again.
+ *
+ *  - BOOT_MODE_BINARY_SPARSE: blocks as in BOOT_MODE_BINARY, only for the
+ *    pages that differ from the manifest; the pages without a block keep
+ *    what the flash holds, the final crc32 covers them as they are. The
+ *    count is not checked.
+ *  - BOOT_MODE_SEGMENTS : blocks as in BOOT_MODE_BINARY_LZ carrying a
+ *    segment list (boot_seg.h), the address is the offset in the list. The
+ *    image size is required, the span from the app start to the end of the
+ *    last segment; the final crc32 is that of the segment list, the gaps
+ *    between segments are left as the flash holds them.
+ *
+ * BOOT_CMD_GET_MANIFEST, in BOOT MODE before BOOT_START_DOWNLOAD, returns
+ * the crc32 of whole 2 KB pages of the app area as the flash holds them:
+ * request first page (2) and pages (1), reply first page (2), pages in the
+ * app area (2) and up to BOOT_MANIFEST_MAX_PAGES crc32 (4). The host pads
+ * the last page of its image with 0xFF, as the writer does, to compare.
+ *
+ * ENTER_BOOT_OK adds the bootloader version (4). An image with a header
+ * (boot_image.h) that asks for a newer one is refused with
+ * BOOT_ST_ERR_VERSION in the block replies once the stream moves past the
+ * first page, before that page is erased or programmed, and the app in
+ * flash keeps running; the host can tell before.
+ *
+ * A BOOT_MODE_BINARY(_SPARSE) download that announces the image crc32 at
+ * BOOT_START_DOWNLOAD is resumable: the reply gives the offset the target
+ * already holds from an interrupted download of that image, the host sends
+ * from there. The count still covers the whole image in BOOT_BLOCK_MAX_DATA
+ * blocks. A delta update always resumes, at a page boundary: the host sends
+ * the patch from the op that starts that page, its blocks addressed from 0.
+ */
+
+#ifndef BOOT_PROTOCOL_H
+#define BOOT_PROTOCOL_H
+
+#include <stdint.h>
+
+#define BOOT_FRAME_SOF                  (0xA5)
+#define BOOT_FRAME_HEADER_SIZE          (6)         /* sof, cmd, seq, len */
+#define BOOT_FRAME_CRC_SIZE             (4)
+#define BOOT_FRAME_OVERHEAD             (BOOT_FRAME_HEADER_SIZE + BOOT_FRAME_CRC_SIZE)
+
+#define BOOT_BLOCK_ADDR_SIZE            (4)
+#define BOOT_BLOCK_MAX_DATA             (2048)      /* one flash page */
+#define BOOT_FRAME_MAX_PAYLOAD          (BOOT_BLOCK_ADDR_SIZE + BOOT_BLOCK_MAX_DATA)
+#define BOOT_FRAME_MAX_SIZE             (BOOT_FRAME_OVERHEAD + BOOT_FRAME_MAX_PAYLOAD)
+
+#define BOOT_MANIFEST_HEADER_SIZE       (4)         /* first page (2), pages in the app area (2) */
+#define BOOT_MANIFEST_MAX_PAGES         (24)        /* page crcs per reply, escaped frame still fits the tx ring */
+#define BOOT_REPLY_MAX_PAYLOAD          (1 + BOOT_MANIFEST_HEADER_SIZE + 4 * BOOT_MANIFEST_MAX_PAGES)
+#define BOOT_ENTER_REPLY_SIZE           (4)         /* bootloader version */
+#define BOOT_START_REPLY_SIZE           (7)         /* window (1), biggest block (2), resume offset (4) */
+#define BOOT_FINISHED_SUMMARY_SIZE      (6)         /* pages programmed, identical, erases skipped (2 each) */
+
+typedef enum
+{
+    BOOT_CMD_ENTER_BOOT         = 0x01,     /* ENTER_BOOT_MODE, to the app: link baud (4), optional */
+    BOOT_CMD_START_DOWNLOAD     = 0x02,     /* mode (1), count (4), image size (4), image crc32 (4) optional,
+                                               delta: base size (4), base crc32 (4) */
+    BOOT_CMD_DOWNLOAD_LINE      = 0x03,     /* ASCII Intel HEX record */
+    BOOT_CMD_DOWNLOAD_BLOCK     = 0x04,     /* address (4), data */
+    BOOT_CMD_DOWNLOAD_FINISHED  = 0x05,     /* image crc32 (4) */
+    BOOT_CMD_CANCEL_BOOT        = 0x06,
+    BOOT_CMD_GET_MANIFEST       = 0x07,     /* first page (2), pages (1) */
+    BOOT_CMD_REPLY              = 0x80,
+} boot_cmd_t;
+
+typedef enum
+{
+    BOOT_MODE_HEX_LINE          = 0x00,
+    BOOT_MODE_BINARY            = 0x01,
+    BOOT_MODE_BINARY_LZ         = 0x02,
+    BOOT_MODE_DELTA             = 0x03,
+    BOOT_MODE_BINARY_SPARSE     = 0x04,
+    BOOT_MODE_SEGMENTS          = 0x05,
+} boot_mode_t;
+
+typedef enum
+{
+    BOOT_ST_OK                  = 0x00,
+    BOOT_ST_ERR_CRC             = 0x01,     /* frame crc mismatch, resend; a block NACK adds the ack */
+    BOOT_ST_ERR_STATE           = 0x02,     /* command not expected now */
+    BOOT_ST_ERR_FORMAT          = 0x03,     /* bad payload or hex record */
+    BOOT_ST_ERR_ADDRESS         = 0x04,     /* outside of the user app area */
+    BOOT_ST_ERR_FLASH           = 0x05,     /* erase or program failed */
+    BOOT_ST_ERR_SEQUENCE        = 0x06,     /* unexpected seq, payload has the expected one */
+    BOOT_ST_ERR_IMAGE_CRC       = 0x07,     /* BOOT_FAIL */
+    BOOT_ST_ERR_BASE            = 0x08,     /* delta update against another image than the one in flash */
+    BOOT_ST_ERR_VERSION         = 0x09,     /* image header asks for a newer bootloader */
+} boot_status_t;
+
+typedef struct
+{
+    uint8_t cmd;
+    uint16_t seq;
+    uint16_t len;
+    uint8_t payload[BOOT_FRAME_MAX_PAYLOAD];
+} boot_frame_t;
+
+typedef enum
+{
+    BOOT_PARSER_SOF = 0x00,
+    BOOT_PARSER_HEADER,
+    BOOT_PARSER_PAYLOAD,
+    BOOT_PARSER_CRC,
+} boot_parser_state_t;
+
+typedef enum
+{
+    BOOT_PARSE_BUSY = 0x00,     /* need more bytes */
+    BOOT_PARSE_FRAME,           /* frame complete and valid */
+    BOOT_PARSE_ERROR,           /* frame complete, crc mismatch */
+} boot_parse_result_t;
+
+typedef struct
+{
+    boot_parser_state_t state;
+    uint16_t idx;
+    uint8_t raw[BOOT_FRAME_HEADER_SIZE - 1];
+    uint32_t crc_rx;
+    uint32_t frames;            /* valid frames received */
+    uint32_t crc_errors;        /* frames dropped on crc mismatch */
+    uint32_t truncated;         /* frames dropped, the link went idle inside them */
+    boot_frame_t frame;
+} boot_frame_parser_t;
+
+void boot_frame_parser_init(boot_frame_parser_t *parser);
+boot_parse_result_t boot_frame_parse(boot_frame_parser_t *parser, uint8_t byte);
+
+/** The link went idle: a frame in progress lost bytes and is dropped, returns 1 if there was one */
+uint8_t boot_frame_parser_idle(boot_frame_parser_t *parser);
+uint16_t boot_frame_encode(uint8_t *out, uint8_t cmd, uint16_t seq, const uint8_t *payload, uint16_t len);
+
+/* little endian field helpers */
+static inline uint32_t boot_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t boot_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void boot_put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static inline void boot_put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file boot_seg.h
+ * @brief Streaming parser of segment list images (BOOT_MODE_SEGMENTS)
+ *
+ * The image is the loaded ranges of the ELF / HEX file and nothing else:
+ *
+ *  | magic "SEG1" (4) | segments (4) |
+ *  | address (4) | len (4) | data (len) |   one per segment
+ *
+ * Addresses are absolute load addresses, segments come in address order
+ * and do not overlap, all of them inside the announced span from
+ * BOOT_APP_START_ADDR. The stream ends with the last segment. The pages
+ * between segments are neither sent nor erased; in a page that gets data
+ * the bytes no segment covers are 0xFF.
+ *
+ * Input comes in pieces of any size (download blocks), a header may span
+ * them. Segment data is not copied: the caller hands it to the writer
+ * straight from the block (boot_seg_run() / boot_seg_consume()). The crc32
+ * of the whole stream is kept running, it is the one DOWNLOAD_FINISHED
+ * checks.
+ */
+
+#ifndef BOOT_SEG_H
+#define BOOT_SEG_H
+
+#include <stdint.h>
+#include "boot_protocol.h"
+
+#define BOOT_SEG_MAGIC                  (0x31474553UL)  /* "SEG1" */
+#define BOOT_SEG_HEADER_SIZE            (8)
+#define BOOT_SEG_ENTRY_SIZE             (8)             /* address, len */
+
+typedef enum
+{
+    BOOT_SEG_MAGIC_FIELD = 0x00,
+    BOOT_SEG_COUNT,
+    BOOT_SEG_ADDRESS,
+    BOOT_SEG_LEN,
+    BOOT_SEG_DATA,
+    BOOT_SEG_DONE,              /* last segment in */
+} boot_seg_state_t;
+
+typedef struct
+{
+    boot_seg_state_t state;
+    uint8_t field;              /* bytes of value read */
+    uint32_t value;
+    uint32_t count;             /* segments left, the one in DATA included */
+    uint32_t address;           /* next data byte goes there */
+    uint32_t len;               /* data left in the segment */
+    uint32_t next;              /* lowest address the next segment may start at */
+    uint32_t end;               /* span end */
+    uint32_t in_total;          /* stream bytes consumed */
+    uint32_t crc;               /* running crc32 of the stream, not finalized */
+    boot_status_t error;        /* sticky, BOOT_ST_ERR_FORMAT / BOOT_ST_ERR_ADDRESS */
+} boot_seg_t;
+
+/** Segments inside [start, end) */
+void boot_seg_init(boot_seg_t *seg, uint32_t start, uint32_t end);
+
+/**
+ * Parse headers until segment data or the stream end.
+ * Returns the input bytes consumed.
+ */
+uint32_t boot_seg_decode(boot_seg_t *seg, const uint8_t *in, uint32_t len);
+
+/** Segment data bytes at the front of len input bytes, to write at seg->address */
+static inline uint32_t boot_seg_run(const boot_seg_t *seg, uint32_t len)
+{
+    if (seg->state != BOOT_SEG_DATA)
+        return 0;
+
+    return (len < seg->len) ? len : seg->len;
+}
+
+/** The caller wrote n bytes of the run at data */
+void boot_seg_consume(boot_seg_t *seg, const uint8_t *data, uint32_t n);
+
+#endif
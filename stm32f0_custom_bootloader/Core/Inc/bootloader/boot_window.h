@@ -0,0 +1,90 @@
+/**
+ * @file boot_window.h
+ * @brief Receive window of the binary download: blocks may arrive out of
+ *        order and are handed to the writer in sequence.
+ *
+ * The host keeps up to the advertised window of DOWNLOAD_BLOCK frames in
+ * flight. Every block is acknowledged with
+ *
+ *  | status | next seq (2) | sack (2) | window (1) |
+ *
+ * next: all blocks before it were received (cumulative ack)
+ * sack: bit i set, block next + 1 + i was received out of order
+ * window: blocks the host may send from next on
+ *
+ * While held, the limit (next + window) last advertised does not move, so
+ * the link falls silent once the host has sent up to it.
+ */
+
+#ifndef BOOT_WINDOW_H
+#define BOOT_WINDOW_H
+
+#include <stdint.h>
+#include "boot_protocol.h"
+
+#define BOOT_WINDOW_MAX                 (8)     /* upper bound, the RAM actually free decides */
+#define BOOT_WINDOW_RAM_RESERVE         (1024)  /* heap left to the C library (printf) */
+#define BOOT_WINDOW_ACK_SIZE            (5)     /* reply payload after the status byte */
+
+typedef struct
+{
+    uint8_t used;
+    uint16_t seq;
+    uint32_t address;
+    uint16_t len;
+    uint16_t done;              /* bytes already taken by the writer */
+    uint8_t data[BOOT_BLOCK_MAX_DATA];
+} boot_slot_t;
+
+typedef struct
+{
+    boot_slot_t *slots;
+    uint8_t size;               /* slots in the window */
+    uint8_t allocated;          /* slots allocated, one may be lent out */
+    uint16_t next;              /* cumulative ack: every seq before it was received */
+    uint16_t write;             /* oldest seq not yet handed to the writer */
+    uint16_t limit;             /* first seq beyond the window last advertised */
+    uint8_t hold;               /* limit frozen */
+} boot_window_t;
+
+typedef enum
+{
+    BOOT_WINDOW_STORED = 0x00,
+    BOOT_WINDOW_DUPLICATE,      /* already received, ack again */
+    BOOT_WINDOW_OUTSIDE,        /* beyond the advertised window, dropped */
+} boot_window_put_t;
+
+/** Take as many slots as the free RAM allows, returns the window size */
+uint8_t boot_window_init(boot_window_t *window);
+
+/** Empty window from first_seq on, a lent slot is back */
+void boot_window_reset(boot_window_t *window, uint16_t first_seq);
+
+/**
+ * Take the last slot out of the window for other use until the next reset,
+ * returns its BOOT_BLOCK_MAX_DATA bytes, NULL if only one slot is left.
+ * Call right after boot_window_reset().
+ */
+uint8_t *boot_window_lend(boot_window_t *window);
+
+boot_window_put_t boot_window_put(boot_window_t *window, uint16_t seq, uint32_t address, const uint8_t *data, uint16_t len);
+
+/** Oldest block in sequence, NULL if it did not arrive yet */
+boot_slot_t *boot_window_peek(boot_window_t *window);
+
+/** The oldest block has been written, its slot is free again */
+void boot_window_release(boot_window_t *window);
+
+/** Fill the ack fields: next, sack and window, and remember the limit */
+void boot_window_ack(boot_window_t *window, uint8_t *ack);
+
+/** Freeze / release the advertised limit */
+void boot_window_hold(boot_window_t *window, uint8_t hold);
+
+/** Every block up to the advertised limit has arrived */
+uint8_t boot_window_full(boot_window_t *window);
+
+/** Every received block has been released */
+uint8_t boot_window_empty(boot_window_t *window);
+
+#endif
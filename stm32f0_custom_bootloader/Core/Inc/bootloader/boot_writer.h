@@ -0,0 +1,166 @@
+/**
+ * @file boot_writer.h
+ * @brief Collects downloaded data into page buffers and erases / programs
+ *        the user app area in the background, one step per call.
+ *
+ * Flash pipeline, one operation at a time on the controller:
+ *
+ *  page buffer   FREE -> FILLING -> PROGRAMMING -> FREE
+ *  flash page    not erased -> ERASING -> erased -> programmed
+ *
+ * A page is erased while its data is still arriving, or ahead of it, and
+ * programmed once the stream moved on, so erase, program and reception of
+ * three consecutive pages overlap.
+ *
+ * A complete page equal to the flash contents is neither erased nor
+ * programmed, a page already blank is not erased. Erasing ahead of the
+ * data (erase_ahead) gives that up, it is only worth it when the link
+ * cannot receive during an erase, and starts once the image differs from
+ * what is in flash.
+ *
+ * Every page gets its crc when it is queued, kept once the page is
+ * verified: programmed and read back, or found identical in flash. The
+ * image CRC at the end combines them (crc32_combine()), in any order, and
+ * only reads the flash for pages without one (holes, pages filled twice).
+ *
+ * The first page of the window is not queued if it holds an image header
+ * that needs a newer bootloader: the error is BOOT_ST_ERR_VERSION and the
+ * app in flash is left as it was. The owner's touch callback runs once,
+ * right before the first erase or program, to drop what trusted the old
+ * contents.
+ *
+ * A resumed download starts with the pages an earlier one left in flash:
+ * they count as written, their crcs are taken from flash.
+ *
+ * In place (delta update, boot_writer_set_scratch()) a page is programmed
+ * to the scratch page first and journaled by the owner before its own
+ * erase, so a power loss leaves every page either old, new, or new in the
+ * scratch page. Only the oldest queued page goes through it at a time.
+ */
+
+#ifndef BOOT_WRITER_H
+#define BOOT_WRITER_H
+
+#include <stdint.h>
+#include "flash_driver.h"
+#include "boot_protocol.h"
+
+#define BOOT_WRITER_PAGES               (2)     /* one filling while the other programs */
+#define BOOT_WRITER_SLICE               (16)    /* half-words per service call, ~1 ms of flash time */
+#define BOOT_WRITER_ERASE_AHEAD         (8)     /* pages erased past the one being filled */
+#define BOOT_WRITER_ERASE_LOW           (4)     /* erase due when fewer are left ahead */
+#define BOOT_WRITER_NO_PAGE             (0xFFFFFFFFUL)
+#define BOOT_WRITER_MAX_PAGES           (FLASH_DRV_SIZE / FLASH_DRV_PAGE_SIZE)
+#define BOOT_WRITER_MAP_SIZE            ((BOOT_WRITER_MAX_PAGES + 7) / 8)
+
+typedef enum
+{
+    BOOT_PAGE_FREE = 0x00,
+    BOOT_PAGE_FILLING,          /* receiving data */
+    BOOT_PAGE_PROGRAMMING,      /* queued / being programmed */
+} boot_page_state_t;
+
+typedef struct
+{
+    boot_page_state_t state;
+    uint32_t address;
+    uint16_t offset;            /* next half-word to program */
+    uint8_t crc_valid;          /* first fill of the page, its crc goes to the table */
+    uint8_t in_scratch;         /* in place: copied to the scratch page and journaled */
+    uint8_t data[FLASH_DRV_PAGE_SIZE];
+} boot_page_t;
+
+typedef enum
+{
+    BOOT_FLASH_IDLE = 0x00,
+    BOOT_FLASH_ERASING,         /* erase started, polled until done */
+} boot_flash_state_t;
+
+/** In place: the page at address is in the scratch page, journal it before it is erased */
+typedef flash_drv_st_t (*boot_writer_stage_t)(void *ctx, uint32_t address);
+
+/** First flash change of the writer, called once before it */
+typedef flash_drv_st_t (*boot_writer_touch_t)(void);
+
+typedef struct
+{
+    uint32_t start;             /* writable window [start, end) */
+    uint32_t end;
+    uint32_t erase_end;         /* no erase ahead past it, end of the announced image */
+    uint32_t image_end;         /* highest address written + 1 */
+    uint32_t bytes;             /* payload bytes accepted */
+    uint32_t pages_programmed;
+    uint32_t pages_erased;
+    uint32_t pages_skipped;     /* identical to flash, not erased nor programmed */
+    uint32_t erases_skipped;    /* already blank */
+    uint8_t erase_ahead;        /* erase pages before their data is in */
+    uint8_t diverged;           /* a page differed from flash */
+    uint8_t keep_holes;         /* pages without data keep the flash contents, no erase ahead either */
+    boot_status_t error;        /* first erase / programming error, sticky */
+    boot_flash_state_t flash;
+    uint32_t erasing;           /* page under erase */
+    uint32_t scratch;           /* in place: pages go here before their erase, 0 if not */
+    uint8_t scratch_erased;
+    boot_writer_stage_t stage;
+    void *ctx;
+    boot_writer_touch_t touch;  /* NULL once called, or if not set */
+    uint8_t erased[BOOT_WRITER_MAP_SIZE];   /* bit per page from start */
+    uint8_t verified[BOOT_WRITER_MAP_SIZE]; /* page_crc matches the flash */
+    uint32_t page_crc[BOOT_WRITER_MAX_PAGES];   /* up to erase_end */
+    boot_page_t *filling;       /* page receiving data, NULL if none */
+    uint8_t queue[BOOT_WRITER_PAGES];   /* pages to program, oldest first */
+    uint8_t queued;
+    boot_page_t pages[BOOT_WRITER_PAGES];
+} boot_writer_t;
+
+void boot_writer_init(boot_writer_t *writer, uint32_t start, uint32_t end);
+
+/**
+ * Update in place: every page that differs is copied to the scratch page
+ * and handed to stage before it is erased. Turns erase ahead off.
+ */
+void boot_writer_set_scratch(boot_writer_t *writer, uint32_t scratch, boot_writer_stage_t stage, void *ctx);
+
+/**
+ * Buffer data at an absolute address. Pages are queued for programming as
+ * the address moves on; if no page buffer is free, fewer than len bytes are
+ * taken and the caller retries after boot_writer_service().
+ */
+boot_status_t boot_writer_write(boot_writer_t *writer, uint32_t address, const uint8_t *data, uint32_t len, uint32_t *taken);
+
+/**
+ * Next flash step: poll the running erase, erase the oldest queued page,
+ * program a slice of it, or erase ahead. Erases only start if may_erase is
+ * set. Returns the sticky error.
+ */
+boot_status_t boot_writer_service(boot_writer_t *writer, uint8_t may_erase);
+
+/** Next page to erase, BOOT_WRITER_NO_PAGE if none; due set if it is needed soon */
+uint32_t boot_writer_erase_next(boot_writer_t *writer, uint8_t *due);
+
+/** Queue the filling page, erase and program up to the image end (holes too unless keep_holes), blocking */
+boot_status_t boot_writer_flush(boot_writer_t *writer);
+
+/**
+ * CRC-32 of [start, start + size) as programmed, combined from the crcs of
+ * the verified pages, the flash is read for the others. Call after
+ * boot_writer_flush().
+ */
+uint32_t boot_writer_image_crc(boot_writer_t *writer, uint32_t size);
+
+/**
+ * The first size bytes, whole pages, are in flash from an interrupted
+ * download of the same image. Call right after boot_writer_init().
+ */
+void boot_writer_resume(boot_writer_t *writer, uint32_t size);
+
+/**
+ * End of what is programmed and read back from start, for a stream in
+ * address order: everything below the oldest page still buffered.
+ */
+uint32_t boot_writer_committed(const boot_writer_t *writer);
+
+/** Blocking write, used when the host waits for each record anyway */
+boot_status_t boot_writer_write_all(boot_writer_t *writer, uint32_t address, const uint8_t *data, uint32_t len);
+
+#endif
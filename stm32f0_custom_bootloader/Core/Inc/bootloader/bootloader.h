@@ -0,0 +1,26 @@
+/**
+ * @file bootloader.h
+ * @brief Bootloader application, runs the download FSM on the gateway link
+ */
+
+#ifndef BOOTLOADER_H
+#define BOOTLOADER_H
+
+#include "boot_fsm.h"
+#include "boot_app.h"
+#include "boot_mailbox.h"
+
+extern boot_fsm_t boot_fsm;
+extern boot_app_t boot_app;
+extern boot_mailbox_t boot_request;
+
+/** No mailbox request, boot flag clear and a valid app: start it, nothing else initialized */
+uint8_t bootloader_app_ready(void);
+
+void bootloader_init(void);
+void bootloader_exec(void);
+
+/** New image valid and its last reply out: tear down and boot_app_handoff() instead of a reset */
+uint8_t bootloader_handoff_due(void);
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file irq_priority.h
+ * @brief Interrupt priority plan of the bootloader.
+ *
+ * @note  Cortex-M0 implements 2 priority bits: 0 is the highest, 3 the lowest,
+ *        and an interrupt only preempts handlers of a strictly lower priority.
+ *        The boot link rx must never wait behind the debug port or the
+ *        SysTick bookkeeping (HAL tick + FSM timers), otherwise a byte is
+ *        overwritten in RDR before it is read (ORE). No DMA interrupt is
+ *        enabled, the CRC feed polls its channel.
+ *
+ *        Select a plan with IRQ_PRIORITY_PLAN, build with IRQ_LATENCY_TRACE=1
+ *        and compare the worst rx entry latency reported for each one.
+ */
+
+#ifndef IRQ_PRIORITY_H
+#define IRQ_PRIORITY_H
+
+#define IRQ_PRIORITY_PLAN_FLAT          (0)     /* everything on one level, no preemption */
+#define IRQ_PRIORITY_PLAN_CUBEMX        (1)     /* generated code: both USART 0, SysTick 3 */
+#define IRQ_PRIORITY_PLAN_LINK_FIRST    (2)     /* link rx > debug port > SysTick */
+
+#ifndef IRQ_PRIORITY_PLAN
+#define IRQ_PRIORITY_PLAN               IRQ_PRIORITY_PLAN_LINK_FIRST
+#endif
+
+#if (IRQ_PRIORITY_PLAN == IRQ_PRIORITY_PLAN_FLAT)
+#define IRQ_PRIORITY_PLAN_NAME          "flat"
+#define IRQ_PRIO_LINK_UART              (0)
+#define IRQ_PRIO_DEBUG_UART             (0)
+#define IRQ_PRIO_SYSTICK                (0)
+
+#elif (IRQ_PRIORITY_PLAN == IRQ_PRIORITY_PLAN_CUBEMX)
+#define IRQ_PRIORITY_PLAN_NAME          "cubemx"
+#define IRQ_PRIO_LINK_UART              (0)
+#define IRQ_PRIO_DEBUG_UART             (0)
+#define IRQ_PRIO_SYSTICK                (3)
+
+#elif (IRQ_PRIORITY_PLAN == IRQ_PRIORITY_PLAN_LINK_FIRST)
+#define IRQ_PRIORITY_PLAN_NAME          "link first"
+#define IRQ_PRIO_LINK_UART              (0)     /* boot link USART, rx must be served within one byte time */
+#define IRQ_PRIO_DEBUG_UART             (1)     /* printf port, may wait */
+#define IRQ_PRIO_SYSTICK                (3)     /* HAL tick and FSM time events */
+
+#else
+#error "irq priority : unknown IRQ_PRIORITY_PLAN"
+#endif
+
+/* USART instances */
+#define IRQ_LINK_USART                  USART2
+#define IRQ_DEBUG_USART                 USART1
+
+/* rx entry latency instrumentation, see irq_latency.h */
+#ifndef IRQ_LATENCY_TRACE
+#define IRQ_LATENCY_TRACE               (0)
+#endif
+
+#endif
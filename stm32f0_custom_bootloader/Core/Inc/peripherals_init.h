@@ -4,6 +4,8 @@
 
 #include "stm32f0xx_hal.h"
 #include "uart_driver.h"
+#include "irq_priority.h"
+#include "irq_latency.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define LED1_Pin GPIO_PIN_15
@@ -18,7 +20,12 @@
 extern uart_driver_t uart1;
 extern uart_driver_t uart2;
 
+#if IRQ_LATENCY_TRACE
+extern irq_latency_t link_rx_latency;
+#endif
+
 /* Public function prototypes -----------------------------------------------*/
 void peripherals_init(void);
+void peripherals_deinit(void);
 
 #endif
\ No newline at end of file
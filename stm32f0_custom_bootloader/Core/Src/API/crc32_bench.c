@@ -0,0 +1,94 @@
+/**
+ * @file crc32_bench.c
+ * @brief Cycles per KB of each crc32 engine, over flash and over SRAM.
+ *
+ * @note  Cycles are read from SysTick: HAL tick times the reload plus the
+ *        count down in the running millisecond, exact to a few cycles at
+ *        HCLK. Interrupts stay enabled, the link is quiet at startup. The
+ *        flash run covers the start of the bootloader image, the SRAM run a
+ *        page sized buffer like the writer hands to the running image crc.
+ */
+
+#include <stdio.h>
+#include "crc32_bench.h"
+#include "crc32.h"
+#include "stm32f0xx_hal.h"
+
+typedef uint32_t (*crc32_bench_update_t)(uint32_t crc, const uint8_t *data, size_t len);
+
+static const crc32_bench_update_t crc32_bench_update[3] = {
+    crc32_update_nibble, crc32_update_table, crc32_update_hw};
+
+static const char *const crc32_bench_names[3] = {"nibble", "table", "hw dma"};
+
+static uint8_t crc32_bench_ram[CRC32_BENCH_RAM_BYTES];
+
+static uint32_t crc32_bench_cycles(void)
+{
+    uint32_t tick;
+    uint32_t count;
+
+    do
+    {
+        tick = HAL_GetTick();
+        count = SysTick->VAL;
+    } while (tick != HAL_GetTick());
+
+    return tick * (SysTick->LOAD + 1U) + (SysTick->LOAD - count);
+}
+
+/**
+ * @brief One pass of an engine over a buffer
+ * @return uint32_t cycles per KB
+ */
+static uint32_t crc32_bench_pass(crc32_bench_update_t update, const uint8_t *data, uint32_t len, uint32_t *crc)
+{
+    uint32_t start = crc32_bench_cycles();
+    *crc = crc32_final(update(CRC32_INIT, data, len));
+    uint32_t cycles = crc32_bench_cycles() - start;
+
+    return (cycles * 1024U) / len;
+}
+
+void crc32_bench_run(crc32_bench_t *bench)
+{
+    const uint8_t *flash = (const uint8_t *)FLASH_BASE;
+    uint32_t flash_ref;
+    uint32_t ram_ref;
+    uint32_t crc;
+
+    for (uint32_t i = 0; i < CRC32_BENCH_RAM_BYTES; i++)
+        crc32_bench_ram[i] = (uint8_t)(i * 13U + 5U);
+
+    /* odd start, the hw engine also runs its byte head and tail */
+    flash_ref = crc32_final(crc32_update_nibble(CRC32_INIT, flash + 1, CRC32_BENCH_BYTES - 2));
+    ram_ref = crc32_final(crc32_update_nibble(CRC32_INIT, crc32_bench_ram, CRC32_BENCH_RAM_BYTES));
+
+    bench->mismatches = 0;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        crc32_bench_engine_t *engine = &bench->engine[i];
+
+        engine->name = crc32_bench_names[i];
+
+        engine->flash_cycles = crc32_bench_pass(crc32_bench_update[i], flash + 1, CRC32_BENCH_BYTES - 2, &crc);
+        if (crc != flash_ref)
+            bench->mismatches++;
+
+        engine->ram_cycles = crc32_bench_pass(crc32_bench_update[i], crc32_bench_ram, CRC32_BENCH_RAM_BYTES, &crc);
+        if (crc != ram_ref)
+            bench->mismatches++;
+    }
+}
+
+void crc32_bench_report(crc32_bench_t *bench)
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        printf("crc bench : %-6s %6lu cycles/KB flash, %6lu cycles/KB sram\r\n", bench->engine[i].name,
+               (unsigned long)bench->engine[i].flash_cycles, (unsigned long)bench->engine[i].ram_cycles);
+    }
+
+    printf("crc bench : mismatches %lu\r\n", (unsigned long)bench->mismatches);
+}
@@ -0,0 +1,111 @@
+/**
+ * @file crc32_hw.c
+ * @brief CRC-32 on the CRC unit, long buffers fed by DMA memory to memory
+ *
+ * @note  The F030 unit only has the 0x04C11DB7 polynomial, MSB first. With
+ *        the input bit reversed (by word for little endian words, by byte
+ *        for single bytes) and the output bit reversed it runs the zlib
+ *        crc. The running crc is loaded through CRC_INIT, bit reversed back.
+ *        The DMA channel only moves words to CRC_DR and is polled, no
+ *        interrupt; from flash it stalls like the core while the flash is
+ *        busy.
+ */
+
+#include <stdint.h>
+#include "crc32.h"
+#include "stm32f0xx_hal.h"
+
+#define CRC32_HW_DMA_MIN        (64)    /* bytes, below the core writes the words */
+#define CRC32_HW_DMA            DMA1_Channel1
+#define CRC32_HW_DMA_DONE       (DMA_ISR_TCIF1 | DMA_ISR_TEIF1)
+#define CRC32_HW_DMA_ERROR      DMA_ISR_TEIF1
+#define CRC32_HW_DMA_CLEAR      DMA_IFCR_CGIF1
+
+#define CRC32_HW_BYTES          (CRC_CR_REV_OUT | CRC_CR_REV_IN_0)
+#define CRC32_HW_WORDS          (CRC_CR_REV_OUT | CRC_CR_REV_IN_0 | CRC_CR_REV_IN_1)
+
+static uint32_t crc32_hw_reverse(uint32_t value)
+{
+    value = ((value >> 1) & 0x55555555UL) | ((value & 0x55555555UL) << 1);
+    value = ((value >> 2) & 0x33333333UL) | ((value & 0x33333333UL) << 2);
+    value = ((value >> 4) & 0x0F0F0F0FUL) | ((value & 0x0F0F0F0FUL) << 4);
+    value = ((value >> 8) & 0x00FF00FFUL) | ((value & 0x00FF00FFUL) << 8);
+    return (value >> 16) | (value << 16);
+}
+
+static void crc32_hw_bytes(const uint8_t *data, size_t len)
+{
+    CRC->CR = CRC32_HW_BYTES;
+
+    while (len--)
+        *(__IO uint8_t *)&CRC->DR = *data++;
+}
+
+/**
+ * @brief Aligned words through DMA1 channel 1, memory (CMAR, incremented)
+ *        to CRC_DR (CPAR, fixed)
+ * @return uint8_t 0 on a transfer error
+ */
+static uint8_t crc32_hw_dma(const uint32_t *words, uint32_t count)
+{
+    CRC32_HW_DMA->CCR = 0;
+    DMA1->IFCR = CRC32_HW_DMA_CLEAR;
+    CRC32_HW_DMA->CPAR = (uint32_t)(uintptr_t)&CRC->DR;
+    CRC32_HW_DMA->CMAR = (uint32_t)(uintptr_t)words;
+    CRC32_HW_DMA->CNDTR = count;
+    CRC32_HW_DMA->CCR = DMA_CCR_MEM2MEM | DMA_CCR_DIR | DMA_CCR_MINC |
+                        DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 | DMA_CCR_EN;
+
+    while (!(DMA1->ISR & CRC32_HW_DMA_DONE))
+    {
+    }
+
+    uint8_t ok = !(DMA1->ISR & CRC32_HW_DMA_ERROR);
+
+    CRC32_HW_DMA->CCR = 0;
+    DMA1->IFCR = CRC32_HW_DMA_CLEAR;
+
+    return ok;
+}
+
+void crc32_hw_init(void)
+{
+    __HAL_RCC_CRC_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+}
+
+uint32_t crc32_update_hw(uint32_t crc, const uint8_t *data, size_t len)
+{
+    size_t head = (size_t)(-(uintptr_t)data & 3U);
+
+    /* an unclocked unit reads back 0, every crc would fail */
+    assert_param(__HAL_RCC_CRC_IS_CLK_ENABLED() && __HAL_RCC_DMA1_IS_CLK_ENABLED());
+
+    if (head > len)
+        head = len;
+
+    const uint32_t *words = (const uint32_t *)(const void *)(data + head);
+    uint32_t count = (uint32_t)((len - head) / 4);
+
+    CRC->INIT = crc32_hw_reverse(crc);
+    CRC->CR = CRC32_HW_BYTES | CRC_CR_RESET;
+
+    crc32_hw_bytes(data, head);
+
+    CRC->CR = CRC32_HW_WORDS;
+
+    if (count * 4 < CRC32_HW_DMA_MIN)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            CRC->DR = words[i];
+    }
+    else if (!crc32_hw_dma(words, count))
+    {
+        /* not reachable by the DMA, never for flash or SRAM */
+        return crc32_update_nibble(crc, data, len);
+    }
+
+    crc32_hw_bytes(data + head + count * 4, len - head - count * 4);
+
+    return CRC->DR;
+}
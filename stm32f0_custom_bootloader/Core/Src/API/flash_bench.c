@@ -0,0 +1,95 @@
+/**
+ * @file flash_bench.c
+ * @brief Page program time, HAL_FLASH_Program() loop against flash_driver_program().
+ *
+ * @note  Times come from the HAL tick, kept by SysTick from SRAM while the
+ *        flash is busy (stm32f0xx_it.c); each method programs
+ *        FLASH_BENCH_PAGES pages and the total is averaged, ~1 ms of
+ *        resolution over ~200 ms. The page used is the last one of the
+ *        flash, the bootloader's delta update scratch page (boot_config.h):
+ *        every other page is taken, main() skips the bench while a delta
+ *        update is staged there.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "flash_bench.h"
+#include "flash_driver.h"
+#include "stm32f0xx_hal.h"
+
+#define FLASH_BENCH_ADDR        (FLASH_DRV_END_ADDR - FLASH_DRV_PAGE_SIZE)
+
+static uint8_t flash_bench_page[FLASH_DRV_PAGE_SIZE];
+
+static uint8_t flash_bench_check(void)
+{
+    return memcmp(flash_driver_map(FLASH_BENCH_ADDR), flash_bench_page, FLASH_DRV_PAGE_SIZE) == 0;
+}
+
+static uint8_t flash_bench_hal_page(void)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+
+    for (uint32_t i = 0; i < FLASH_DRV_PAGE_SIZE && status == HAL_OK; i += 2)
+    {
+        uint16_t halfword = (uint16_t)flash_bench_page[i] | ((uint16_t)flash_bench_page[i + 1] << 8);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, FLASH_BENCH_ADDR + i, halfword);
+    }
+
+    HAL_FLASH_Lock();
+
+    return status == HAL_OK;
+}
+
+static uint8_t flash_bench_driver_page(void)
+{
+    return flash_driver_program(FLASH_BENCH_ADDR, flash_bench_page, FLASH_DRV_PAGE_SIZE) == FLASH_DRV_OK;
+}
+
+/**
+ * @brief Erase (not timed), program, read back, FLASH_BENCH_PAGES times
+ * @return uint32_t average us per page
+ */
+static uint32_t flash_bench_method(uint8_t (*program_page)(void), uint32_t *errors)
+{
+    uint32_t total_ms = 0;
+
+    for (uint32_t i = 0; i < FLASH_BENCH_PAGES; i++)
+    {
+        if (flash_driver_erase(FLASH_BENCH_ADDR, 1) != FLASH_DRV_OK)
+        {
+            (*errors)++;
+            continue;
+        }
+
+        uint32_t start = HAL_GetTick();
+        uint8_t ok = program_page();
+        total_ms += HAL_GetTick() - start;
+
+        if (!ok || !flash_bench_check())
+            (*errors)++;
+    }
+
+    return (total_ms * 1000U) / FLASH_BENCH_PAGES;
+}
+
+void flash_bench_run(flash_bench_t *bench)
+{
+    /* no blank half-word, every one is programmed */
+    for (uint32_t i = 0; i < FLASH_DRV_PAGE_SIZE; i++)
+        flash_bench_page[i] = (uint8_t)(i * 7U + 1U);
+
+    bench->errors = 0;
+    bench->hal_us = flash_bench_method(flash_bench_hal_page, &bench->errors);
+    bench->driver_us = flash_bench_method(flash_bench_driver_page, &bench->errors);
+
+    flash_driver_erase(FLASH_BENCH_ADDR, 1);
+}
+
+void flash_bench_report(flash_bench_t *bench)
+{
+    printf("flash bench : 2 KB page program, HAL loop %lu us, driver %lu us, errors %lu\r\n",
+           (unsigned long)bench->hal_us, (unsigned long)bench->driver_us, (unsigned long)bench->errors);
+}
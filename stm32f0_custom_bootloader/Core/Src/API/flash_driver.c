@@ -0,0 +1,185 @@
+/**
+ * @file flash_driver.c
+ * @brief Internal flash erase/program driver (STM32F030xC, 2 KB pages)
+ */
+
+#include "flash_driver.h"
+#include "stm32f0xx_hal.h"
+#include "ram_func.h"
+
+/**@brief Enable/Disable debug messages */
+#define FLASH_DRIVER_DEBUG 0
+#define FLASH_DRIVER_TAG "flash driver : "
+
+#if FLASH_DRIVER_DEBUG
+#include <stdio.h>
+#define flash_driver_dbg(format, ...) printf(FLASH_DRIVER_TAG format, ##__VA_ARGS__)
+#else
+#define flash_driver_dbg(format, ...) \
+    do                                \
+    { /* Do nothing */                \
+    } while (0)
+#endif
+
+static uint8_t flash_driver_in_range(uint32_t address, uint32_t len)
+{
+    return (address >= FLASH_DRV_BASE_ADDR) && (address + len <= FLASH_DRV_END_ADDR) && (address + len >= address);
+}
+
+/**
+ * @brief Page erase, waits in SRAM so the SRAM interrupt handlers keep
+ *        running meanwhile. PER is left set for flash_driver_poll().
+ */
+static RAM_FUNC void flash_driver_ram_erase(uint32_t address)
+{
+    SET_BIT(FLASH->CR, FLASH_CR_PER);
+    WRITE_REG(FLASH->AR, address);
+    SET_BIT(FLASH->CR, FLASH_CR_STRT);
+
+    while (READ_BIT(FLASH->SR, FLASH_SR_BSY))
+    {
+    }
+}
+
+/**
+ * @brief Streaming half-word program, in SRAM like the erase. PG stays set
+ *        for the whole run, each write starts the next half-word and BSY is
+ *        polled in between: no per half-word call, lock or tick timeout as
+ *        with HAL_FLASH_Program().
+ *
+ * @return PGERR / WRPRTERR of the first failing half-word, 0 if none
+ */
+static RAM_FUNC uint32_t flash_driver_ram_program(volatile uint16_t *dest, const uint8_t *data, uint32_t halfwords)
+{
+    uint32_t error = 0;
+
+    SET_BIT(FLASH->CR, FLASH_CR_PG);
+
+    while (halfwords-- && error == 0)
+    {
+        *dest++ = (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+        data += 2;
+
+        while (READ_BIT(FLASH->SR, FLASH_SR_BSY))
+        {
+        }
+
+        error = READ_BIT(FLASH->SR, FLASH_SR_PGERR | FLASH_SR_WRPRTERR);
+    }
+
+    CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+
+    return error;
+}
+
+/**
+ * @brief Erase consecutive flash pages
+ *
+ * @param address first page, must be page aligned
+ * @param pages   number of pages
+ * @return flash_drv_st_t
+ */
+flash_drv_st_t flash_driver_erase(uint32_t address, uint32_t pages)
+{
+    flash_drv_st_t status = FLASH_DRV_OK;
+
+    if ((address % FLASH_DRV_PAGE_SIZE) != 0 || !flash_driver_in_range(address, pages * FLASH_DRV_PAGE_SIZE))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    for (uint32_t i = 0; i < pages && status == FLASH_DRV_OK; i++)
+    {
+        status = flash_driver_erase_start(address + i * FLASH_DRV_PAGE_SIZE);
+
+        if (status == FLASH_DRV_OK)
+            status = flash_driver_poll();
+    }
+
+    return status;
+}
+
+/**
+ * @brief Start a page erase
+ * @note  Any fetch from flash stalls until the erase is over (~30 ms), so
+ *        the wait runs from SRAM and returns with the erase done: only the
+ *        SRAM interrupt handlers overlap with it (ram_func.h).
+ *        flash_driver_poll() reports the result.
+ *
+ * @param address page aligned address
+ * @return flash_drv_st_t FLASH_DRV_BUSY if the previous operation still runs
+ */
+flash_drv_st_t flash_driver_erase_start(uint32_t address)
+{
+    if ((address % FLASH_DRV_PAGE_SIZE) != 0 || !flash_driver_in_range(address, FLASH_DRV_PAGE_SIZE))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY))
+        return FLASH_DRV_BUSY;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+    flash_driver_ram_erase(address);
+
+    return FLASH_DRV_OK;
+}
+
+/**
+ * @brief Check the erase started by flash_driver_erase_start(), locks the
+ *        flash again once it is over.
+ */
+flash_drv_st_t flash_driver_poll(void)
+{
+    if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY))
+        return FLASH_DRV_BUSY;
+
+    if (READ_BIT(FLASH->CR, FLASH_CR_PER) == 0)
+        return FLASH_DRV_OK;
+
+    CLEAR_BIT(FLASH->CR, FLASH_CR_PER);
+    uint8_t failed = __HAL_FLASH_GET_FLAG(FLASH_FLAG_PGERR) || __HAL_FLASH_GET_FLAG(FLASH_FLAG_WRPERR);
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+    HAL_FLASH_Lock();
+
+    if (failed)
+    {
+        flash_driver_dbg("erase error at 0x%08lx\r\n", (unsigned long)READ_REG(FLASH->AR));
+        return FLASH_DRV_ERROR;
+    }
+
+    return FLASH_DRV_OK;
+}
+
+/**
+ * @brief Program data in flash, half-word by half-word
+ *
+ * @param address destination, half-word aligned, must be erased
+ * @param data    source buffer, no alignment required
+ * @param len     number of bytes, even
+ * @return flash_drv_st_t
+ */
+flash_drv_st_t flash_driver_program(uint32_t address, const uint8_t *data, uint32_t len)
+{
+    if ((address & 1U) || (len & 1U) || !flash_driver_in_range(address, len))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+
+    uint32_t error = flash_driver_ram_program((volatile uint16_t *)(uintptr_t)address, data, len / 2);
+
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+    HAL_FLASH_Lock();
+
+    if (error)
+    {
+        flash_driver_dbg("program error near 0x%08lx\r\n", (unsigned long)address);
+        return FLASH_DRV_ERROR;
+    }
+
+    return FLASH_DRV_OK;
+}
+
+const uint8_t *flash_driver_map(uint32_t address)
+{
+    return (const uint8_t *)(uintptr_t)address;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file irq_latency.c
+ * @brief Worst case rx interrupt entry latency instrumentation.
+ *
+ * @note  Cortex-M0 has no cycle counter, entries are timestamped with the
+ *        HAL tick and the SysTick down counter (1 core cycle resolution).
+ *        While the host streams bytes back-to-back, each RXNE is raised
+ *        exactly one byte time after the previous one, so any entry interval
+ *        above one byte time is delay added by a blocking handler or a masked
+ *        section. Intervals above two byte times are idle line, not latency;
+ *        a delay that long shows up as an overrun instead.
+ */
+
+#include <stdio.h>
+#include "irq_latency.h"
+#include "irq_priority.h"
+
+static uint32_t irq_latency_timestamp(void)
+{
+    uint32_t load = SysTick->LOAD + 1U;
+    uint32_t tick = HAL_GetTick();
+    uint32_t val = SysTick->VAL;
+
+    /* counter wrapped but SysTick cannot preempt us to count it yet */
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        val = SysTick->VAL;
+        tick++;
+    }
+
+    return tick * load + (load - 1U - val);
+}
+
+void irq_latency_init(irq_latency_t *trace, UART_HandleTypeDef *huart)
+{
+    trace->byte_cycles = (uint32_t)(((uint64_t)SystemCoreClock * 10U) / huart->Init.BaudRate);
+    trace->last_entry = irq_latency_timestamp();
+    trace->worst_cycles = 0;
+    trace->samples = 0;
+    trace->overruns = 0;
+}
+
+/**
+ * @brief Call first thing in the USART interrupt handler
+ */
+void irq_latency_rx_entry(irq_latency_t *trace, UART_HandleTypeDef *huart)
+{
+    uint32_t now = irq_latency_timestamp();
+
+    if (!__HAL_UART_GET_FLAG(huart, UART_FLAG_RXNE))
+        return;
+
+    if (__HAL_UART_GET_FLAG(huart, UART_FLAG_ORE))
+        trace->overruns++;
+
+    uint32_t interval = now - trace->last_entry;
+    trace->last_entry = now;
+
+    if (interval < 2U * trace->byte_cycles)
+    {
+        uint32_t delay = (interval > trace->byte_cycles) ? interval - trace->byte_cycles : 0;
+
+        if (delay > trace->worst_cycles)
+            trace->worst_cycles = delay;
+
+        trace->samples++;
+    }
+}
+
+void irq_latency_report(irq_latency_t *trace)
+{
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+
+    printf("irq plan [%s] rx worst entry delay %lu cycles (%lu us), byte %lu cycles, samples %lu, overruns %lu\r\n",
+           IRQ_PRIORITY_PLAN_NAME,
+           (unsigned long)trace->worst_cycles,
+           (unsigned long)(trace->worst_cycles / cycles_per_us),
+           (unsigned long)trace->byte_cycles,
+           (unsigned long)trace->samples,
+           (unsigned long)trace->overruns);
+}
@@ -2,6 +2,7 @@
 #include "time_event.h"
 #include "stm32f0xx_hal.h"
 #include "led_animation.h"
+#include "bootloader.h"
 
 
 /**
@@ -14,5 +15,6 @@ void HAL_SYSTICK_Callback(void)
     led_animation_update_timers(&led1_fsm);
     led_animation_update_timers(&led2_fsm);
     led_animation_update_timers(&led3_fsm);
+    boot_fsm_update_timers(&boot_fsm);
 
 }
@@ -9,6 +9,7 @@
  * 
  */
 #include "uart_driver.h"
+#include <string.h>
 
 #define USE_UART1 
 #define USE_UART2 
@@ -44,6 +45,171 @@ extern void Error_Handler(void);
 #endif
 
 
+/**
+ * @brief Start transmission of the next pending data chunk.
+ * @note  A pending XON/XOFF always goes first, data waits while the peer
+ *        holds us paused. Must be called with uart interrupts masked or from
+ *        the uart interrupt itself.
+ */
+static void uart_tx_kick(uart_driver_t *driver)
+{
+    uart_tx_resume(driver);
+
+    if (driver->handle.gState != HAL_UART_STATE_READY)
+        return;
+
+    if (driver->flow.ctrl_pending)
+    {
+        driver->flow.ctrl_byte = driver->flow.ctrl_pending;
+        driver->flow.ctrl_pending = 0;
+        HAL_UART_Transmit_IT(&driver->handle, &driver->flow.ctrl_byte, 1);
+        return;
+    }
+
+    if (driver->flow.tx_paused)
+        return;
+
+    /*check for pendings transfers */
+    uint16_t data_len = circular_buff_get_data_len(driver->data.tx.cb);
+
+    if (data_len)
+    {
+        data_len = (data_len >= MAX_DATA_CHUNK_SIZE) ? (MAX_DATA_CHUNK_SIZE - 1) : data_len;
+        circular_buff_read(driver->data.tx.cb, driver->data.tx.chunk, data_len);
+        HAL_UART_Transmit_IT(&driver->handle, driver->data.tx.chunk, data_len);
+    }
+}
+
+static void uart_flow_send(uart_driver_t *driver, uint8_t ctrl)
+{
+    driver->flow.ctrl_pending = ctrl;
+    uart_tx_kick(driver);
+}
+
+/**
+ * @brief Send XON once the rx ring drained below the low watermark
+ */
+static void uart_flow_rx_release(uart_driver_t *driver)
+{
+    if (!driver->flow.enabled || !driver->flow.rx_paused || driver->flow.hold)
+        return;
+
+    if (circular_buff_get_data_len(driver->data.rx.cb) <= driver->flow.low_watermark)
+    {
+        __disable_irq();
+        driver->flow.rx_paused = 0;
+        uart_flow_send(driver, UART_XON_CHAR);
+        __enable_irq();
+        uart_driver_dbg("comm driver info:\t xon sent\r\n");
+    }
+}
+
+/**
+ * @brief Consume XON/XOFF and escapes from the rx stream
+ * @return uint8_t 1 if byte is payload data, 0 if it was link control
+ */
+static uint8_t uart_flow_rx_filter(uart_driver_t *driver, uint8_t *byte)
+{
+    if (*byte == UART_XOFF_CHAR)
+    {
+        driver->flow.tx_paused = 1;
+        return 0;
+    }
+
+    if (*byte == UART_XON_CHAR)
+    {
+        driver->flow.tx_paused = 0;
+        uart_tx_kick(driver);
+        return 0;
+    }
+
+    if (driver->flow.binary)
+    {
+        if (driver->flow.rx_escaped)
+        {
+            driver->flow.rx_escaped = 0;
+            *byte ^= UART_ESC_MASK;
+        }
+        else if (*byte == UART_ESC_CHAR)
+        {
+            driver->flow.rx_escaped = 1;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Write data in tx ring escaping bytes that collide with link control
+ */
+static circular_buff_st_t uart_write_tx_escaped(uart_driver_t *driver, uint8_t *data, uint8_t len)
+{
+    size_t wire_len = len;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] == UART_XON_CHAR || data[i] == UART_XOFF_CHAR || data[i] == UART_ESC_CHAR)
+            wire_len++;
+    }
+
+    if (circular_buff_get_free_space(driver->data.tx.cb) < wire_len)
+        return CIRCUILAR_BUFF_NOT_ENOUGH_SPACE;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] == UART_XON_CHAR || data[i] == UART_XOFF_CHAR || data[i] == UART_ESC_CHAR)
+        {
+            circular_buff_put(driver->data.tx.cb, UART_ESC_CHAR);
+            circular_buff_put(driver->data.tx.cb, data[i] ^ UART_ESC_MASK);
+        }
+        else
+        {
+            circular_buff_put(driver->data.tx.cb, data[i]);
+        }
+    }
+
+    return CIRCULAR_BUFF_OK;
+}
+
+/**
+ * @brief Received byte: flow control filter, then the rx ring
+ */
+static void uart_rx_store(uart_driver_t *driver, uint8_t byte)
+{
+    if (driver->flow.enabled && !uart_flow_rx_filter(driver, &byte))
+        return;
+
+    if(circular_buff_write(driver->data.rx.cb, &byte, 1) !=  CIRCULAR_BUFF_OK)
+    {
+        /*Reinit ring buffer*/
+        circular_buff_reset(driver->data.rx.cb);
+    }
+
+    /*Ask the peer to stop before the ring overflows*/
+    if (driver->flow.enabled && !driver->flow.rx_paused &&
+        circular_buff_get_data_len(driver->data.rx.cb) >= driver->flow.high_watermark)
+    {
+        driver->flow.rx_paused = 1;
+        uart_flow_send(driver, UART_XOFF_CHAR);
+    }
+}
+
+/**
+ * @brief Move stashed bytes to the rx ring, as many as it can take
+ * @note  Runs with the uart interrupt masked or from it.
+ */
+static void uart_rx_stash_drain(uart_driver_t *driver)
+{
+    while (driver->data.rx.stash_tail != driver->data.rx.stash_head &&
+           circular_buff_get_free_space(driver->data.rx.cb) > 0)
+    {
+        uint8_t byte = driver->data.rx.stash[driver->data.rx.stash_tail & driver->data.rx.stash_mask];
+        driver->data.rx.stash_tail++;
+        uart_rx_store(driver, byte);
+    }
+}
+
 /**
  * @brief Init host comm peripheral interface
  * 
@@ -82,15 +248,44 @@ uint8_t uart_init_it(uart_driver_t *driver, uint8_t *rx_buff, uint16_t rx_len, u
     return 1;
 }
 
-uint8_t uart_get_rx_data_len(uart_driver_t *driver)
+/**
+ * @brief Reconfigure the line rate, reception is restarted
+ * @note  Only while the link is quiet: HAL_UART_Init() disables the USART
+ *        and leaves the rx state ready, a byte on the wire is lost.
+ */
+uint8_t uart_set_baudrate(uart_driver_t *driver, uint32_t baudrate)
+{
+    driver->handle.Init.BaudRate = baudrate;
+    if (HAL_UART_Init(&driver->handle) != HAL_OK)
+    {
+        Error_Handler();
+    }
+
+    HAL_UART_Receive_IT(&driver->handle, &driver->data.rx.byte, 1);
+
+    uart_driver_dbg("comm driver info : %lu baud\r\n", (unsigned long)baudrate);
+
+    return 1;
+}
+
+uint16_t uart_get_rx_data_len(uart_driver_t *driver)
 {
+    if (driver->data.rx.stash != NULL && driver->data.rx.stash_head != driver->data.rx.stash_tail)
+    {
+        __disable_irq();
+        uart_rx_stash_drain(driver);
+        __enable_irq();
+    }
+
     return circular_buff_get_data_len(driver->data.rx.cb);
 }
 
 
 uint8_t uart_read_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len)
 {
-    return circular_buff_read(driver->data.rx.cb, data, len);
+    uint8_t status = circular_buff_read(driver->data.rx.cb, data, len);
+    uart_flow_rx_release(driver);
+    return status;
 }
 
 
@@ -103,6 +298,7 @@ uint8_t uart_fetch_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len)
 uint8_t uart_clear_rx_data(uart_driver_t *driver)
 {
     circular_buff_reset(driver->data.rx.cb);
+    uart_flow_rx_release(driver);
     return 1;
 }
 
@@ -113,20 +309,25 @@ uint8_t uart_transmit(uart_driver_t *driver, uint8_t *data, uint8_t len)
 
 uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len)
 {
+    circular_buff_st_t status;
+
     /* Write data to circular buffer */
-    if (circular_buff_write(driver->data.tx.cb, data, len) == CIRCULAR_BUFF_OK)
+    if (driver->flow.enabled && driver->flow.binary)
+        status = uart_write_tx_escaped(driver, data, len);
+    else
+        status = circular_buff_write(driver->data.tx.cb, data, len);
+
+    if (status == CIRCULAR_BUFF_OK)
     {
-        if (driver->handle.gState == HAL_UART_STATE_READY)
-        {
-            uint8_t byte;
-            circular_buff_get(driver->data.tx.cb, &byte);
-            HAL_UART_Transmit_IT(&driver->handle, &byte, 1);
-        }
-        else
+        if (driver->handle.gState != HAL_UART_STATE_READY)
         {
             uart_driver_dbg("comm driver warning:\t uart busy\r\n");
         }
 
+        __disable_irq();
+        uart_tx_kick(driver);
+        __enable_irq();
+
         return 1;
     }
 
@@ -134,9 +335,25 @@ uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len)
 	return 0;
 }
 
+/**
+ * @brief Nothing left to send: tx ring and flow control byte empty, the
+ *        last stop bit on the wire (TC), e.g. before a peripheral teardown
+ */
+uint8_t uart_tx_idle(uart_driver_t *driver)
+{
+    if (driver->handle.gState != HAL_UART_STATE_READY || driver->flow.ctrl_pending ||
+        circular_buff_get_data_len(driver->data.tx.cb))
+        return 0;
+
+#if defined(__arm__)
+    return __HAL_UART_GET_FLAG(&driver->handle, UART_FLAG_TC) != RESET;
+#else
+    return 1;
+#endif
+}
+
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-  static uint8_t data_chunk[MAX_DATA_CHUNK_SIZE];
   uart_driver_t *driver = NULL;
 
 #ifdef USE_UART1
@@ -153,18 +370,80 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 
   if(driver != NULL)
   {
-    /*check for pendings transfers */
-    uint16_t data_len = circular_buff_get_data_len(driver->data.tx.cb);
+    uart_tx_kick(driver);
 
-    if(data_len)
+    uart_driver_dbg("comm driver info:\t irq uart tx complete\r\n");
+  }
+}
+
+/**
+ * @brief Give the link a stash for the bytes received while the flash is
+ *        busy and the HAL interrupt path (in flash) cannot run.
+ *
+ * @param buffer  static buffer, size a power of 2, enough for the longest
+ *                flash operation at the link baud rate
+ */
+void uart_rx_stash_init(uart_driver_t *driver, uint8_t *buffer, uint16_t size)
+{
+    driver->data.rx.stash_head = 0;
+    driver->data.rx.stash_tail = 0;
+    driver->data.rx.stash_overruns = 0;
+    driver->data.rx.stash_mask = (uint16_t)(size - 1);
+    driver->data.rx.stash = buffer;
+}
+
+/**
+ * @brief SRAM rx path, called by the uart interrupt while the flash is busy
+ */
+RAM_FUNC void uart_rx_stash_put(uart_driver_t *driver, uint8_t byte)
+{
+    uint16_t head = driver->data.rx.stash_head;
+
+    if ((uint16_t)(head - driver->data.rx.stash_tail) > driver->data.rx.stash_mask)
     {
-        data_len = (data_len >= MAX_DATA_CHUNK_SIZE ) ? (MAX_DATA_CHUNK_SIZE - 1) : data_len;
-        circular_buff_read(driver->data.tx.cb, data_chunk, data_len);
-        HAL_UART_Transmit_IT(&driver->handle, data_chunk, data_len);
+        driver->data.rx.stash_overruns++;
+        return;
     }
 
-    uart_driver_dbg("comm driver info:\t irq uart tx complete\r\n");
-  }
+    driver->data.rx.stash[head & driver->data.rx.stash_mask] = byte;
+    driver->data.rx.stash_head = (uint16_t)(head + 1);
+}
+
+/**
+ * @brief SRAM tx path, called by the uart interrupt while the flash is busy
+ * @note  A transfer in flight keeps TXE / TC asserted: unmasked, the
+ *        interrupt would enter back to back for the whole erase and starve
+ *        SysTick and the flash wait loop. uart_tx_resume() unmasks them.
+ */
+RAM_FUNC void uart_tx_park(uart_driver_t *driver)
+{
+#if defined(__arm__)
+    USART_TypeDef *usart = driver->handle.Instance;
+    uint32_t tx = usart->CR1 & (USART_CR1_TXEIE | USART_CR1_TCIE);
+
+    driver->data.tx.parked |= tx;
+    usart->CR1 &= ~tx;
+#else
+    (void)driver;
+#endif
+}
+
+/**
+ * @brief Unmask the tx interrupts uart_tx_park() took, the transfer goes on
+ * @note  From code running from flash, so the flash is idle, with the uart
+ *        interrupt masked or from it.
+ */
+void uart_tx_resume(uart_driver_t *driver)
+{
+#if defined(__arm__)
+    if (driver->data.tx.parked)
+    {
+        driver->handle.Instance->CR1 |= driver->data.tx.parked;
+        driver->data.tx.parked = 0;
+    }
+#else
+    (void)driver;
+#endif
 }
 
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
@@ -185,14 +464,68 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 
     if(driver != NULL)
     {
+        uint8_t byte = driver->data.rx.byte;
+
         /*Set Uart Data reception for next byte*/
         HAL_UART_Receive_IT(&driver->handle, &driver->data.rx.byte, 1);
 
-        if(circular_buff_write(driver->data.rx.cb, &driver->data.rx.byte, 1) !=  CIRCULAR_BUFF_OK)
+        /*Bytes taken while the flash was busy go first, keep the order;
+          the stash also absorbs what a full ring cannot take*/
+        if (driver->data.rx.stash != NULL &&
+            (driver->data.rx.stash_head != driver->data.rx.stash_tail || circular_buff_full(driver->data.rx.cb)))
         {
-            /*Reinit ring buffer*/
-            circular_buff_reset(driver->data.rx.cb);
+            uart_rx_stash_put(driver, byte);
+            uart_rx_stash_drain(driver);
+            return;
         }
+
+        uart_rx_store(driver, byte);
+    }
+}
+
+/**
+ * @brief Enable in-band XON/XOFF flow control driven by rx ring watermarks
+ * 
+ * @param binary  escape XON/XOFF/ESC data bytes, required when payload is not text
+ * @param low_watermark  rx ring level at which XON is sent again
+ * @param high_watermark rx ring level at which XOFF is sent, leave room for
+ *                       the bytes the peer sends before it reacts
+ */
+void uart_flow_control_init(uart_driver_t *driver, uint8_t binary, uint16_t low_watermark, uint16_t high_watermark)
+{
+    __disable_irq();
+    memset(&driver->flow, 0, sizeof(uart_flow_t));
+    driver->flow.binary = binary;
+    driver->flow.low_watermark = low_watermark;
+    driver->flow.high_watermark = high_watermark;
+    driver->flow.enabled = 1;
+    __enable_irq();
+}
+
+/**
+ * @brief Pause the peer regardless of ring level, e.g. while flash is erased
+ *        and the rx interrupt cannot be served.
+ */
+void uart_flow_hold(uart_driver_t *driver, uint8_t hold)
+{
+    if (!driver->flow.enabled)
+        return;
+
+    driver->flow.hold = hold;
+
+    if (hold)
+    {
+        __disable_irq();
+        if (!driver->flow.rx_paused)
+        {
+            driver->flow.rx_paused = 1;
+            uart_flow_send(driver, UART_XOFF_CHAR);
+        }
+        __enable_irq();
+    }
+    else
+    {
+        uart_flow_rx_release(driver);
     }
 }
 
@@ -0,0 +1,200 @@
+/**
+ * @file boot_app.c
+ * @brief "User App Integrity ok?": the user app against its metadata record
+ *
+ * @note  The record is verified at DOWNLOAD_FINISHED, where the image crc is
+ *        at hand (boot_writer_image_crc), so a normal boot costs the record
+ *        crc and two vector reads. The pass over up to 222 KB of image is
+ *        left for a record that was never marked verified, power lost right
+ *        after the download, or for an app with an image header and no
+ *        record at all.
+ */
+
+#include "boot_app.h"
+#include "boot_config.h"
+#include "boot_mailbox.h"
+#include "boot_image.h"
+#include "crc32.h"
+#include "stm32f0xx_hal.h"
+
+/**@brief Enable/Disable debug messages */
+#define BOOT_APP_DEBUG 0
+#define BOOT_APP_TAG "boot app : "
+
+#if BOOT_APP_DEBUG
+#include <stdio.h>
+#define boot_app_dbg(format, ...) printf(BOOT_APP_TAG format, ##__VA_ARGS__)
+#else
+#define boot_app_dbg(format, ...) \
+    do                            \
+    { /* Do nothing */            \
+    } while (0)
+#endif
+
+static uint8_t boot_app_vectors_ok(uint32_t image_size, const boot_image_header_t *header)
+{
+    const uint32_t *vectors = (const uint32_t *)(const void *)flash_driver_map(BOOT_APP_START_ADDR);
+    uint32_t sp = vectors[0];
+    uint32_t reset = vectors[1];
+
+    if (sp < BOOT_RAM_START + 4 || sp > BOOT_RAM_END || (sp & 3U) != 0)
+        return 0;
+
+    /*thumb bit set, entry inside the image*/
+    if ((reset & 1U) == 0 || reset < BOOT_APP_START_ADDR || reset >= BOOT_APP_START_ADDR + image_size)
+        return 0;
+
+    return header == NULL || header->entry == reset;
+}
+
+/**
+ * @brief No record: the header names the image, one pass over it and the
+ *        record is written verified, with the crc32 of the whole image
+ */
+static uint8_t boot_app_adopt(boot_app_t *app, const boot_image_header_t *header)
+{
+    uint32_t plain;
+
+    app->scanned = 1;
+
+    if (boot_image_crc(flash_driver_map(BOOT_APP_START_ADDR), header->image_size, &plain) != header->image_crc)
+        return 0;
+
+    if (boot_meta_save(header->image_size, plain) != FLASH_DRV_OK || !boot_meta_load(&app->meta))
+        return 0;
+
+    /*checked just now, a failed write only costs the next boot another pass*/
+    boot_meta_set_verified(&app->meta);
+    app->meta.verified = 1;
+    return 1;
+}
+
+boot_app_status_t boot_app_check(boot_app_t *app)
+{
+    const boot_image_header_t *header = boot_image_find(flash_driver_map(BOOT_APP_START_ADDR), BOOT_APP_MAX_SIZE);
+
+    app->scanned = 0;
+
+    /*decided from the header alone, nothing read or written for an app this bootloader cannot start*/
+    if (header != NULL && !boot_image_compatible(header))
+    {
+        boot_app_dbg("needs bootloader 0x%06lx\r\n", (unsigned long)header->min_boot_version);
+        boot_meta_load(&app->meta);
+        app->status = BOOT_APP_INCOMPATIBLE;
+        return app->status;
+    }
+
+    if (!boot_meta_load(&app->meta) && (header == NULL || !boot_app_adopt(app, header)))
+    {
+        boot_app_dbg("no record%s\r\n", app->scanned ? ", header crc mismatch" : "");
+        app->status = app->scanned ? BOOT_APP_CORRUPT : BOOT_APP_MISSING;
+        return app->status;
+    }
+
+    if (!boot_app_vectors_ok(app->meta.image_size, header))
+    {
+        boot_app_dbg("bad vectors\r\n");
+        app->status = BOOT_APP_CORRUPT;
+        return app->status;
+    }
+
+    if (!boot_meta_is_verified(&app->meta))
+    {
+        app->scanned = 1;
+
+        if (crc32_compute(flash_driver_map(BOOT_APP_START_ADDR), app->meta.image_size) != app->meta.image_crc)
+        {
+            boot_app_dbg("crc mismatch, %lu bytes\r\n", (unsigned long)app->meta.image_size);
+            app->status = BOOT_APP_CORRUPT;
+            return app->status;
+        }
+
+        /*a failed write only costs the next boot another pass*/
+        boot_meta_set_verified(&app->meta);
+    }
+
+    boot_app_dbg("valid, %lu bytes, generation %lu%s\r\n", (unsigned long)app->meta.image_size,
+                 (unsigned long)app->meta.generation, app->scanned ? ", scanned" : "");
+
+    app->status = BOOT_APP_VALID;
+    return app->status;
+}
+
+void boot_app_jump(const boot_app_t *app)
+{
+    (void)app;
+
+#if defined(__arm__)
+    const uint32_t *vectors = (const uint32_t *)BOOT_APP_START_ADDR;
+    void (*app_reset)(void) = (void (*)(void))(uintptr_t)vectors[1];
+
+    __disable_irq();
+
+    /*AHB clocks back to reset: SRAM and flash interface, CRC and DMA1 off*/
+    RCC->AHBENR = RCC_AHBENR_SRAMEN | RCC_AHBENR_FLITFEN;
+
+    __set_MSP(vectors[0]);
+    __enable_irq();
+
+    app_reset();
+#endif
+
+    while (1)
+    {
+    }
+}
+
+void boot_app_handoff(const boot_app_t *app, uint32_t start_us)
+{
+    /*initial SP and reset vector were checked with the record*/
+    if (app->status != BOOT_APP_VALID)
+        NVIC_SystemReset();
+
+    __disable_irq();
+
+    boot_mailbox_handoff(boot_app_time_us() - start_us);
+
+#if defined(__arm__)
+    /*SysTick off, its pending exception and PendSV dropped*/
+    SysTick->CTRL = 0;
+    SysTick->VAL = 0;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk | SCB_ICSR_PENDSVCLR_Msk;
+
+    /*no interrupt of ours may fire in the app, USART and DMA included*/
+    NVIC->ICER[0] = 0xFFFFFFFFUL;
+    NVIC->ICPR[0] = 0xFFFFFFFFUL;
+
+    /*undo vector_table_to_sram(), the app maps its own table*/
+    __HAL_SYSCFG_REMAPMEMORY_FLASH();
+    __DSB();
+    __ISB();
+
+    boot_app_jump(app);
+#else
+    NVIC_SystemReset();
+
+    while (1)
+    {
+    }
+#endif
+}
+
+uint32_t boot_app_time_us(void)
+{
+#if defined(__arm__)
+    uint32_t load = SysTick->LOAD + 1U;
+    uint32_t tick = HAL_GetTick();
+    uint32_t val = SysTick->VAL;
+
+    /*wrapped while the SysTick handler cannot run to count it*/
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        val = SysTick->VAL;
+        tick++;
+    }
+
+    return tick * 1000U + ((load - 1U - val) * 1000U) / load;
+#else
+    return HAL_GetTick() * 1000U;
+#endif
+}
@@ -0,0 +1,157 @@
+/**
+ * @file boot_delta.c
+ * @brief Streaming decoder of delta updates (BOOT_MODE_DELTA)
+ *
+ * @note  One state per field of an op, so a block boundary may fall
+ *        anywhere. An op is checked as soon as its header is in: inside
+ *        one page of the image, a copy from that page on.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "boot_delta.h"
+#include "flash_driver.h"
+
+void boot_delta_init(boot_delta_t *delta, const uint8_t *old, uint32_t limit, uint32_t size, uint32_t from)
+{
+    memset(delta, 0, offsetof(boot_delta_t, out));
+    delta->old = old;
+    delta->limit = limit;
+    delta->size = size;
+    delta->out_total = from;
+    delta->state = (from == size) ? BOOT_DELTA_DONE : BOOT_DELTA_OP;
+    delta->error = BOOT_ST_OK;
+}
+
+/** Header complete: the op has to stay in the page it starts in */
+static boot_delta_state_t boot_delta_check(boot_delta_t *delta)
+{
+    uint32_t page = delta->out_total & ~(FLASH_DRV_PAGE_SIZE - 1);
+
+    if (delta->len == 0 || delta->len > delta->size - delta->out_total ||
+        delta->out_total + delta->len > page + FLASH_DRV_PAGE_SIZE)
+        delta->error = BOOT_ST_ERR_FORMAT;
+
+    if (delta->op == BOOT_DELTA_INSERT)
+        return BOOT_DELTA_INSERTING;
+
+    /* pages before this one hold the new image already */
+    if (delta->source < page || delta->source > delta->limit || delta->len > delta->limit - delta->source)
+        delta->error = BOOT_ST_ERR_FORMAT;
+
+    return BOOT_DELTA_COPYING;
+}
+
+static uint32_t boot_delta_room(const boot_delta_t *delta, uint32_t want)
+{
+    uint32_t room = BOOT_DELTA_OUT_SIZE - delta->out_len;
+    return (want < room) ? want : room;
+}
+
+static boot_delta_state_t boot_delta_after_op(const boot_delta_t *delta)
+{
+    return (delta->out_total == delta->size) ? BOOT_DELTA_DONE : BOOT_DELTA_OP;
+}
+
+uint32_t boot_delta_decode(boot_delta_t *delta, const uint8_t *in, uint32_t len)
+{
+    uint32_t i = 0;
+    uint8_t starved = 0;
+
+    /* compact what the caller took */
+    if (delta->out_start)
+    {
+        memmove(delta->out, &delta->out[delta->out_start], boot_delta_pending(delta));
+        delta->out_len = boot_delta_pending(delta);
+        delta->out_start = 0;
+    }
+
+    while (!starved && delta->error == BOOT_ST_OK && delta->out_len < BOOT_DELTA_OUT_SIZE)
+    {
+        uint32_t run;
+
+        /* every state but a copy and the end needs input */
+        if (i == len && delta->state != BOOT_DELTA_COPYING && delta->state != BOOT_DELTA_DONE)
+        {
+            starved = 1;
+            break;
+        }
+
+        switch (delta->state)
+        {
+        case BOOT_DELTA_OP:
+            delta->op = in[i++];
+            delta->len = 0;
+            delta->source = 0;
+            delta->field = 0;
+            if (delta->op != BOOT_DELTA_INSERT && delta->op != BOOT_DELTA_COPY)
+                delta->error = BOOT_ST_ERR_FORMAT;
+            delta->state = BOOT_DELTA_LEN;
+            break;
+
+        case BOOT_DELTA_LEN:
+            delta->len |= (uint32_t)in[i++] << (8 * delta->field++);
+            if (delta->field < 2)
+                break;
+
+            delta->field = 0;
+            if (delta->op == BOOT_DELTA_COPY)
+                delta->state = BOOT_DELTA_SOURCE;
+            else
+                delta->state = boot_delta_check(delta);
+            break;
+
+        case BOOT_DELTA_SOURCE:
+            delta->source |= (uint32_t)in[i++] << (8 * delta->field++);
+            if (delta->field == 4)
+                delta->state = boot_delta_check(delta);
+            break;
+
+        case BOOT_DELTA_INSERTING:
+            run = boot_delta_room(delta, delta->len);
+            if (run > len - i)
+                run = len - i;
+
+            memcpy(&delta->out[delta->out_len], &in[i], run);
+            delta->out_len += (uint16_t)run;
+            delta->out_total += run;
+            delta->len -= run;
+            i += run;
+
+            if (delta->len == 0)
+                delta->state = boot_delta_after_op(delta);
+            break;
+
+        case BOOT_DELTA_COPYING:
+            run = boot_delta_room(delta, delta->len);
+
+            memcpy(&delta->out[delta->out_len], &delta->old[delta->source], run);
+            delta->out_len += (uint16_t)run;
+            delta->out_total += run;
+            delta->source += run;
+            delta->len -= run;
+
+            if (delta->len == 0)
+                delta->state = boot_delta_after_op(delta);
+            break;
+
+        case BOOT_DELTA_DONE:
+        default:
+            if (i != len)
+                delta->error = BOOT_ST_ERR_FORMAT;      /* data past the image */
+            starved = 1;
+            break;
+        }
+    }
+
+    delta->in_total += i;
+    return i;
+}
+
+void boot_delta_consume(boot_delta_t *delta, uint16_t n)
+{
+    delta->out_start += n;
+
+    if (delta->out_start == delta->out_len)
+        delta->out_start = delta->out_len = 0;
+}
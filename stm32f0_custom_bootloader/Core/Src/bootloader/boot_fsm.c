@@ -0,0 +1,1246 @@
+/**
+ * @file boot_fsm.c
+ * @brief Bootloader download state machine (Doc/stm32-bootloader-fsm.drawio)
+ *
+ * @note  Every request from the gateway is a boot_protocol frame and gets
+ *        exactly one reply. In BOOT_MODE_HEX_LINE the image comes as ASCII
+ *        Intel HEX records, one per frame, like the original design. In
+ *        BOOT_MODE_BINARY each frame carries up to BOOT_BLOCK_MAX_DATA raw
+ *        bytes and their load address, so the wire carries half the bytes
+ *        of the hex encoding and a fraction of the per-line round trips.
+ *
+ *        Binary blocks are not confirmed one by one: the host keeps a window
+ *        of blocks in flight (boot_window.h), the acks carry the cumulative
+ *        and selective state, and the flash is programmed in the background
+ *        while the next blocks arrive. Link latency is hidden as long as the
+ *        window covers the round trip.
+ *
+ *        A binary download that names its image crc is journaled in the
+ *        metadata log as pages get committed; after a reset or a new
+ *        BOOT_START_DOWNLOAD of the same image it goes on from there.
+ *
+ *        BOOT_MODE_BINARY_LZ takes the same windowed blocks, their data is
+ *        the compressed stream: the blocks go through the decoder in order,
+ *        its output to the writer at the next image address.
+ *
+ *        BOOT_MODE_BINARY_SPARSE sends only the pages that differ from the
+ *        page crcs of BOOT_CMD_GET_MANIFEST, the writer leaves the others.
+ *        BOOT_MODE_SEGMENTS sends the loaded ranges of the ELF / HEX file
+ *        as a segment list, the pages between them are left the same way.
+ *
+ *        BOOT_MODE_DELTA does the same with a patch against the app in
+ *        flash. The writer rebuilds it in place: every page goes to the
+ *        scratch page and into the journal before its erase, a reset in
+ *        between finishes that page from the scratch page and goes on.
+ */
+
+#include <string.h>
+#include "boot_fsm.h"
+#include "boot_meta.h"
+#include "boot_app.h"
+#include "boot_image.h"
+#include "crc32.h"
+
+/**@brief Enable/Disable debug messages */
+#define BOOT_FSM_DBG 0
+#define BOOT_FSM_TAG "boot fsm : "
+
+#if BOOT_FSM_DBG
+#include <stdio.h>
+#define boot_fsm_dbg(format, ...) printf(BOOT_FSM_TAG format, ##__VA_ARGS__)
+#else
+#define boot_fsm_dbg(format, ...) \
+    do                            \
+    { /* Do nothing */            \
+    } while (0)
+#endif
+
+static void enter_seq_idle(boot_fsm_t *handle);
+static void enter_seq_download(boot_fsm_t *handle);
+static void enter_seq_reset(boot_fsm_t *handle);
+
+static void boot_fsm_set_next_state(boot_fsm_t *handle, boot_state_t state)
+{
+    handle->state = state;
+    handle->event.name = ev_boot_invalid;
+}
+
+/**
+ * @brief Queue a reply the tx ring had no room for
+ * @return uint8_t 1 once nothing is waiting
+ */
+static uint8_t boot_fsm_flush(boot_fsm_t *handle)
+{
+    if (handle->iface.reply_len && uart_transmit_it(handle->iface.link, handle->iface.reply, handle->iface.reply_len))
+        handle->iface.reply_len = 0;
+
+    return handle->iface.reply_len == 0;
+}
+
+/**
+ * @brief Send the reply to the frame in the parser: cmd | BOOT_CMD_REPLY,
+ *        same seq, status and optional extra bytes.
+ * @note  A full tx ring (an escaped manifest, XOFF from the host) keeps the
+ *        reply in iface.reply, boot_fsm_run() queues it before it takes the
+ *        next request. Only a reply on top of a waiting one is lost.
+ */
+static void boot_fsm_send(boot_fsm_t *handle, uint8_t cmd, uint16_t seq, boot_status_t status, const uint8_t *extra, uint8_t extra_len)
+{
+    uint8_t payload[BOOT_REPLY_MAX_PAYLOAD];
+
+    if (!boot_fsm_flush(handle))
+    {
+        handle->iface.replies_dropped++;
+        boot_fsm_dbg("reply 0x%02x dropped\r\n", cmd);
+        return;
+    }
+
+    payload[0] = (uint8_t)status;
+    for (uint8_t i = 0; i < extra_len && i < BOOT_REPLY_MAX_PAYLOAD - 1; i++)
+        payload[1 + i] = extra[i];
+
+    uint16_t len = boot_frame_encode(handle->iface.reply, cmd | BOOT_CMD_REPLY, seq, payload, 1 + extra_len);
+    if (!uart_transmit_it(handle->iface.link, handle->iface.reply, (uint8_t)len))
+        handle->iface.reply_len = (uint8_t)len;
+}
+
+static void boot_fsm_reply(boot_fsm_t *handle, boot_status_t status, const uint8_t *extra, uint8_t extra_len)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    boot_fsm_send(handle, frame->cmd, frame->seq, status, extra, extra_len);
+}
+
+/** ENTER_BOOT_OK, with the bootloader version the image headers are checked against */
+static void boot_fsm_enter_ok(boot_fsm_t *handle, uint16_t seq)
+{
+    uint8_t version[BOOT_ENTER_REPLY_SIZE];
+
+    boot_put_u32(version, BOOT_VERSION);
+    boot_fsm_send(handle, BOOT_CMD_ENTER_BOOT, seq, BOOT_ST_OK, version, sizeof(version));
+}
+
+/** Binary blocks through the receive window, compressed or not */
+static uint8_t boot_fsm_windowed(boot_fsm_t *handle)
+{
+    return handle->iface.mode != BOOT_MODE_HEX_LINE;
+}
+
+/** Blocks carry image addresses, in order: checked against the app area, journaled */
+static uint8_t boot_fsm_addressed(boot_fsm_t *handle)
+{
+    return handle->iface.mode == BOOT_MODE_BINARY || handle->iface.mode == BOOT_MODE_BINARY_SPARSE;
+}
+
+/** Sticky download error: flash, or a broken compressed stream / patch */
+static boot_status_t boot_fsm_error(boot_fsm_t *handle)
+{
+    if (handle->iface.writer.error != BOOT_ST_OK)
+        return handle->iface.writer.error;
+
+    if (handle->iface.mode == BOOT_MODE_BINARY_LZ)
+        return handle->iface.lz.error;
+
+    if (handle->iface.mode == BOOT_MODE_DELTA)
+        return handle->iface.delta.error;
+
+    if (handle->iface.mode == BOOT_MODE_SEGMENTS)
+        return handle->iface.seg.error;
+
+    return BOOT_ST_OK;
+}
+
+static boot_event_name_t boot_fsm_cmd_to_event(uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case BOOT_CMD_ENTER_BOOT: return ev_boot_enter;
+    case BOOT_CMD_START_DOWNLOAD: return ev_boot_start_download;
+    case BOOT_CMD_DOWNLOAD_LINE: return ev_boot_download_line;
+    case BOOT_CMD_DOWNLOAD_BLOCK: return ev_boot_download_block;
+    case BOOT_CMD_DOWNLOAD_FINISHED: return ev_boot_download_finished;
+    case BOOT_CMD_CANCEL_BOOT: return ev_boot_cancel;
+    case BOOT_CMD_GET_MANIFEST: return ev_boot_manifest;
+    default: return ev_boot_invalid;
+    }
+}
+
+/**
+ * @brief A frame failed its crc. A binary block the window still waits for
+ *        gets its NACK right away, with the ack, so the host sends that
+ *        block again without waiting for its timeout; the blocks after it
+ *        are kept. A header hit by the error rarely names such a block.
+ */
+static void boot_fsm_nack(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    boot_window_t *window = &handle->iface.window;
+    uint8_t ack[BOOT_WINDOW_ACK_SIZE];
+
+    if (handle->state != st_boot_download || !boot_fsm_windowed(handle) ||
+        frame->cmd != BOOT_CMD_DOWNLOAD_BLOCK || (uint16_t)(frame->seq - window->next) >= window->size)
+    {
+        boot_fsm_reply(handle, BOOT_ST_ERR_CRC, NULL, 0);
+        return;
+    }
+
+    boot_window_ack(window, ack);
+    boot_fsm_reply(handle, BOOT_ST_ERR_CRC, ack, sizeof(ack));
+}
+
+/**
+ * @brief Feed link bytes to the frame parser until a request is complete.
+ * @note  Bytes after a complete frame stay in the ring, the frame buffer is
+ *        owned by the state machine until the event has been handled.
+ *        A frame the link goes quiet in for BOOT_FRAME_GAP_TIMEOUT lost a
+ *        byte and is dropped; not while the peer is held by XOFF.
+ */
+static void boot_fsm_poll_link(boot_fsm_t *handle)
+{
+    uint8_t chunk[BOOT_RX_CHUNK_SIZE];
+    uint16_t len = uart_get_rx_data_len(handle->iface.link);
+
+    if (len || handle->iface.link->flow.rx_paused)
+        time_event_start(&handle->event.time.frame_gap, BOOT_FRAME_GAP_TIMEOUT);
+    else if (time_event_is_raised(&handle->event.time.frame_gap))
+    {
+        time_event_stop(&handle->event.time.frame_gap);
+        if (boot_frame_parser_idle(&handle->iface.parser))
+            boot_fsm_dbg("frame truncated\r\n");
+    }
+
+    while (len && handle->event.name == ev_boot_invalid && handle->iface.reply_len == 0)
+    {
+        uint8_t n = (len > BOOT_RX_CHUNK_SIZE) ? BOOT_RX_CHUNK_SIZE : (uint8_t)len;
+        uint8_t used = 0;
+
+        uart_fetch_rx_data(handle->iface.link, chunk, n);
+
+        /*a NACK waiting for the tx ring: the next request would have nowhere to reply*/
+        while (used < n && handle->event.name == ev_boot_invalid && handle->iface.reply_len == 0)
+        {
+            boot_parse_result_t result = boot_frame_parse(&handle->iface.parser, chunk[used++]);
+
+            if (result == BOOT_PARSE_ERROR)
+            {
+                boot_fsm_dbg("frame crc error\r\n");
+                boot_fsm_nack(handle);
+            }
+            else if (result == BOOT_PARSE_FRAME)
+            {
+                handle->event.name = boot_fsm_cmd_to_event(handle->iface.parser.frame.cmd);
+                if (handle->event.name == ev_boot_invalid)
+                    boot_fsm_reply(handle, BOOT_ST_ERR_FORMAT, NULL, 0);
+            }
+        }
+
+        uart_read_rx_data(handle->iface.link, chunk, used);
+        len -= used;
+    }
+}
+
+/*=========================== download helpers ==============================*/
+
+/**
+ * @brief Progress of a resumable download to the metadata log, once step
+ *        more bytes are committed. A record that needs the log compacted
+ *        (a page erase) waits for a moment the writer could erase too.
+ */
+static void boot_fsm_journal(boot_fsm_t *handle, uint32_t step, uint8_t may_erase)
+{
+    uint32_t committed = boot_writer_committed(&handle->iface.writer) - BOOT_APP_START_ADDR;
+
+    /*one operation at a time on the flash controller, delta updates journal their staged pages*/
+    if (handle->iface.image_crc == 0 || !boot_fsm_addressed(handle) ||
+        handle->iface.writer.flash != BOOT_FLASH_IDLE)
+        return;
+
+    /* whole pages, the last one of the image is written again on resume */
+    if (committed > handle->iface.image_size)
+        committed = handle->iface.image_size & ~(FLASH_DRV_PAGE_SIZE - 1);
+
+    if (committed < handle->iface.journaled + step)
+        return;
+
+    if (!may_erase && !boot_meta_progress_fits())
+        return;
+
+    if (boot_meta_save_progress(handle->iface.image_size, handle->iface.image_crc, committed) == FLASH_DRV_OK)
+        handle->iface.journaled = committed;
+}
+
+/**
+ * @brief Pages an interrupted download of the same image left in flash are
+ *        kept, their blocks count as received. Anything else drops the
+ *        journal before the app area is touched.
+ */
+static boot_status_t boot_fsm_resume_download(boot_fsm_t *handle)
+{
+    uint32_t resumed = 0;
+
+    if (handle->iface.image_crc != 0)
+        resumed = boot_meta_progress(handle->iface.image_size, handle->iface.image_crc);
+
+    if (resumed == 0)
+        return (boot_meta_save_progress(0, 0, 0) == FLASH_DRV_OK) ? BOOT_ST_OK : BOOT_ST_ERR_FLASH;
+
+    boot_writer_resume(&handle->iface.writer, resumed);
+    handle->iface.resumed = resumed;
+    handle->iface.journaled = resumed;
+
+    uint32_t blocks = resumed / BOOT_BLOCK_MAX_DATA;
+    handle->iface.pending = (handle->iface.pending > blocks) ? handle->iface.pending - blocks : 0;
+
+    boot_fsm_dbg("download resumed at %lu bytes\r\n", (unsigned long)resumed);
+    return BOOT_ST_OK;
+}
+
+/**
+ * @brief A delta update applies to the verified image it was made against,
+ *        or goes on where an interrupted one of the same image stopped:
+ *        its base is partly overwritten by then.
+ */
+static boot_status_t boot_fsm_delta_base(boot_fsm_t *handle, uint32_t base_size, uint32_t base_crc)
+{
+    uint32_t offset;
+    uint32_t page_crc;
+    boot_meta_t meta;
+
+    if (boot_meta_staged(handle->iface.image_size, handle->iface.image_crc, &offset, &page_crc))
+        return BOOT_ST_OK;
+
+    if (!boot_meta_load(&meta) || !boot_meta_is_verified(&meta) ||
+        meta.image_size != base_size || meta.image_crc != base_crc)
+        return BOOT_ST_ERR_BASE;
+
+    return BOOT_ST_OK;
+}
+
+/** Writer callback: a page is in the scratch page, journal it before its erase */
+static flash_drv_st_t boot_fsm_stage(void *ctx, uint32_t address)
+{
+    boot_fsm_t *handle = (boot_fsm_t *)ctx;
+    uint32_t crc = crc32_compute(flash_driver_map(BOOT_SCRATCH_ADDR), FLASH_DRV_PAGE_SIZE);
+
+    return boot_meta_save_staged(handle->iface.image_size, handle->iface.image_crc,
+                                 address - BOOT_APP_START_ADDR, crc);
+}
+
+/**
+ * @brief Delta update: the page last staged is whole in flash, or it is
+ *        programmed again from the scratch page; the patch goes on after
+ *        it. A new update starts its journal.
+ */
+static boot_status_t boot_fsm_resume_delta(boot_fsm_t *handle)
+{
+    uint32_t offset;
+    uint32_t page_crc;
+    uint32_t resumed;
+
+    if (!boot_meta_staged(handle->iface.image_size, handle->iface.image_crc, &offset, &page_crc))
+        return (boot_meta_save_staged(handle->iface.image_size, handle->iface.image_crc, BOOT_META_NO_STAGE, 0) ==
+                FLASH_DRV_OK) ? BOOT_ST_OK : BOOT_ST_ERR_FLASH;
+
+    if (offset == BOOT_META_NO_STAGE)
+        return BOOT_ST_OK;
+
+    uint32_t address = BOOT_APP_START_ADDR + offset;
+
+    if (crc32_compute(flash_driver_map(address), FLASH_DRV_PAGE_SIZE) != page_crc)
+    {
+        /*reset between the erase and the end of programming*/
+        if (crc32_compute(flash_driver_map(BOOT_SCRATCH_ADDR), FLASH_DRV_PAGE_SIZE) != page_crc)
+        {
+            boot_meta_save_progress(0, 0, 0);
+            return BOOT_ST_ERR_BASE;
+        }
+
+        if (flash_driver_erase(address, 1) != FLASH_DRV_OK ||
+            flash_driver_program(address, flash_driver_map(BOOT_SCRATCH_ADDR), FLASH_DRV_PAGE_SIZE) != FLASH_DRV_OK)
+            return BOOT_ST_ERR_FLASH;
+    }
+
+    resumed = offset + FLASH_DRV_PAGE_SIZE;
+    if (resumed > handle->iface.image_size)
+        resumed = handle->iface.image_size;
+
+    boot_writer_resume(&handle->iface.writer, resumed);
+    handle->iface.resumed = resumed;
+
+    boot_fsm_dbg("delta update resumed at %lu bytes\r\n", (unsigned long)resumed);
+    return BOOT_ST_OK;
+}
+
+static boot_status_t boot_fsm_start_download(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+
+    handle->iface.resumed = 0;
+    handle->iface.journaled = 0;
+    handle->iface.image_crc = 0;
+
+    if (frame->len < 9 || frame->payload[0] > BOOT_MODE_SEGMENTS)
+        return BOOT_ST_ERR_FORMAT;
+
+    handle->iface.mode = (boot_mode_t)frame->payload[0];
+    handle->iface.pending = boot_get_u32(&frame->payload[1]);
+    handle->iface.image_size = boot_get_u32(&frame->payload[5]);
+    handle->iface.seq = frame->seq;
+    handle->iface.seq_status = BOOT_ST_OK;
+
+    if (handle->iface.image_size > BOOT_APP_MAX_SIZE)
+        return BOOT_ST_ERR_ADDRESS;
+
+    if (boot_fsm_windowed(handle) && handle->iface.window.size == 0)
+        return BOOT_ST_ERR_STATE;
+
+    /*the decoder stops at the image size, segments have to stay in the span*/
+    if ((handle->iface.mode == BOOT_MODE_BINARY_LZ || handle->iface.mode == BOOT_MODE_SEGMENTS) &&
+        handle->iface.image_size == 0)
+        return BOOT_ST_ERR_FORMAT;
+
+    /*binary blocks come in address order, the journal can tell where they stopped*/
+    if (frame->len >= 13 && boot_fsm_addressed(handle) && handle->iface.image_size != 0)
+        handle->iface.image_crc = boot_get_u32(&frame->payload[9]);
+
+    /*only the pages that differ come, the host cannot count them before the resume offset*/
+    if (handle->iface.mode == BOOT_MODE_BINARY_SPARSE)
+        handle->iface.pending = 0;
+
+    /*the patch is rebuilt against what the app area holds, before anything of it is touched*/
+    if (handle->iface.mode == BOOT_MODE_DELTA)
+    {
+        if (frame->len < 21 || handle->iface.image_size == 0)
+            return BOOT_ST_ERR_FORMAT;
+
+        handle->iface.image_crc = boot_get_u32(&frame->payload[9]);
+        handle->iface.pending = 0;  /* patch blocks, only known from the resume offset on */
+
+        boot_status_t status = boot_fsm_delta_base(handle, boot_get_u32(&frame->payload[13]),
+                                                   boot_get_u32(&frame->payload[17]));
+        if (status != BOOT_ST_OK)
+            return status;
+    }
+
+    boot_window_reset(&handle->iface.window, (uint16_t)(frame->seq + 1));
+
+    /*the match ring takes one window slot*/
+    if (handle->iface.mode == BOOT_MODE_BINARY_LZ)
+    {
+        uint8_t *ring = boot_window_lend(&handle->iface.window);
+        if (ring == NULL)
+            return BOOT_ST_ERR_STATE;
+
+        boot_lz_init(&handle->iface.lz, ring, handle->iface.image_size);
+    }
+
+    if (handle->iface.mode == BOOT_MODE_SEGMENTS)
+        boot_seg_init(&handle->iface.seg, BOOT_APP_START_ADDR, BOOT_APP_START_ADDR + handle->iface.image_size);
+
+    boot_hex_init(&handle->iface.hex);
+    boot_writer_init(&handle->iface.writer, BOOT_APP_START_ADDR, BOOT_APP_END_ADDR);
+    handle->iface.writer.erase_ahead = BOOT_FLASH_STALLS_RX;
+    if (handle->iface.mode == BOOT_MODE_BINARY_SPARSE || handle->iface.mode == BOOT_MODE_SEGMENTS)
+    {
+        handle->iface.writer.keep_holes = 1;
+        handle->iface.writer.erase_ahead = 0;
+    }
+    if (handle->iface.image_size != 0)
+        handle->iface.writer.erase_end = BOOT_APP_START_ADDR + handle->iface.image_size;
+
+    /*Invalidate CRC and LEN right before the writer first erases or programs: an image refused at its header leaves the app as it was*/
+    handle->iface.writer.touch = boot_meta_invalidate;
+
+    /*a delta update is journaled before that, a cut right after the invalidate still resumes on its base*/
+    if (handle->iface.mode == BOOT_MODE_DELTA)
+    {
+        boot_status_t status = boot_fsm_resume_delta(handle);
+        if (status != BOOT_ST_OK)
+            return status;
+
+        boot_writer_set_scratch(&handle->iface.writer, BOOT_SCRATCH_ADDR, boot_fsm_stage, handle);
+        boot_delta_init(&handle->iface.delta, flash_driver_map(BOOT_APP_START_ADDR), BOOT_APP_MAX_SIZE,
+                        handle->iface.image_size, handle->iface.resumed);
+    }
+    else if (boot_fsm_resume_download(handle) != BOOT_ST_OK)
+    {
+        return BOOT_ST_ERR_FLASH;
+    }
+
+    /*first pages while the host waits for the reply anyway*/
+    uint8_t due;
+    while (boot_writer_erase_next(&handle->iface.writer, &due) != BOOT_WRITER_NO_PAGE ||
+           handle->iface.writer.flash != BOOT_FLASH_IDLE)
+    {
+        if (boot_writer_service(&handle->iface.writer, 1) != BOOT_ST_OK)
+            return BOOT_ST_ERR_FLASH;
+    }
+
+    boot_fsm_dbg("download started, mode %u, %lu frames\r\n", handle->iface.mode, (unsigned long)handle->iface.pending);
+    return BOOT_ST_OK;
+}
+
+static boot_status_t boot_fsm_download_line(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    boot_hex_record_t record;
+
+    if (!boot_hex_decode(frame->payload, frame->len, &record))
+        return BOOT_ST_ERR_FORMAT;
+
+    uint32_t address = boot_hex_address(&handle->iface.hex, &record);
+
+    if (record.type == BOOT_HEX_DATA)
+        return boot_writer_write_all(&handle->iface.writer, address, record.data, record.len);
+
+    return BOOT_ST_OK;
+}
+
+/**
+ * @brief Store a binary block in the receive window and acknowledge it
+ * @note  Duplicates (ack lost on the way back) are acknowledged again,
+ *        blocks beyond the window are dropped, the ack tells the host
+ *        where the window stands. An empty block is a window probe.
+ */
+static void boot_fsm_download_block(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    boot_writer_t *writer = &handle->iface.writer;
+    uint8_t ack[BOOT_WINDOW_ACK_SIZE];
+    boot_status_t status = BOOT_ST_OK;
+
+    if (frame->len == 0)
+    {
+        /* window probe, only the ack is wanted */
+    }
+    else if (frame->len <= BOOT_BLOCK_ADDR_SIZE)
+    {
+        status = BOOT_ST_ERR_FORMAT;
+    }
+    else
+    {
+        uint32_t address = boot_get_u32(frame->payload);
+        uint16_t len = frame->len - BOOT_BLOCK_ADDR_SIZE;
+
+        /* compressed: a stream offset, checked in order by the decoder */
+        if (boot_fsm_addressed(handle) &&
+            (address < writer->start || address > writer->end || len > writer->end - address))
+            status = BOOT_ST_ERR_ADDRESS;
+        else if (boot_window_put(&handle->iface.window, frame->seq, address,
+                                 &frame->payload[BOOT_BLOCK_ADDR_SIZE], len) == BOOT_WINDOW_OUTSIDE)
+            status = BOOT_ST_ERR_SEQUENCE;
+    }
+
+    if (boot_fsm_error(handle) != BOOT_ST_OK)
+        status = boot_fsm_error(handle);
+
+    boot_window_ack(&handle->iface.window, ack);
+    boot_fsm_reply(handle, status, ack, sizeof(ack));
+}
+
+/**
+ * @brief Window update: the host stopped at the limit of the last ack, tell
+ *        it once half of the window is free again.
+ */
+static void boot_fsm_window_update(boot_fsm_t *handle)
+{
+    boot_window_t *window = &handle->iface.window;
+    uint8_t ack[BOOT_WINDOW_ACK_SIZE];
+    uint16_t limit = (uint16_t)(window->write + window->size);
+
+    if (window->hold || (uint16_t)(limit - window->limit) < (window->size + 1) / 2)
+        return;
+
+    boot_window_ack(window, ack);
+    boot_fsm_send(handle, BOOT_CMD_DOWNLOAD_BLOCK, (uint16_t)(window->next - 1), boot_fsm_error(handle), ack, sizeof(ack));
+}
+
+/**
+ * @brief May the writer start an erase now?
+ * @note  With BOOT_FLASH_STALLS_RX the link has to be silent first: the
+ *        window is held once an erase is due (boot_writer_erase_next()),
+ *        and erases run when every block up to the held limit is in and
+ *        nothing is on its way. The pages ahead are erased in the same
+ *        pause before the window opens again.
+ *        Otherwise bytes keep coming in during an erase but acks wait for
+ *        it: erase when due, or ahead while the link and the writer idle.
+ *        On an XON/XOFF link the erase waits until the XOFF is sent.
+ */
+static uint8_t boot_fsm_erase_gate(boot_fsm_t *handle)
+{
+    boot_writer_t *writer = &handle->iface.writer;
+    uint8_t due;
+
+    if (!boot_fsm_windowed(handle))
+        return 0;   /* hex lines erase inline, the host waits for each reply */
+
+    uint32_t next = boot_writer_erase_next(writer, &due);
+
+#if BOOT_FLASH_STALLS_RX
+    boot_window_t *window = &handle->iface.window;
+
+    if (!window->hold)
+    {
+        if (next == BOOT_WRITER_NO_PAGE || !due)
+            return 0;
+
+        boot_window_hold(window, 1);
+    }
+
+    /* every block is in: DOWNLOAD_FINISHED may come any time, it erases what is left */
+    uint8_t all_in = handle->iface.pending == (uint16_t)(window->next - window->write);
+    uint8_t silent = handle->iface.parser.state == BOOT_PARSER_SOF &&
+                     uart_get_rx_data_len(handle->iface.link) == 0;
+
+    if (!all_in && (!boot_window_full(window) || !silent))
+        return 0;
+
+    if (all_in || (next == BOOT_WRITER_NO_PAGE && writer->flash == BOOT_FLASH_IDLE))
+    {
+        boot_window_hold(window, 0);
+        boot_fsm_window_update(handle);
+        return 0;
+    }
+
+    return 1;
+#else
+    uart_driver_t *link = handle->iface.link;
+    uint8_t erase = next != BOOT_WRITER_NO_PAGE &&
+                    (due || (writer->queued == 0 && handle->iface.parser.state == BOOT_PARSER_SOF &&
+                             uart_get_rx_data_len(link) == 0));
+
+    if (!link->flow.enabled)
+        return erase;
+
+    /*XON/XOFF link: the host is paused, the XOFF has left the wire before the erase starts, XON once it is over*/
+    if (!erase)
+    {
+        if (link->flow.hold && writer->flash == BOOT_FLASH_IDLE)
+            uart_flow_hold(link, 0);
+        return 0;
+    }
+
+    if (!link->flow.hold)
+        uart_flow_hold(link, 1);
+
+    return uart_tx_idle(link);
+#endif
+}
+
+/** The oldest block is used up, its slot goes back to the window */
+static void boot_fsm_block_done(boot_fsm_t *handle)
+{
+    boot_window_release(&handle->iface.window);
+    boot_fsm_window_update(handle);
+    if (handle->iface.pending)
+        handle->iface.pending--;
+}
+
+/**
+ * @brief BOOT_MODE_BINARY_LZ: decoded bytes to the writer, the in-order
+ *        blocks to the decoder while the writer takes all it produces
+ */
+static void boot_fsm_lz_service(boot_fsm_t *handle)
+{
+    boot_lz_t *lz = &handle->iface.lz;
+
+    while (boot_fsm_error(handle) == BOOT_ST_OK)
+    {
+        uint16_t pending = boot_lz_pending(lz);
+
+        if (pending)
+        {
+            uint32_t taken = 0;
+
+            boot_writer_write(&handle->iface.writer, BOOT_APP_START_ADDR + lz->out_total - pending,
+                              &lz->out[lz->out_start], pending, &taken);
+            boot_lz_consume(lz, (uint16_t)taken);
+
+            if (taken < pending)
+                return;     /* page buffers full */
+        }
+
+        boot_slot_t *slot = boot_window_peek(&handle->iface.window);
+
+        if (slot == NULL)
+        {
+            /* the rest of a match needs no input */
+            boot_lz_decode(lz, NULL, 0);
+            if (!boot_lz_pending(lz))
+                return;
+            continue;
+        }
+
+        /* blocks are consecutive pieces of the stream */
+        if (slot->done == 0 && slot->address != lz->in_total)
+        {
+            lz->error = BOOT_ST_ERR_ADDRESS;
+            return;
+        }
+
+        slot->done += (uint16_t)boot_lz_decode(lz, &slot->data[slot->done], slot->len - slot->done);
+
+        if (slot->done == slot->len)
+            boot_fsm_block_done(handle);
+    }
+}
+
+/**
+ * @brief BOOT_MODE_DELTA: rebuilt bytes to the writer, the in-order patch
+ *        blocks to the decoder while the writer takes all it produces
+ */
+static void boot_fsm_delta_service(boot_fsm_t *handle)
+{
+    boot_delta_t *delta = &handle->iface.delta;
+
+    while (boot_fsm_error(handle) == BOOT_ST_OK)
+    {
+        uint16_t pending = boot_delta_pending(delta);
+
+        if (pending)
+        {
+            uint32_t taken = 0;
+
+            boot_writer_write(&handle->iface.writer, BOOT_APP_START_ADDR + delta->out_total - pending,
+                              &delta->out[delta->out_start], pending, &taken);
+            boot_delta_consume(delta, (uint16_t)taken);
+
+            if (taken < pending)
+                return;     /* page buffers full */
+        }
+
+        boot_slot_t *slot = boot_window_peek(&handle->iface.window);
+
+        if (slot == NULL)
+        {
+            /* the rest of a copy needs no input */
+            boot_delta_decode(delta, NULL, 0);
+            if (!boot_delta_pending(delta))
+                return;
+            continue;
+        }
+
+        /* blocks are consecutive pieces of the patch */
+        if (slot->done == 0 && slot->address != delta->in_total)
+        {
+            delta->error = BOOT_ST_ERR_ADDRESS;
+            return;
+        }
+
+        slot->done += (uint16_t)boot_delta_decode(delta, &slot->data[slot->done], slot->len - slot->done);
+
+        if (slot->done == slot->len)
+            boot_fsm_block_done(handle);
+    }
+}
+
+/**
+ * @brief BOOT_MODE_SEGMENTS: headers to the parser, segment data from the
+ *        in-order blocks straight to the writer at its load address
+ */
+static void boot_fsm_seg_service(boot_fsm_t *handle)
+{
+    boot_seg_t *seg = &handle->iface.seg;
+
+    while (boot_fsm_error(handle) == BOOT_ST_OK)
+    {
+        boot_slot_t *slot = boot_window_peek(&handle->iface.window);
+
+        if (slot == NULL)
+            return;
+
+        /* blocks are consecutive pieces of the list */
+        if (slot->done == 0 && slot->address != seg->in_total)
+        {
+            seg->error = BOOT_ST_ERR_ADDRESS;
+            return;
+        }
+
+        uint32_t run = boot_seg_run(seg, slot->len - slot->done);
+
+        if (run)
+        {
+            uint32_t taken = 0;
+
+            boot_writer_write(&handle->iface.writer, seg->address, &slot->data[slot->done], run, &taken);
+            boot_seg_consume(seg, &slot->data[slot->done], taken);
+            slot->done += (uint16_t)taken;
+
+            if (taken < run)
+                return;     /* page buffers full */
+        }
+        else
+        {
+            slot->done += (uint16_t)boot_seg_decode(seg, &slot->data[slot->done], slot->len - slot->done);
+        }
+
+        if (slot->done == slot->len)
+            boot_fsm_block_done(handle);
+    }
+}
+
+/**
+ * @brief Hand the next in-order block to the writer and run a flash step
+ * @return uint8_t 1 while there is flash work left
+ */
+static uint8_t boot_fsm_download_service(boot_fsm_t *handle, uint8_t may_erase)
+{
+    boot_slot_t *slot = boot_window_peek(&handle->iface.window);
+    uint8_t decoding = 0;
+
+    if (handle->iface.mode == BOOT_MODE_BINARY_LZ)
+    {
+        boot_fsm_lz_service(handle);
+        decoding = boot_lz_busy(&handle->iface.lz);
+    }
+    else if (handle->iface.mode == BOOT_MODE_DELTA)
+    {
+        boot_fsm_delta_service(handle);
+        decoding = boot_delta_busy(&handle->iface.delta);
+    }
+    else if (handle->iface.mode == BOOT_MODE_SEGMENTS)
+    {
+        boot_fsm_seg_service(handle);
+    }
+    else if (slot != NULL)
+    {
+        uint32_t taken = 0;
+
+        boot_writer_write(&handle->iface.writer, slot->address + slot->done, &slot->data[slot->done],
+                          slot->len - slot->done, &taken);
+        slot->done += (uint16_t)taken;
+
+        if (slot->done == slot->len)
+            boot_fsm_block_done(handle);
+    }
+
+    boot_writer_service(&handle->iface.writer, may_erase);
+    boot_fsm_journal(handle, BOOT_RESUME_JOURNAL_STEP, may_erase);
+
+    return (boot_window_peek(&handle->iface.window) != NULL || decoding || handle->iface.writer.queued ||
+            handle->iface.writer.flash != BOOT_FLASH_IDLE) &&
+           boot_fsm_error(handle) == BOOT_ST_OK;
+}
+
+/**
+ * @brief Download cut short: the blocks already acked go to flash, then
+ *        the journal, so a resume does not need them again. A delta update
+ *        stops where it is, a few patch blocks may rebuild many pages and
+ *        every staged page is journaled already.
+ */
+static void boot_fsm_download_interrupted(boot_fsm_t *handle)
+{
+    if (handle->iface.image_crc == 0 || handle->iface.mode == BOOT_MODE_DELTA)
+        return;
+
+    while (boot_fsm_download_service(handle, 1))
+        ;
+
+    boot_fsm_journal(handle, 1, 1);
+}
+
+/**
+ * @brief Hex lines must follow the previous seq, a repeated line (reply
+ *        lost on the way back) is confirmed again without being rewritten.
+ */
+static void boot_fsm_download_line_data(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    uint16_t expected = (uint16_t)(handle->iface.seq + 1);
+    boot_status_t status;
+
+    if (frame->seq == handle->iface.seq)
+    {
+        boot_fsm_reply(handle, handle->iface.seq_status, NULL, 0);
+        return;
+    }
+
+    if (frame->seq != expected)
+    {
+        uint8_t extra[2];
+        boot_put_u16(extra, expected);
+        boot_fsm_reply(handle, BOOT_ST_ERR_SEQUENCE, extra, sizeof(extra));
+        return;
+    }
+
+    if (handle->iface.pending == 0)
+        status = BOOT_ST_ERR_STATE;
+    else
+        status = boot_fsm_download_line(handle);
+
+    if (status == BOOT_ST_OK)
+        handle->iface.pending--;
+
+    handle->iface.seq = frame->seq;
+    handle->iface.seq_status = status;
+    boot_fsm_reply(handle, status, NULL, 0);
+}
+
+/**
+ * @brief CRC SRV == CRC GW, the writer kept the image crc running while
+ *        the pages were queued
+ */
+static boot_status_t boot_fsm_download_finished(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    uint32_t size = handle->iface.image_size;
+
+    if (frame->len < 4)
+        return BOOT_ST_ERR_FORMAT;
+
+    /* blocks still waiting for the flash */
+    while (boot_fsm_download_service(handle, 1))
+        ;
+
+    if (handle->iface.pending != 0)
+        return BOOT_ST_ERR_STATE;
+
+    /*the compressed stream has to end with the image*/
+    if (handle->iface.mode == BOOT_MODE_BINARY_LZ && handle->iface.lz.state != BOOT_LZ_DONE)
+        return (handle->iface.lz.error != BOOT_ST_OK) ? handle->iface.lz.error : BOOT_ST_ERR_FORMAT;
+
+    /*so has the patch*/
+    if (handle->iface.mode == BOOT_MODE_DELTA && handle->iface.delta.state != BOOT_DELTA_DONE)
+        return (handle->iface.delta.error != BOOT_ST_OK) ? handle->iface.delta.error : BOOT_ST_ERR_FORMAT;
+
+    /*and the segment list*/
+    if (handle->iface.mode == BOOT_MODE_SEGMENTS && handle->iface.seg.state != BOOT_SEG_DONE)
+        return (handle->iface.seg.error != BOOT_ST_OK) ? handle->iface.seg.error : BOOT_ST_ERR_FORMAT;
+
+    boot_status_t status = boot_writer_flush(&handle->iface.writer);
+    if (status != BOOT_ST_OK)
+        return status;
+
+    if (size == 0)
+        size = handle->iface.writer.image_end - BOOT_APP_START_ADDR;
+
+    uint32_t crc = boot_writer_image_crc(&handle->iface.writer, size);
+
+    /*the host knows the segment list, not what the gaps between segments hold*/
+    uint32_t expected = crc;
+    if (handle->iface.mode == BOOT_MODE_SEGMENTS)
+        expected = crc32_final(handle->iface.seg.crc);
+
+    if (size == 0 || expected != boot_get_u32(frame->payload))
+    {
+        boot_fsm_dbg("BOOT FAIL, crc 0x%08lx\r\n", (unsigned long)crc);
+
+        /*nothing of it is worth resuming*/
+        boot_meta_save_progress(0, 0, 0);
+        return BOOT_ST_ERR_IMAGE_CRC;
+    }
+
+    /*the header tells in O(1) if the image runs on this bootloader, else it is never started*/
+    const boot_image_header_t *header = boot_image_find(flash_driver_map(BOOT_APP_START_ADDR), BOOT_APP_MAX_SIZE);
+
+    if (header != NULL && !boot_image_compatible(header))
+    {
+        boot_fsm_dbg("BOOT FAIL, needs bootloader 0x%06lx\r\n", (unsigned long)header->min_boot_version);
+        boot_meta_save_progress(0, 0, 0);
+        return BOOT_ST_ERR_VERSION;
+    }
+
+    /*Save CRC and LEN in flash, verified already: the crc was taken from what got programmed*/
+    boot_meta_t meta;
+
+    if (boot_meta_save(size, crc) != FLASH_DRV_OK ||
+        !boot_meta_load(&meta) || boot_meta_set_verified(&meta) != FLASH_DRV_OK)
+        return BOOT_ST_ERR_FLASH;
+
+    boot_fsm_dbg("BOOT SUCCEED, %lu bytes\r\n", (unsigned long)size);
+    return BOOT_ST_OK;
+}
+
+/**
+ * @brief DOWNLOAD_FINISHED reply: pages programmed, pages skipped as
+ *        identical, erases skipped as already blank
+ */
+static void boot_fsm_finished_summary(boot_fsm_t *handle, uint8_t *summary)
+{
+    boot_writer_t *writer = &handle->iface.writer;
+
+    boot_put_u16(&summary[0], (uint16_t)writer->pages_programmed);
+    boot_put_u16(&summary[2], (uint16_t)writer->pages_skipped);
+    boot_put_u16(&summary[4], (uint16_t)writer->erases_skipped);
+
+    boot_fsm_dbg("%lu pages programmed, %lu identical, %lu erases skipped\r\n",
+                  (unsigned long)writer->pages_programmed, (unsigned long)writer->pages_skipped,
+                  (unsigned long)writer->erases_skipped);
+}
+
+/**
+ * @brief GET_MANIFEST: crc32 of whole pages of the app area as they are,
+ *        from the first page asked for, as many as fit a reply
+ */
+static void boot_fsm_manifest(boot_fsm_t *handle)
+{
+    boot_frame_t *frame = &handle->iface.parser.frame;
+    uint8_t extra[BOOT_REPLY_MAX_PAYLOAD - 1];
+
+    if (frame->len < 3)
+    {
+        boot_fsm_reply(handle, BOOT_ST_ERR_FORMAT, NULL, 0);
+        return;
+    }
+
+    uint16_t first = boot_get_u16(frame->payload);
+    uint8_t pages = frame->payload[2];
+
+    if (first > BOOT_APP_PAGES)
+    {
+        boot_fsm_reply(handle, BOOT_ST_ERR_ADDRESS, NULL, 0);
+        return;
+    }
+
+    if (pages > BOOT_MANIFEST_MAX_PAGES)
+        pages = BOOT_MANIFEST_MAX_PAGES;
+    if (pages > BOOT_APP_PAGES - first)
+        pages = (uint8_t)(BOOT_APP_PAGES - first);
+
+    boot_put_u16(&extra[0], first);
+    boot_put_u16(&extra[2], BOOT_APP_PAGES);
+
+    for (uint8_t i = 0; i < pages; i++)
+    {
+        uint32_t address = BOOT_APP_START_ADDR + (uint32_t)(first + i) * FLASH_DRV_PAGE_SIZE;
+        uint32_t crc = crc32_compute(flash_driver_map(address), FLASH_DRV_PAGE_SIZE);
+
+        boot_put_u32(&extra[BOOT_MANIFEST_HEADER_SIZE + 4 * i], crc);
+    }
+
+    boot_fsm_reply(handle, BOOT_ST_OK, extra, (uint8_t)(BOOT_MANIFEST_HEADER_SIZE + 4 * pages));
+}
+
+/*=========================== states ==============================*/
+
+static void enter_seq_idle(boot_fsm_t *handle)
+{
+    boot_fsm_dbg("enter seq \t[ boot mode ]\r\n");
+    boot_fsm_set_next_state(handle, st_boot_idle);
+    time_event_start(&handle->event.time.start_download_timeout, BOOT_START_DOWNLOAD_TIMEOUT);
+}
+
+static void enter_seq_download(boot_fsm_t *handle)
+{
+    boot_fsm_dbg("enter seq \t[ download ]\r\n");
+    boot_fsm_set_next_state(handle, st_boot_download);
+    time_event_start(&handle->event.time.block_timeout, BOOT_BLOCK_TIMEOUT);
+}
+
+static void enter_seq_reset(boot_fsm_t *handle)
+{
+    boot_fsm_dbg("enter seq \t[ soft reset ]\r\n");
+    boot_fsm_set_next_state(handle, st_boot_reset);
+    time_event_stop(&handle->event.time.start_download_timeout);
+    time_event_stop(&handle->event.time.block_timeout);
+    time_event_start(&handle->event.time.reset_delay, BOOT_RESET_DELAY);
+}
+
+static void exit_action_idle(boot_fsm_t *handle)
+{
+    time_event_stop(&handle->event.time.start_download_timeout);
+}
+
+static void exit_action_download(boot_fsm_t *handle)
+{
+    time_event_stop(&handle->event.time.block_timeout);
+    uart_flow_hold(handle->iface.link, 0);
+}
+
+static bool idle_on_react(boot_fsm_t *handle)
+{
+    bool did_transition = true;
+
+    if (handle->event.name == ev_boot_start_download)
+    {
+        /*START_DOWNLOAD_OK advertises the window, the biggest block and where to resume*/
+        boot_status_t status = boot_fsm_start_download(handle);
+        uint8_t extra[BOOT_START_REPLY_SIZE];
+
+        extra[0] = boot_fsm_windowed(handle) ? handle->iface.window.size : 1;
+        boot_put_u16(&extra[1], BOOT_BLOCK_MAX_DATA);
+        boot_put_u32(&extra[3], handle->iface.resumed);
+        boot_fsm_reply(handle, status, extra, sizeof(extra));
+
+        exit_action_idle(handle);
+        if (status == BOOT_ST_OK)
+            enter_seq_download(handle);
+        else
+            enter_seq_idle(handle);
+    }
+    else if (handle->event.name == ev_boot_cancel)
+    {
+        boot_fsm_reply(handle, BOOT_ST_OK, NULL, 0);
+        exit_action_idle(handle);
+        enter_seq_reset(handle);
+    }
+    else if (handle->event.name == ev_boot_enter)
+    {
+        /*ENTER_BOOT_OK, the server may retry*/
+        boot_fsm_enter_ok(handle, handle->iface.parser.frame.seq);
+        enter_seq_idle(handle);
+    }
+    else if (handle->event.name == ev_boot_manifest)
+    {
+        /*page crcs of the app in flash, the server picks the pages to send*/
+        boot_fsm_manifest(handle);
+        enter_seq_idle(handle);
+    }
+    else if (time_event_is_raised(&handle->event.time.start_download_timeout) == true)
+    {
+        exit_action_idle(handle);
+        enter_seq_reset(handle);
+    }
+    else
+        did_transition = false;
+
+    if (handle->event.name != ev_boot_invalid)
+    {
+        /*request not valid in this state*/
+        boot_fsm_reply(handle, BOOT_ST_ERR_STATE, NULL, 0);
+        handle->event.name = ev_boot_invalid;
+    }
+
+    return did_transition;
+}
+
+static bool download_on_react(boot_fsm_t *handle)
+{
+    bool did_transition = true;
+
+    if (handle->event.name == ev_boot_download_line && handle->iface.mode == BOOT_MODE_HEX_LINE)
+    {
+        boot_fsm_download_line_data(handle);
+        enter_seq_download(handle);
+    }
+    else if (handle->event.name == ev_boot_download_block && boot_fsm_windowed(handle))
+    {
+        boot_fsm_download_block(handle);
+        enter_seq_download(handle);
+    }
+    else if (handle->event.name == ev_boot_download_finished)
+    {
+        boot_status_t status = boot_fsm_download_finished(handle);
+        uint8_t summary[BOOT_FINISHED_SUMMARY_SIZE];
+
+        /*the handoff latency counts from here*/
+        handle->iface.handoff = (status == BOOT_ST_OK);
+        handle->iface.finished_us = boot_app_time_us();
+
+        boot_fsm_finished_summary(handle, summary);
+        boot_fsm_reply(handle, status, summary, sizeof(summary));
+
+        exit_action_download(handle);
+        enter_seq_reset(handle);
+    }
+    else if (handle->event.name == ev_boot_start_download)
+    {
+        /*server restarts the download, from where this one got if it is the same image*/
+        boot_fsm_download_interrupted(handle);
+        exit_action_download(handle);
+        enter_seq_idle(handle);
+        handle->event.name = ev_boot_start_download;
+        idle_on_react(handle);
+    }
+    else if (handle->event.name == ev_boot_cancel)
+    {
+        boot_fsm_reply(handle, BOOT_ST_OK, NULL, 0);
+        boot_fsm_download_interrupted(handle);
+        exit_action_download(handle);
+        enter_seq_reset(handle);
+    }
+    else if (time_event_is_raised(&handle->event.time.block_timeout) == true)
+    {
+        boot_fsm_download_interrupted(handle);
+        exit_action_download(handle);
+        enter_seq_reset(handle);
+    }
+    else
+        did_transition = false;
+
+    if (handle->event.name != ev_boot_invalid)
+    {
+        boot_fsm_reply(handle, BOOT_ST_ERR_STATE, NULL, 0);
+        handle->event.name = ev_boot_invalid;
+    }
+
+    //---------------- during action ------------------//
+    if (handle->state == st_boot_download)
+        boot_fsm_download_service(handle, boot_fsm_erase_gate(handle));
+
+    return did_transition;
+}
+
+static bool reset_on_react(boot_fsm_t *handle)
+{
+    /*requests are dropped, the reset is already decided*/
+    handle->event.name = ev_boot_invalid;
+
+    /*main() starts the new app once the reply is out, or clears the handoff and the reset follows*/
+    if (handle->iface.handoff)
+        return false;
+
+    /*the last reply first, the delay lets it leave*/
+    if (handle->iface.reply_len)
+        time_event_start(&handle->event.time.reset_delay, BOOT_RESET_DELAY);
+    else if (time_event_is_raised(&handle->event.time.reset_delay) == true)
+    {
+        time_event_stop(&handle->event.time.reset_delay);
+        NVIC_SystemReset();
+        return true;
+    }
+
+    return false;
+}
+
+void boot_fsm_init(boot_fsm_t *handle, uart_driver_t *link)
+{
+    memset(handle, 0, sizeof(boot_fsm_t));
+    handle->iface.link = link;
+    boot_frame_parser_init(&handle->iface.parser);
+    boot_window_init(&handle->iface.window);
+
+    /*enter BOOT MODE*/
+    enter_seq_idle(handle);
+}
+
+void boot_fsm_resume(boot_fsm_t *handle, uint16_t seq, uint8_t reply, uint32_t start_timeout)
+{
+    if (start_timeout)
+        time_event_start(&handle->event.time.start_download_timeout, start_timeout);
+
+    /*ENTER_BOOT_OK for the frame the app took, the server needs no retry*/
+    if (reply)
+        boot_fsm_enter_ok(handle, seq);
+}
+
+void boot_fsm_run(boot_fsm_t *handle)
+{
+    /*no new request before the last reply is queued*/
+    if (boot_fsm_flush(handle))
+        boot_fsm_poll_link(handle);
+
+    switch (handle->state)
+    {
+    case st_boot_idle: idle_on_react(handle); break;
+    case st_boot_download: download_on_react(handle); break;
+    case st_boot_reset: reset_on_react(handle); break;
+    default:
+        break;
+    }
+}
+
+uint8_t boot_fsm_handoff_due(boot_fsm_t *handle)
+{
+    return handle->state == st_boot_reset && handle->iface.handoff && handle->iface.reply_len == 0 &&
+           uart_tx_idle(handle->iface.link);
+}
+
+void boot_fsm_update_timers(boot_fsm_t *handle)
+{
+    time_event_t *time_event = (time_event_t *)&handle->event.time;
+    for (int tev_idx = 0; tev_idx < sizeof(handle->event.time) / sizeof(time_event_t); tev_idx++)
+    {
+        time_event_update(time_event);
+        time_event++;
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * @file boot_hex.c
+ * @brief Intel HEX record decoder for the legacy DOWNLOAD_LINE mode
+ */
+
+#include <string.h>
+#include "boot_hex.h"
+
+static int8_t boot_hex_nibble(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return (int8_t)(c - '0');
+    if (c >= 'A' && c <= 'F')
+        return (int8_t)(c - 'A' + 10);
+    if (c >= 'a' && c <= 'f')
+        return (int8_t)(c - 'a' + 10);
+    return -1;
+}
+
+static uint8_t boot_hex_byte(const uint8_t *p, uint8_t *byte)
+{
+    int8_t hi = boot_hex_nibble(p[0]);
+    int8_t lo = boot_hex_nibble(p[1]);
+
+    if (hi < 0 || lo < 0)
+        return 0;
+
+    *byte = (uint8_t)((hi << 4) | lo);
+    return 1;
+}
+
+void boot_hex_init(boot_hex_t *hex)
+{
+    memset(hex, 0, sizeof(boot_hex_t));
+}
+
+uint8_t boot_hex_decode(const uint8_t *line, uint16_t len, boot_hex_record_t *record)
+{
+    uint8_t raw[4 + BOOT_HEX_MAX_DATA + 1];
+    uint8_t sum = 0;
+
+    /* strip line ending */
+    while (len && (line[len - 1] == '\r' || line[len - 1] == '\n'))
+        len--;
+
+    if (len < 11 || line[0] != ':' || ((len - 1) & 1U))
+        return 0;
+
+    uint16_t count = (uint16_t)((len - 1) / 2);
+    if (count > sizeof(raw))
+        return 0;
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (!boot_hex_byte(&line[1 + 2 * i], &raw[i]))
+            return 0;
+        sum += raw[i];
+    }
+
+    /* length, offset, type, data and checksum must add up to zero */
+    if (sum != 0 || raw[0] != count - 5)
+        return 0;
+
+    record->len = raw[0];
+    record->offset = (uint16_t)((raw[1] << 8) | raw[2]);
+    record->type = raw[3];
+    memcpy(record->data, &raw[4], record->len);
+
+    return 1;
+}
+
+uint32_t boot_hex_address(boot_hex_t *hex, const boot_hex_record_t *record)
+{
+    switch (record->type)
+    {
+    case BOOT_HEX_EXT_LINEAR_ADDR:
+        if (record->len == 2)
+            hex->base = ((uint32_t)record->data[0] << 24) | ((uint32_t)record->data[1] << 16);
+        break;
+
+    case BOOT_HEX_EXT_SEGMENT_ADDR:
+        if (record->len == 2)
+            hex->base = (((uint32_t)record->data[0] << 8) | record->data[1]) << 4;
+        break;
+
+    default:
+        break;
+    }
+
+    return hex->base + record->offset;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file boot_image.c
+ * @brief Image header at a fixed offset of the user app
+ *
+ * @note  Finding the header reads its few bytes only. The image crc skips
+ *        the two crc fields; with plain the crc32 of the whole image comes
+ *        out of the same pass (crc32_combine()), the one the metadata
+ *        record holds.
+ */
+
+#include <stddef.h>
+#include "boot_image.h"
+#include "boot_config.h"
+#include "crc32.h"
+
+#define BOOT_IMAGE_HEADER_MAX           (256)   /* bigger is not a header of ours */
+
+const boot_image_header_t *boot_image_find(const uint8_t *image, uint32_t size)
+{
+    const boot_image_header_t *header = (const boot_image_header_t *)(const void *)&image[BOOT_IMAGE_HEADER_OFFSET];
+
+    if (size < BOOT_IMAGE_HEADER_OFFSET + sizeof(boot_image_header_t) || header->magic != BOOT_IMAGE_MAGIC)
+        return NULL;
+
+    /*older versions are still read, later ones only append fields*/
+    if (header->header_version == 0 || header->header_size < sizeof(boot_image_header_t) ||
+        header->header_size > BOOT_IMAGE_HEADER_MAX)
+        return NULL;
+
+    if (header->image_size < BOOT_IMAGE_HEADER_OFFSET + header->header_size || header->image_size > size)
+        return NULL;
+
+    return (boot_image_header_crc(header) == header->header_crc) ? header : NULL;
+}
+
+uint32_t boot_image_crc(const uint8_t *image, uint32_t size, uint32_t *plain)
+{
+    uint32_t head_len = BOOT_IMAGE_HEADER_OFFSET + BOOT_IMAGE_CRC_OFFSET;
+    uint32_t tail_len = size - head_len - BOOT_IMAGE_CRC_SIZE;
+    uint32_t head = crc32_compute(image, head_len);
+    uint32_t tail = crc32_compute(&image[head_len + BOOT_IMAGE_CRC_SIZE], tail_len);
+
+    if (plain != NULL)
+    {
+        uint32_t fields = crc32_compute(&image[head_len], BOOT_IMAGE_CRC_SIZE);
+        *plain = crc32_combine(crc32_combine(head, fields, BOOT_IMAGE_CRC_SIZE), tail, tail_len);
+    }
+
+    return crc32_combine(head, tail, tail_len);
+}
+
+uint32_t boot_image_header_crc(const boot_image_header_t *header)
+{
+    const uint8_t *bytes = (const uint8_t *)header;
+
+    return crc32_compute(&bytes[offsetof(boot_image_header_t, image_crc)],
+                         header->header_size - offsetof(boot_image_header_t, image_crc));
+}
+
+uint8_t boot_image_compatible(const boot_image_header_t *header)
+{
+    return header->min_boot_version <= BOOT_VERSION;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file boot_log.c
+ * @brief Append-only record log over two flash pages
+ *
+ * @note  A record is programmed tag first, so a tag still reading 0xFFFF
+ *        is the end of the log even after a power loss. A torn record
+ *        (payload length out of range, crc mismatch) ends the replay and
+ *        marks the log dirty: the next append compacts instead of writing
+ *        past it.
+ */
+
+#include <string.h>
+#include "boot_log.h"
+#include "crc32.h"
+
+#define BOOT_LOG_END_TAG                (0xFFFFU)
+
+static uint16_t boot_log_read16(uint32_t address)
+{
+    const uint8_t *p = flash_driver_map(address);
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t boot_log_read32(uint32_t address)
+{
+    return (uint32_t)boot_log_read16(address) | ((uint32_t)boot_log_read16(address + 2) << 16);
+}
+
+static uint32_t boot_log_record_size(uint8_t len)
+{
+    return 2U + len + (len ? 4U : 0U);
+}
+
+static uint8_t boot_log_page_valid(uint32_t page)
+{
+    return boot_log_read32(page) == BOOT_LOG_PAGE_MAGIC;
+}
+
+void boot_log_open(boot_log_t *log, uint32_t start, boot_log_replay_t replay, boot_log_snapshot_t snapshot, void *ctx)
+{
+    memset(log, 0, sizeof(boot_log_t));
+    log->start = start;
+    log->snapshot = snapshot;
+    log->ctx = ctx;
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        uint32_t page = start + i * FLASH_DRV_PAGE_SIZE;
+        uint32_t sequence = boot_log_read32(page + 4);
+
+        if (boot_log_page_valid(page) && (log->page == 0 || (int32_t)(sequence - log->sequence) > 0))
+        {
+            log->page = page;
+            log->sequence = sequence;
+        }
+    }
+
+    if (log->page == 0)
+        return;
+
+    uint32_t address = log->page + BOOT_LOG_HEADER_SIZE;
+    uint32_t end = log->page + FLASH_DRV_PAGE_SIZE;
+
+    while (address + 2 <= end)
+    {
+        uint16_t tag = boot_log_read16(address);
+        uint8_t len = (uint8_t)(tag & 0xFFU);
+        uint32_t size = boot_log_record_size(len);
+
+        if (tag == BOOT_LOG_END_TAG)
+            break;
+
+        if (len > BOOT_LOG_MAX_PAYLOAD || (len & 1U) || address + size > end ||
+            (len && boot_log_read32(address + 2 + len) != crc32_compute(flash_driver_map(address), 2U + len)))
+        {
+            log->dirty = 1;
+            break;
+        }
+
+        replay(ctx, (uint8_t)(tag >> 8), flash_driver_map(address + 2), len);
+        address += size;
+    }
+
+    log->next = address;
+}
+
+/**
+ * @brief Erase the other page, let the owner write its state there, then
+ *        the header with the next sequence
+ * @note  The snapshot appends to the target, so the log points there while
+ *        it is written. If the snapshot or the header fails, the old page
+ *        stays the active one, as it is after a reset, and the log is left
+ *        dirty: the next append compacts again.
+ */
+static flash_drv_st_t boot_log_compact(boot_log_t *log)
+{
+    uint32_t target = (log->page == log->start) ? log->start + FLASH_DRV_PAGE_SIZE : log->start;
+    uint32_t header[2] = {BOOT_LOG_PAGE_MAGIC, log->sequence + 1};
+    uint32_t page = log->page;
+    uint32_t next = log->next;
+
+    flash_drv_st_t status = flash_driver_erase(target, 1);
+    if (status != FLASH_DRV_OK)
+        return status;
+
+    log->page = target;
+    log->next = target + BOOT_LOG_HEADER_SIZE;
+    log->dirty = 0;
+
+    log->compacting = 1;
+    status = log->snapshot(log->ctx);
+    log->compacting = 0;
+
+    if (status == FLASH_DRV_OK)
+        status = flash_driver_program(target, (const uint8_t *)header, sizeof(header));
+
+    log->compactions++;
+
+    if (status != FLASH_DRV_OK)
+    {
+        log->page = page;
+        log->next = next;
+        log->dirty = 1;
+        return status;
+    }
+
+    log->sequence++;
+
+    return status;
+}
+
+flash_drv_st_t boot_log_append(boot_log_t *log, uint8_t type, const void *payload, uint8_t len)
+{
+    uint8_t record[2 + BOOT_LOG_MAX_PAYLOAD + 4];
+    uint32_t size = boot_log_record_size(len);
+
+    if (len > BOOT_LOG_MAX_PAYLOAD || (len & 1U))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    if (!log->compacting &&
+        (log->page == 0 || log->dirty || log->next + size > log->page + FLASH_DRV_PAGE_SIZE))
+        return boot_log_compact(log);
+
+    if (log->next + size > log->page + FLASH_DRV_PAGE_SIZE)
+        return FLASH_DRV_BAD_ADDRESS;
+
+    record[0] = len;
+    record[1] = type;
+    if (len)
+    {
+        memcpy(&record[2], payload, len);
+
+        uint32_t crc = crc32_compute(record, 2U + len);
+        memcpy(&record[2 + len], &crc, sizeof(crc));
+    }
+
+    flash_drv_st_t status = flash_driver_program(log->next, record, size);
+
+    /* a failed write leaves a torn record, skip it with a compaction */
+    if (status != FLASH_DRV_OK)
+        log->dirty = 1;
+
+    log->next += size;
+
+    return status;
+}
+
+uint8_t boot_log_fits(const boot_log_t *log, uint8_t len)
+{
+    return log->page != 0 && !log->dirty && log->next + boot_log_record_size(len) <= log->page + FLASH_DRV_PAGE_SIZE;
+}
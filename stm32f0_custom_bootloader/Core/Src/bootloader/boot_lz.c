@@ -0,0 +1,165 @@
+/**
+ * @file boot_lz.c
+ * @brief Streaming decoder of LZ compressed images (BOOT_MODE_BINARY_LZ)
+ *
+ * @note  One state per field of a sequence, so a block boundary may fall
+ *        anywhere. Literals and matches are copied in runs bounded by the
+ *        input left, the output room and the image size.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "boot_lz.h"
+
+#define BOOT_LZ_MASK                    (BOOT_LZ_WINDOW - 1)
+
+void boot_lz_init(boot_lz_t *lz, uint8_t *window, uint32_t size)
+{
+    memset(lz, 0, offsetof(boot_lz_t, out));
+    lz->window = window;
+    lz->state = BOOT_LZ_TOKEN;
+    lz->size = size;
+    lz->error = BOOT_ST_OK;
+}
+
+static void boot_lz_emit(boot_lz_t *lz, uint8_t byte)
+{
+    lz->window[lz->out_total & BOOT_LZ_MASK] = byte;
+    lz->out[lz->out_len++] = byte;
+    lz->out_total++;
+}
+
+/** Run length: room in the output buffer and to the image end */
+static uint32_t boot_lz_room(const boot_lz_t *lz, uint32_t want)
+{
+    uint32_t room = BOOT_LZ_OUT_SIZE - lz->out_len;
+
+    if (room > lz->size - lz->out_total)
+        room = lz->size - lz->out_total;
+
+    return (want < room) ? want : room;
+}
+
+static boot_lz_state_t boot_lz_after_copy(const boot_lz_t *lz, boot_lz_state_t next)
+{
+    return (lz->out_total == lz->size) ? BOOT_LZ_DONE : next;
+}
+
+uint32_t boot_lz_decode(boot_lz_t *lz, const uint8_t *in, uint32_t len)
+{
+    uint32_t i = 0;
+    uint8_t starved = 0;
+
+    /* compact what the caller took */
+    if (lz->out_start)
+    {
+        memmove(lz->out, &lz->out[lz->out_start], boot_lz_pending(lz));
+        lz->out_len = boot_lz_pending(lz);
+        lz->out_start = 0;
+    }
+
+    while (!starved && lz->error == BOOT_ST_OK && lz->out_len < BOOT_LZ_OUT_SIZE)
+    {
+        uint32_t run;
+
+        /* every state but a match and the end needs input */
+        if (i == len && lz->state != BOOT_LZ_MATCH && lz->state != BOOT_LZ_DONE)
+        {
+            starved = 1;
+            break;
+        }
+
+        switch (lz->state)
+        {
+        case BOOT_LZ_TOKEN:
+            lz->literals = in[i] >> 4;
+            lz->match = (in[i] & 0x0FU) + BOOT_LZ_MIN_MATCH;
+            lz->extend = (in[i] & 0x0FU) == 0x0FU;
+            i++;
+            if (lz->literals == 15)
+                lz->state = BOOT_LZ_LITERAL_LEN;
+            else
+                lz->state = lz->literals ? BOOT_LZ_LITERALS : BOOT_LZ_OFFSET_LO;
+            break;
+
+        case BOOT_LZ_LITERAL_LEN:
+            lz->literals += in[i];
+            if (in[i++] != 255)
+                lz->state = BOOT_LZ_LITERALS;
+            break;
+
+        case BOOT_LZ_LITERALS:
+            run = boot_lz_room(lz, lz->literals);
+            if (run > len - i)
+                run = len - i;
+            if (run == 0)
+            {
+                lz->error = BOOT_ST_ERR_FORMAT;     /* past the image size */
+                break;
+            }
+
+            lz->literals -= run;
+            while (run--)
+                boot_lz_emit(lz, in[i++]);
+
+            if (lz->literals == 0)
+                lz->state = boot_lz_after_copy(lz, BOOT_LZ_OFFSET_LO);
+            break;
+
+        case BOOT_LZ_OFFSET_LO:
+            lz->offset = in[i++];
+            lz->state = BOOT_LZ_OFFSET_HI;
+            break;
+
+        case BOOT_LZ_OFFSET_HI:
+            lz->offset |= (uint16_t)(in[i++] << 8);
+
+            if (lz->offset == 0 || lz->offset > BOOT_LZ_WINDOW || lz->offset > lz->out_total)
+                lz->error = BOOT_ST_ERR_FORMAT;
+
+            lz->state = lz->extend ? BOOT_LZ_MATCH_LEN : BOOT_LZ_MATCH;
+            break;
+
+        case BOOT_LZ_MATCH_LEN:
+            lz->match += in[i];
+            if (in[i++] != 255)
+                lz->state = BOOT_LZ_MATCH;
+            break;
+
+        case BOOT_LZ_MATCH:
+            run = boot_lz_room(lz, lz->match);
+            if (run == 0)
+            {
+                lz->error = BOOT_ST_ERR_FORMAT;
+                break;
+            }
+
+            /* byte by byte, a match may overlap what it produces */
+            lz->match -= run;
+            while (run--)
+                boot_lz_emit(lz, lz->window[(lz->out_total - lz->offset) & BOOT_LZ_MASK]);
+
+            if (lz->match == 0)
+                lz->state = boot_lz_after_copy(lz, BOOT_LZ_TOKEN);
+            break;
+
+        case BOOT_LZ_DONE:
+        default:
+            if (i != len)
+                lz->error = BOOT_ST_ERR_FORMAT;     /* data past the image */
+            starved = 1;
+            break;
+        }
+    }
+
+    lz->in_total += i;
+    return i;
+}
+
+void boot_lz_consume(boot_lz_t *lz, uint16_t n)
+{
+    lz->out_start += n;
+
+    if (lz->out_start == lz->out_len)
+        lz->out_start = lz->out_len = 0;
+}
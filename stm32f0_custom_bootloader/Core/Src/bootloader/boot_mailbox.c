@@ -0,0 +1,51 @@
+/**
+ * @file boot_mailbox.c
+ * @brief BOOT MODE request from the app, in SRAM kept across a soft reset
+ */
+
+#include <string.h>
+#include "boot_mailbox.h"
+
+typedef struct
+{
+    boot_mailbox_t request;     /* app to bootloader */
+    boot_handoff_t handoff;     /* bootloader to app */
+} boot_noinit_t;
+
+_Static_assert(sizeof(boot_noinit_t) <= 32, "the .noinit region is 32 bytes");
+
+#if defined(__arm__)
+/* placed by the linker scripts at BOOT_MAILBOX_ADDR, not zeroed at startup */
+static boot_noinit_t boot_noinit __attribute__((section(".noinit")));
+#else
+static boot_noinit_t boot_noinit;
+#endif
+
+static uint32_t boot_mailbox_check(const boot_mailbox_t *mailbox)
+{
+    return ~(mailbox->magic ^ mailbox->baudrate ^ ((uint32_t)mailbox->flags << 16 | mailbox->seq) ^
+             mailbox->start_timeout);
+}
+
+uint8_t boot_mailbox_take(boot_mailbox_t *request)
+{
+    boot_mailbox_t *mailbox = &boot_noinit.request;
+    uint8_t valid = mailbox->magic == BOOT_MAILBOX_MAGIC && mailbox->check == boot_mailbox_check(mailbox);
+
+    if (valid)
+        *request = *mailbox;
+    else
+        memset(request, 0, sizeof(boot_mailbox_t));
+
+    /*one shot, a watchdog or a later reset boots normally*/
+    memset(mailbox, 0, sizeof(boot_mailbox_t));
+
+    return valid;
+}
+
+void boot_mailbox_handoff(uint32_t latency_us)
+{
+    boot_noinit.handoff.magic = BOOT_HANDOFF_MAGIC;
+    boot_noinit.handoff.latency_us = latency_us;
+    boot_noinit.handoff.check = ~(BOOT_HANDOFF_MAGIC ^ latency_us);
+}
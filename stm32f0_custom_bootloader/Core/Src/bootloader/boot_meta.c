@@ -0,0 +1,275 @@
+/**
+ * @file boot_meta.c
+ * @brief User app length and CRC, boot flag and download counter, kept as
+ *        records in the metadata log (boot_log.h)
+ */
+
+#include <string.h>
+#include "boot_meta.h"
+#include "boot_config.h"
+
+typedef struct
+{
+    uint32_t image_size;
+    uint32_t image_crc;
+    uint32_t generation;        /* 0 before the first download */
+    uint8_t image;              /* image record not invalidated */
+    uint8_t verified;
+    uint8_t boot_flag;
+    uint32_t progress_size;     /* download under way, 0 if none */
+    uint32_t progress_crc;
+    uint32_t committed;         /* bytes from BOOT_APP_START_ADDR in flash */
+    uint8_t staged;             /* the progress is a delta update's */
+    uint32_t staged_offset;     /* page in the scratch page, BOOT_META_NO_STAGE */
+    uint32_t staged_crc;
+} boot_meta_state_t;
+
+static boot_log_t boot_meta_log_pages;
+static boot_meta_state_t boot_meta_state;
+
+static uint32_t boot_meta_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void boot_meta_replay(void *ctx, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    boot_meta_state_t *state = (boot_meta_state_t *)ctx;
+
+    if (type == BOOT_META_IMAGE && len == 12)
+    {
+        state->image_size = boot_meta_get_u32(&payload[0]);
+        state->image_crc = boot_meta_get_u32(&payload[4]);
+        state->generation = boot_meta_get_u32(&payload[8]);
+        state->image = 1;
+        state->verified = 0;
+        state->committed = 0;
+        state->staged = 0;
+    }
+    else if (type == BOOT_META_PROGRESS && len == 12)
+    {
+        state->progress_size = boot_meta_get_u32(&payload[0]);
+        state->progress_crc = boot_meta_get_u32(&payload[4]);
+        state->committed = boot_meta_get_u32(&payload[8]);
+        state->staged = 0;
+    }
+    else if (type == BOOT_META_STAGED && len == 16)
+    {
+        state->progress_size = boot_meta_get_u32(&payload[0]);
+        state->progress_crc = boot_meta_get_u32(&payload[4]);
+        state->staged_offset = boot_meta_get_u32(&payload[8]);
+        state->staged_crc = boot_meta_get_u32(&payload[12]);
+        state->committed = (state->staged_offset == BOOT_META_NO_STAGE) ? 0 : state->staged_offset;
+        state->staged = 1;
+    }
+    else if (type == BOOT_META_VERIFIED && len == 4)
+    {
+        state->verified = state->image && boot_meta_get_u32(payload) == state->generation;
+    }
+    else if (type == BOOT_META_INVALID)
+    {
+        state->image = 0;
+        state->verified = 0;
+    }
+    else if (type == BOOT_META_FLAG_SET)
+    {
+        state->boot_flag = 1;
+    }
+    else if (type == BOOT_META_FLAG_CLEAR)
+    {
+        state->boot_flag = 0;
+    }
+}
+
+static flash_drv_st_t boot_meta_append_image(void)
+{
+    uint32_t record[3] = {boot_meta_state.image_size, boot_meta_state.image_crc, boot_meta_state.generation};
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_IMAGE, record, sizeof(record));
+}
+
+static flash_drv_st_t boot_meta_append_progress(void)
+{
+    uint32_t record[3] = {boot_meta_state.progress_size, boot_meta_state.progress_crc, boot_meta_state.committed};
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_PROGRESS, record, sizeof(record));
+}
+
+static flash_drv_st_t boot_meta_append_staged(void)
+{
+    uint32_t record[4] = {boot_meta_state.progress_size, boot_meta_state.progress_crc, boot_meta_state.staged_offset,
+                          boot_meta_state.staged_crc};
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_STAGED, record, sizeof(record));
+}
+
+static flash_drv_st_t boot_meta_append_verified(void)
+{
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_VERIFIED, &boot_meta_state.generation, sizeof(uint32_t));
+}
+
+/**
+ * @brief Live state on a fresh page: the image record keeps the generation
+ *        even once invalidated
+ */
+static flash_drv_st_t boot_meta_snapshot(void *ctx)
+{
+    boot_meta_state_t *state = (boot_meta_state_t *)ctx;
+    flash_drv_st_t status = FLASH_DRV_OK;
+
+    if (state->generation != 0)
+    {
+        status = boot_meta_append_image();
+
+        if (status == FLASH_DRV_OK && state->verified)
+            status = boot_meta_append_verified();
+
+        if (status == FLASH_DRV_OK && !state->image)
+            status = boot_log_append(&boot_meta_log_pages, BOOT_META_INVALID, NULL, 0);
+    }
+
+    if (status == FLASH_DRV_OK && state->boot_flag)
+        status = boot_log_append(&boot_meta_log_pages, BOOT_META_FLAG_SET, NULL, 0);
+
+    if (status == FLASH_DRV_OK && state->staged)
+        status = boot_meta_append_staged();
+    else if (status == FLASH_DRV_OK && state->committed)
+        status = boot_meta_append_progress();
+
+    return status;
+}
+
+void boot_meta_init(void)
+{
+    memset(&boot_meta_state, 0, sizeof(boot_meta_state));
+    boot_log_open(&boot_meta_log_pages, BOOT_META_START_ADDR, boot_meta_replay, boot_meta_snapshot, &boot_meta_state);
+}
+
+uint8_t boot_meta_load(boot_meta_t *meta)
+{
+    if (!boot_meta_state.image || boot_meta_state.image_size == 0 || boot_meta_state.image_size > BOOT_APP_MAX_SIZE)
+        return 0;
+
+    meta->image_size = boot_meta_state.image_size;
+    meta->image_crc = boot_meta_state.image_crc;
+    meta->generation = boot_meta_state.generation;
+    meta->verified = boot_meta_state.verified;
+    return 1;
+}
+
+flash_drv_st_t boot_meta_save(uint32_t image_size, uint32_t image_crc)
+{
+    boot_meta_state.image_size = image_size;
+    boot_meta_state.image_crc = image_crc;
+    boot_meta_state.generation++;
+    boot_meta_state.image = 1;
+    boot_meta_state.verified = 0;
+    boot_meta_state.committed = 0;
+    boot_meta_state.staged = 0;
+
+    return boot_meta_append_image();
+}
+
+uint8_t boot_meta_is_verified(const boot_meta_t *meta)
+{
+    return meta->verified;
+}
+
+flash_drv_st_t boot_meta_set_verified(const boot_meta_t *meta)
+{
+    if (!boot_meta_state.image || meta->generation != boot_meta_state.generation)
+        return FLASH_DRV_ERROR;
+
+    boot_meta_state.verified = 1;
+    return boot_meta_append_verified();
+}
+
+flash_drv_st_t boot_meta_invalidate(void)
+{
+    if (!boot_meta_state.image)
+        return FLASH_DRV_OK;
+
+    boot_meta_state.image = 0;
+    boot_meta_state.verified = 0;
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_INVALID, NULL, 0);
+}
+
+uint32_t boot_meta_progress(uint32_t image_size, uint32_t image_crc)
+{
+    if (boot_meta_state.progress_size != image_size || boot_meta_state.progress_crc != image_crc ||
+        boot_meta_state.committed > image_size)
+        return 0;
+
+    return boot_meta_state.committed;
+}
+
+flash_drv_st_t boot_meta_save_progress(uint32_t image_size, uint32_t image_crc, uint32_t committed)
+{
+    /* no progress reads the same whatever image it names */
+    if (committed == boot_meta_state.committed && !boot_meta_state.staged &&
+        (committed == 0 || (image_size == boot_meta_state.progress_size && image_crc == boot_meta_state.progress_crc)))
+        return FLASH_DRV_OK;
+
+    boot_meta_state.progress_size = image_size;
+    boot_meta_state.progress_crc = image_crc;
+    boot_meta_state.committed = committed;
+    boot_meta_state.staged = 0;
+    return boot_meta_append_progress();
+}
+
+uint8_t boot_meta_staged(uint32_t image_size, uint32_t image_crc, uint32_t *offset, uint32_t *page_crc)
+{
+    if (!boot_meta_state.staged || boot_meta_state.progress_size != image_size ||
+        boot_meta_state.progress_crc != image_crc)
+        return 0;
+
+    *offset = boot_meta_state.staged_offset;
+    *page_crc = boot_meta_state.staged_crc;
+    return 1;
+}
+
+flash_drv_st_t boot_meta_save_staged(uint32_t image_size, uint32_t image_crc, uint32_t offset, uint32_t page_crc)
+{
+    boot_meta_state.progress_size = image_size;
+    boot_meta_state.progress_crc = image_crc;
+    boot_meta_state.staged_offset = offset;
+    boot_meta_state.staged_crc = page_crc;
+    boot_meta_state.committed = (offset == BOOT_META_NO_STAGE) ? 0 : offset;
+    boot_meta_state.staged = 1;
+    return boot_meta_append_staged();
+}
+
+uint8_t boot_meta_delta_staged(void)
+{
+    return boot_meta_state.staged;
+}
+
+uint8_t boot_meta_progress_fits(void)
+{
+    return boot_log_fits(&boot_meta_log_pages, 12);
+}
+
+uint8_t boot_meta_boot_flag(void)
+{
+    return boot_meta_state.boot_flag;
+}
+
+flash_drv_st_t boot_meta_set_boot_flag(void)
+{
+    if (boot_meta_state.boot_flag)
+        return FLASH_DRV_OK;
+
+    boot_meta_state.boot_flag = 1;
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_FLAG_SET, NULL, 0);
+}
+
+flash_drv_st_t boot_meta_clear_boot_flag(void)
+{
+    if (!boot_meta_state.boot_flag)
+        return FLASH_DRV_OK;
+
+    boot_meta_state.boot_flag = 0;
+    return boot_log_append(&boot_meta_log_pages, BOOT_META_FLAG_CLEAR, NULL, 0);
+}
+
+const boot_log_t *boot_meta_log(void)
+{
+    return &boot_meta_log_pages;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file boot_protocol.c
+ * @brief Bootloader <-> gateway framing, shared by the target and host tools
+ */
+
+#include <string.h>
+#include "boot_protocol.h"
+#include "crc32.h"
+
+void boot_frame_parser_init(boot_frame_parser_t *parser)
+{
+    memset(parser, 0, sizeof(boot_frame_parser_t));
+    parser->state = BOOT_PARSER_SOF;
+}
+
+/**
+ * @brief Feed one received byte to the frame parser
+ * @note  The crc is taken over header and payload in two calls once the
+ *        last byte is in, long enough for the CRC unit to pay off. On a crc
+ *        mismatch the parser hunts for the next SOF.
+ */
+boot_parse_result_t boot_frame_parse(boot_frame_parser_t *parser, uint8_t byte)
+{
+    switch (parser->state)
+    {
+    case BOOT_PARSER_SOF:
+        if (byte == BOOT_FRAME_SOF)
+        {
+            parser->idx = 0;
+            parser->state = BOOT_PARSER_HEADER;
+        }
+        break;
+
+    case BOOT_PARSER_HEADER:
+        parser->raw[parser->idx++] = byte;
+
+        if (parser->idx == sizeof(parser->raw))
+        {
+            parser->frame.cmd = parser->raw[0];
+            parser->frame.seq = boot_get_u16(&parser->raw[1]);
+            parser->frame.len = boot_get_u16(&parser->raw[3]);
+            parser->idx = 0;
+
+            if (parser->frame.len > BOOT_FRAME_MAX_PAYLOAD)
+                parser->state = BOOT_PARSER_SOF;
+            else
+                parser->state = (parser->frame.len) ? BOOT_PARSER_PAYLOAD : BOOT_PARSER_CRC;
+        }
+        break;
+
+    case BOOT_PARSER_PAYLOAD:
+        parser->frame.payload[parser->idx++] = byte;
+
+        if (parser->idx == parser->frame.len)
+        {
+            parser->idx = 0;
+            parser->state = BOOT_PARSER_CRC;
+        }
+        break;
+
+    case BOOT_PARSER_CRC:
+        parser->crc_rx = (parser->crc_rx >> 8) | ((uint32_t)byte << 24);
+
+        if (++parser->idx == BOOT_FRAME_CRC_SIZE)
+        {
+            uint32_t crc = crc32_update(CRC32_INIT, parser->raw, sizeof(parser->raw));
+            crc = crc32_final(crc32_update(crc, parser->frame.payload, parser->frame.len));
+
+            parser->state = BOOT_PARSER_SOF;
+
+            if (parser->crc_rx == crc)
+            {
+                parser->frames++;
+                return BOOT_PARSE_FRAME;
+            }
+
+            parser->crc_errors++;
+            return BOOT_PARSE_ERROR;
+        }
+        break;
+
+    default:
+        parser->state = BOOT_PARSER_SOF;
+        break;
+    }
+
+    return BOOT_PARSE_BUSY;
+}
+
+/**
+ * @brief Drop a frame in progress once the link is idle
+ * @note  A byte lost on the wire leaves the parser waiting for bytes that
+ *        never come: without this it takes the next frames as the rest of
+ *        the broken one until its length runs out.
+ */
+uint8_t boot_frame_parser_idle(boot_frame_parser_t *parser)
+{
+    if (parser->state == BOOT_PARSER_SOF)
+        return 0;
+
+    parser->state = BOOT_PARSER_SOF;
+    parser->truncated++;
+    return 1;
+}
+
+/**
+ * @brief Build a frame
+ *
+ * @param out     destination, at least len + BOOT_FRAME_OVERHEAD bytes
+ * @return uint16_t frame size in bytes
+ */
+uint16_t boot_frame_encode(uint8_t *out, uint8_t cmd, uint16_t seq, const uint8_t *payload, uint16_t len)
+{
+    out[0] = BOOT_FRAME_SOF;
+    out[1] = cmd;
+    boot_put_u16(&out[2], seq);
+    boot_put_u16(&out[4], len);
+
+    if (len && payload != &out[BOOT_FRAME_HEADER_SIZE])
+        memmove(&out[BOOT_FRAME_HEADER_SIZE], payload, len);
+
+    uint32_t crc = crc32_compute(&out[1], (size_t)BOOT_FRAME_HEADER_SIZE - 1 + len);
+    boot_put_u32(&out[BOOT_FRAME_HEADER_SIZE + len], crc);
+
+    return (uint16_t)(BOOT_FRAME_OVERHEAD + len);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file boot_seg.c
+ * @brief Streaming parser of segment list images (BOOT_MODE_SEGMENTS)
+ *
+ * @note  The header fields are 32 bit words read one byte per call of the
+ *        loop, so a block boundary may fall anywhere. A segment is checked
+ *        as soon as its len is in.
+ */
+
+#include <string.h>
+#include "boot_seg.h"
+#include "crc32.h"
+
+void boot_seg_init(boot_seg_t *seg, uint32_t start, uint32_t end)
+{
+    memset(seg, 0, sizeof(boot_seg_t));
+    seg->state = BOOT_SEG_MAGIC_FIELD;
+    seg->next = start;
+    seg->end = end;
+    seg->crc = CRC32_INIT;
+    seg->error = BOOT_ST_OK;
+}
+
+/** Segment header complete: in order, not empty, inside the span */
+static boot_seg_state_t boot_seg_check(boot_seg_t *seg)
+{
+    if (seg->len == 0 || seg->address < seg->next)
+        seg->error = BOOT_ST_ERR_FORMAT;
+    else if (seg->address > seg->end || seg->len > seg->end - seg->address)
+        seg->error = BOOT_ST_ERR_ADDRESS;
+    else
+        seg->next = seg->address + seg->len;
+
+    return BOOT_SEG_DATA;
+}
+
+uint32_t boot_seg_decode(boot_seg_t *seg, const uint8_t *in, uint32_t len)
+{
+    uint32_t i = 0;
+
+    while (i < len && seg->error == BOOT_ST_OK && seg->state != BOOT_SEG_DATA)
+    {
+        if (seg->state == BOOT_SEG_DONE)
+        {
+            seg->error = BOOT_ST_ERR_FORMAT;    /* data past the last segment */
+            break;
+        }
+
+        seg->value |= (uint32_t)in[i++] << (8 * seg->field++);
+        if (seg->field < 4)
+            continue;
+
+        uint32_t value = seg->value;
+        seg->value = 0;
+        seg->field = 0;
+
+        switch (seg->state)
+        {
+        case BOOT_SEG_MAGIC_FIELD:
+            if (value != BOOT_SEG_MAGIC)
+                seg->error = BOOT_ST_ERR_FORMAT;
+            seg->state = BOOT_SEG_COUNT;
+            break;
+
+        case BOOT_SEG_COUNT:
+            if (value == 0)
+                seg->error = BOOT_ST_ERR_FORMAT;
+            seg->count = value;
+            seg->state = BOOT_SEG_ADDRESS;
+            break;
+
+        case BOOT_SEG_ADDRESS:
+            seg->address = value;
+            seg->state = BOOT_SEG_LEN;
+            break;
+
+        case BOOT_SEG_LEN:
+        default:
+            seg->len = value;
+            seg->state = boot_seg_check(seg);
+            break;
+        }
+    }
+
+    seg->crc = crc32_update(seg->crc, in, i);
+    seg->in_total += i;
+    return i;
+}
+
+void boot_seg_consume(boot_seg_t *seg, const uint8_t *data, uint32_t n)
+{
+    seg->crc = crc32_update(seg->crc, data, n);
+    seg->in_total += n;
+    seg->address += n;
+    seg->len -= n;
+
+    if (seg->len == 0 && --seg->count == 0)
+        seg->state = BOOT_SEG_DONE;
+    else if (seg->len == 0)
+        seg->state = BOOT_SEG_ADDRESS;
+}
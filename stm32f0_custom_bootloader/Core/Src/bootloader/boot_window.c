@@ -0,0 +1,155 @@
+/**
+ * @file boot_window.c
+ * @brief Receive window of the binary download: blocks may arrive out of
+ *        order and are handed to the writer in sequence.
+ *
+ * @note  Slot of a block = seq % size. A block is accepted while its seq is
+ *        less than size ahead of the oldest unwritten one, so the window the
+ *        host sees shrinks while the flash is behind the wire.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "boot_window.h"
+
+/**
+ * @brief Window size follows the heap left between .bss and the stack
+ */
+uint8_t boot_window_init(boot_window_t *window)
+{
+    memset(window, 0, sizeof(boot_window_t));
+
+    for (uint8_t n = BOOT_WINDOW_MAX; n > 0; n--)
+    {
+        boot_slot_t *slots = malloc(n * sizeof(boot_slot_t));
+        if (slots == NULL)
+            continue;
+
+        void *reserve = malloc(BOOT_WINDOW_RAM_RESERVE);
+        if (reserve != NULL)
+        {
+            free(reserve);
+            window->slots = slots;
+            window->size = n;
+            window->allocated = n;
+            break;
+        }
+
+        free(slots);
+    }
+
+    return window->size;
+}
+
+void boot_window_reset(boot_window_t *window, uint16_t first_seq)
+{
+    window->size = window->allocated;
+    window->next = first_seq;
+    window->write = first_seq;
+    window->limit = (uint16_t)(first_seq + window->size);
+    window->hold = 0;
+
+    for (uint8_t i = 0; i < window->size; i++)
+        window->slots[i].used = 0;
+}
+
+uint8_t *boot_window_lend(boot_window_t *window)
+{
+    if (window->size < 2)
+        return NULL;
+
+    /* the slots left keep seq % size, none is in use yet */
+    window->size--;
+    window->limit = (uint16_t)(window->next + window->size);
+
+    return window->slots[window->size].data;
+}
+
+static boot_slot_t *boot_window_slot(boot_window_t *window, uint16_t seq)
+{
+    return &window->slots[seq % window->size];
+}
+
+boot_window_put_t boot_window_put(boot_window_t *window, uint16_t seq, uint32_t address, const uint8_t *data, uint16_t len)
+{
+    uint16_t ahead = (uint16_t)(seq - window->write);
+
+    if ((uint16_t)(window->write - seq) <= 0x8000U && seq != window->write)
+        return BOOT_WINDOW_DUPLICATE;   /* already written */
+
+    if (window->size == 0 || ahead >= window->size)
+        return BOOT_WINDOW_OUTSIDE;
+
+    boot_slot_t *slot = boot_window_slot(window, seq);
+    if (slot->used)
+        return BOOT_WINDOW_DUPLICATE;
+
+    slot->used = 1;
+    slot->seq = seq;
+    slot->address = address;
+    slot->len = len;
+    slot->done = 0;
+    memcpy(slot->data, data, len);
+
+    /* advance the cumulative ack over blocks received in order */
+    while ((uint16_t)(window->next - window->write) < window->size && boot_window_slot(window, window->next)->used &&
+           boot_window_slot(window, window->next)->seq == window->next)
+        window->next++;
+
+    return BOOT_WINDOW_STORED;
+}
+
+boot_slot_t *boot_window_peek(boot_window_t *window)
+{
+    if (window->write == window->next)
+        return NULL;
+
+    return boot_window_slot(window, window->write);
+}
+
+void boot_window_release(boot_window_t *window)
+{
+    boot_window_slot(window, window->write)->used = 0;
+    window->write++;
+}
+
+void boot_window_ack(boot_window_t *window, uint8_t *ack)
+{
+    uint16_t sack = 0;
+    uint16_t limit = (uint16_t)(window->write + window->size);
+
+    /* held: keep the last limit, never advertise one below next */
+    if (window->hold && (uint16_t)(window->limit - window->next) <= window->size)
+        limit = window->limit;
+
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        uint16_t seq = (uint16_t)(window->next + 1 + i);
+        if ((uint16_t)(limit - seq) == 0 || (uint16_t)(limit - seq) > window->size)
+            break;
+
+        boot_slot_t *slot = boot_window_slot(window, seq);
+        if (slot->used && slot->seq == seq)
+            sack |= (uint16_t)(1U << i);
+    }
+
+    boot_put_u16(&ack[0], window->next);
+    boot_put_u16(&ack[2], sack);
+    ack[4] = (uint8_t)(limit - window->next);
+    window->limit = limit;
+}
+
+void boot_window_hold(boot_window_t *window, uint8_t hold)
+{
+    window->hold = hold;
+}
+
+uint8_t boot_window_full(boot_window_t *window)
+{
+    return window->next == window->limit;
+}
+
+uint8_t boot_window_empty(boot_window_t *window)
+{
+    return window->write == window->next;
+}
@@ -0,0 +1,622 @@
+/**
+ * @file boot_writer.c
+ * @brief Collects downloaded data into page buffers and erases / programs
+ *        the user app area in the background, one step per call.
+ *
+ * @note  Pages are erased on demand, only the half-words holding data are
+ *        programmed. Data may come in any order inside a page, a page is
+ *        queued once the stream moves to another page or on flush.
+ *        The first page is checked for an image header that needs a newer
+ *        bootloader before it leaves the buffer, nothing of the app in
+ *        flash is touched for an image that cannot run.
+ *        Programming a whole page takes ~55 ms; done in slices the main loop
+ *        keeps draining the link in between. An erase (~30 ms) is one step,
+ *        the caller decides when the link can afford it (may_erase).
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "boot_writer.h"
+#include "boot_image.h"
+#include "crc32.h"
+
+/**@brief Enable/Disable debug messages */
+#define BOOT_WRITER_DEBUG 0
+#define BOOT_WRITER_TAG "boot writer : "
+
+#if BOOT_WRITER_DEBUG
+#include <stdio.h>
+#define boot_writer_dbg(format, ...) printf(BOOT_WRITER_TAG format, ##__VA_ARGS__)
+#else
+#define boot_writer_dbg(format, ...) \
+    do                               \
+    { /* Do nothing */               \
+    } while (0)
+#endif
+
+void boot_writer_init(boot_writer_t *writer, uint32_t start, uint32_t end)
+{
+    memset(writer, 0, offsetof(boot_writer_t, pages));
+    writer->start = start;
+    writer->end = end;
+    writer->erase_end = end;
+    writer->image_end = start;
+    writer->error = BOOT_ST_OK;
+    writer->flash = BOOT_FLASH_IDLE;
+
+    for (uint8_t i = 0; i < BOOT_WRITER_PAGES; i++)
+        writer->pages[i].state = BOOT_PAGE_FREE;
+}
+
+void boot_writer_set_scratch(boot_writer_t *writer, uint32_t scratch, boot_writer_stage_t stage, void *ctx)
+{
+    writer->scratch = scratch;
+    writer->scratch_erased = 0;
+    writer->stage = stage;
+    writer->ctx = ctx;
+    writer->erase_ahead = 0;    /* pages ahead still hold what the copies read */
+}
+
+/** Owner's touch callback before the first erase or program, returns 0 on error */
+static uint8_t boot_writer_touch(boot_writer_t *writer)
+{
+    boot_writer_touch_t touch = writer->touch;
+
+    if (touch == NULL)
+        return 1;
+
+    writer->touch = NULL;
+    if (touch() != FLASH_DRV_OK)
+    {
+        writer->error = BOOT_ST_ERR_FLASH;
+        return 0;
+    }
+
+    return 1;
+}
+
+static uint8_t boot_writer_is_erased(boot_writer_t *writer, uint32_t page_addr)
+{
+    uint32_t index = (page_addr - writer->start) / FLASH_DRV_PAGE_SIZE;
+    return (writer->erased[index / 8] >> (index % 8)) & 1U;
+}
+
+static void boot_writer_set_erased(boot_writer_t *writer, uint32_t page_addr)
+{
+    uint32_t index = (page_addr - writer->start) / FLASH_DRV_PAGE_SIZE;
+
+    if (writer->scratch && page_addr == writer->scratch)
+    {
+        writer->scratch_erased = 1;
+        return;
+    }
+
+    writer->erased[index / 8] |= (uint8_t)(1U << (index % 8));
+}
+
+static uint8_t boot_writer_flash_blank(uint32_t page_addr)
+{
+    const uint32_t *word = (const uint32_t *)(const void *)flash_driver_map(page_addr);
+
+    for (uint32_t i = 0; i < FLASH_DRV_PAGE_SIZE / 4; i++)
+    {
+        if (word[i] != 0xFFFFFFFFUL)
+            return 0;
+    }
+
+    return 1;
+}
+
+static uint32_t boot_writer_index(const boot_writer_t *writer, uint32_t page_addr)
+{
+    return (page_addr - writer->start) / FLASH_DRV_PAGE_SIZE;
+}
+
+static uint8_t boot_writer_is_verified(const boot_writer_t *writer, uint32_t page_addr)
+{
+    uint32_t index = boot_writer_index(writer, page_addr);
+    return (writer->verified[index / 8] >> (index % 8)) & 1U;
+}
+
+static void boot_writer_set_verified(boot_writer_t *writer, uint32_t page_addr, uint8_t verified)
+{
+    uint32_t index = boot_writer_index(writer, page_addr);
+
+    if (verified)
+        writer->verified[index / 8] |= (uint8_t)(1U << (index % 8));
+    else
+        writer->verified[index / 8] &= (uint8_t)~(1U << (index % 8));
+}
+
+/** Bytes of a page the image covers, 0 past erase_end */
+static uint32_t boot_writer_crc_len(const boot_writer_t *writer, uint32_t page_addr)
+{
+    if (page_addr >= writer->erase_end)
+        return 0;
+
+    return (writer->erase_end - page_addr > FLASH_DRV_PAGE_SIZE) ? FLASH_DRV_PAGE_SIZE : writer->erase_end - page_addr;
+}
+
+/**
+ * @brief Crc of a page leaving the buffers, it holds what ends up in flash:
+ *        data, 0xFF where nothing was written. A page filled a second time
+ *        (hex records out of order) only adds to what is programmed, its
+ *        crc is left to the final check.
+ */
+static void boot_writer_crc_page(boot_writer_t *writer, boot_page_t *page)
+{
+    uint32_t len = boot_writer_crc_len(writer, page->address);
+
+    page->crc_valid = len != 0 && !boot_writer_is_verified(writer, page->address);
+
+    for (uint8_t i = 0; i < BOOT_WRITER_PAGES; i++)
+    {
+        boot_page_t *other = &writer->pages[i];
+
+        if (other != page && other->state == BOOT_PAGE_PROGRAMMING && other->address == page->address)
+        {
+            other->crc_valid = 0;
+            page->crc_valid = 0;
+        }
+    }
+
+    boot_writer_set_verified(writer, page->address, 0);
+
+    if (page->crc_valid)
+        writer->page_crc[boot_writer_index(writer, page->address)] = crc32_compute(page->data, len);
+}
+
+static void boot_writer_queue_filling(boot_writer_t *writer)
+{
+    boot_page_t *page = writer->filling;
+
+    if (page == NULL)
+        return;
+
+    /* the header lies within the first page, only its bytes are read */
+    if (page->address == writer->start)
+    {
+        const boot_image_header_t *header = boot_image_find(page->data, writer->end - writer->start);
+
+        if (header != NULL && !boot_image_compatible(header))
+        {
+            boot_writer_dbg("image needs bootloader 0x%06lx\r\n", (unsigned long)header->min_boot_version);
+            writer->error = BOOT_ST_ERR_VERSION;
+            page->state = BOOT_PAGE_FREE;
+            writer->filling = NULL;
+            return;
+        }
+    }
+
+    boot_writer_crc_page(writer, page);
+
+    /* same contents already in flash, nothing to erase nor program */
+    if (!boot_writer_is_erased(writer, page->address) &&
+        memcmp(flash_driver_map(page->address), page->data, FLASH_DRV_PAGE_SIZE) == 0)
+    {
+        boot_writer_set_erased(writer, page->address);
+        boot_writer_set_verified(writer, page->address, page->crc_valid);
+        writer->pages_skipped++;
+        page->state = BOOT_PAGE_FREE;
+        writer->filling = NULL;
+        return;
+    }
+
+    writer->diverged = 1;
+
+    page->state = BOOT_PAGE_PROGRAMMING;
+    page->offset = 0;
+    writer->queue[writer->queued++] = (uint8_t)(page - writer->pages);
+    writer->filling = NULL;
+}
+
+static boot_page_t *boot_writer_get_free(boot_writer_t *writer)
+{
+    for (uint8_t i = 0; i < BOOT_WRITER_PAGES; i++)
+    {
+        if (writer->pages[i].state == BOOT_PAGE_FREE)
+            return &writer->pages[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Pages holding data come first, oldest queued one before the page
+ *        being filled, then up to BOOT_WRITER_ERASE_AHEAD pages past it.
+ *        The erase is due if data waits for it or if fewer than
+ *        BOOT_WRITER_ERASE_LOW erased pages are left ahead. Nothing is
+ *        erased before its data without erase_ahead, or while every page
+ *        so far matched the flash.
+ */
+uint32_t boot_writer_erase_next(boot_writer_t *writer, uint8_t *due)
+{
+    uint32_t base;
+
+    *due = 1;
+
+    /* in place: the oldest page is erased once it is in the scratch page */
+    if (writer->scratch && writer->queued)
+    {
+        boot_page_t *page = &writer->pages[writer->queue[0]];
+
+        if (!page->in_scratch)
+            return writer->scratch_erased ? BOOT_WRITER_NO_PAGE : writer->scratch;
+
+        return boot_writer_is_erased(writer, page->address) ? BOOT_WRITER_NO_PAGE : page->address;
+    }
+
+    for (uint8_t i = 0; i < writer->queued; i++)
+    {
+        uint32_t address = writer->pages[writer->queue[i]].address;
+        if (!boot_writer_is_erased(writer, address))
+            return address;
+    }
+
+    /* image identical so far, the next page may be too */
+    if (!writer->erase_ahead || !writer->diverged)
+    {
+        *due = 0;
+        return BOOT_WRITER_NO_PAGE;
+    }
+
+    if (writer->filling != NULL)
+    {
+        if (!boot_writer_is_erased(writer, writer->filling->address))
+            return writer->filling->address;
+
+        base = writer->filling->address;
+    }
+    else
+    {
+        base = writer->image_end - ((writer->image_end - writer->start) % FLASH_DRV_PAGE_SIZE);
+    }
+
+    for (uint32_t i = 0; i <= BOOT_WRITER_ERASE_AHEAD; i++)
+    {
+        uint32_t address = base + i * FLASH_DRV_PAGE_SIZE;
+
+        if (address >= writer->erase_end || address >= writer->end)
+            break;
+
+        if (!boot_writer_is_erased(writer, address))
+        {
+            *due = (i <= BOOT_WRITER_ERASE_LOW);
+            return address;
+        }
+    }
+
+    *due = 0;
+
+    return BOOT_WRITER_NO_PAGE;
+}
+
+static boot_status_t boot_writer_erase_step(boot_writer_t *writer, uint32_t address)
+{
+    if (boot_writer_flash_blank(address))
+    {
+        boot_writer_set_erased(writer, address);
+        writer->erases_skipped++;
+        return BOOT_ST_OK;
+    }
+
+    if (!boot_writer_touch(writer))
+        return writer->error;
+
+    if (flash_driver_erase_start(address) != FLASH_DRV_OK)
+    {
+        boot_writer_dbg("erase failed at 0x%08lx\r\n", (unsigned long)address);
+        writer->error = BOOT_ST_ERR_FLASH;
+        return writer->error;
+    }
+
+    writer->flash = BOOT_FLASH_ERASING;
+    writer->erasing = address;
+    return BOOT_ST_OK;
+}
+
+/**
+ * @brief Program the next runs of non blank half-words of a page to base,
+ *        at most a slice
+ * @return uint8_t 1 once the whole page is programmed
+ */
+static uint8_t boot_writer_program_slice(boot_writer_t *writer, boot_page_t *page, uint32_t base)
+{
+    uint32_t budget = BOOT_WRITER_SLICE;
+
+    while (budget && page->offset < FLASH_DRV_PAGE_SIZE)
+    {
+        /* skip blank half-words, erased flash already reads 0xFFFF */
+        while (page->offset < FLASH_DRV_PAGE_SIZE &&
+               page->data[page->offset] == 0xFF && page->data[page->offset + 1] == 0xFF)
+            page->offset += 2;
+
+        uint32_t run = page->offset;
+        while (run < FLASH_DRV_PAGE_SIZE && budget &&
+               !(page->data[run] == 0xFF && page->data[run + 1] == 0xFF))
+        {
+            run += 2;
+            budget--;
+        }
+
+        if (run > page->offset)
+        {
+            uint32_t address = base + page->offset;
+
+            if (!boot_writer_touch(writer))
+                return 0;
+
+            /* read back, the running crc was taken over the buffer */
+            if (flash_driver_program(address, &page->data[page->offset], run - page->offset) != FLASH_DRV_OK ||
+                memcmp(flash_driver_map(address), &page->data[page->offset], run - page->offset) != 0)
+            {
+                boot_writer_dbg("program failed at 0x%08lx\r\n", (unsigned long)address);
+                writer->error = BOOT_ST_ERR_FLASH;
+                return 0;
+            }
+            page->offset = (uint16_t)run;
+        }
+    }
+
+    return page->offset >= FLASH_DRV_PAGE_SIZE;
+}
+
+/**
+ * @brief One pipeline step: finish an erase, start the next one if allowed,
+ *        or program the next run of non blank half-words of the oldest
+ *        queued page, at most a slice.
+ */
+boot_status_t boot_writer_service(boot_writer_t *writer, uint8_t may_erase)
+{
+    uint8_t due;
+
+    if (writer->error != BOOT_ST_OK)
+        return writer->error;
+
+    if (writer->flash == BOOT_FLASH_ERASING)
+    {
+        flash_drv_st_t status = flash_driver_poll();
+
+        if (status == FLASH_DRV_BUSY)
+            return BOOT_ST_OK;
+
+        writer->flash = BOOT_FLASH_IDLE;
+        if (status != FLASH_DRV_OK)
+        {
+            writer->error = BOOT_ST_ERR_FLASH;
+            return writer->error;
+        }
+
+        boot_writer_set_erased(writer, writer->erasing);
+        writer->pages_erased++;
+        return BOOT_ST_OK;
+    }
+
+    /* erases first, the time they may run is the scarce one */
+    if (may_erase)
+    {
+        uint32_t address = boot_writer_erase_next(writer, &due);
+
+        if (address != BOOT_WRITER_NO_PAGE)
+            return boot_writer_erase_step(writer, address);
+    }
+
+    if (writer->queued == 0)
+        return BOOT_ST_OK;
+
+    boot_page_t *page = &writer->pages[writer->queue[0]];
+
+    /* in place: scratch copy, journaled, before the erase */
+    if (writer->scratch && !page->in_scratch)
+    {
+        if (!writer->scratch_erased || !boot_writer_program_slice(writer, page, writer->scratch))
+            return writer->error;
+
+        writer->scratch_erased = 0;
+        page->in_scratch = 1;
+        page->offset = 0;
+
+        if (writer->stage(writer->ctx, page->address) != FLASH_DRV_OK)
+            writer->error = BOOT_ST_ERR_FLASH;
+
+        return writer->error;
+    }
+
+    if (!boot_writer_is_erased(writer, page->address))
+        return BOOT_ST_OK;
+
+    if (boot_writer_program_slice(writer, page, page->address))
+    {
+        /* every half-word read back, the page crc holds for the flash */
+        boot_writer_set_verified(writer, page->address, page->crc_valid);
+        page->state = BOOT_PAGE_FREE;
+        writer->pages_programmed++;
+        writer->queued--;
+        for (uint8_t i = 0; i < writer->queued; i++)
+            writer->queue[i] = writer->queue[i + 1];
+    }
+
+    return writer->error;
+}
+
+boot_status_t boot_writer_write(boot_writer_t *writer, uint32_t address, const uint8_t *data, uint32_t len, uint32_t *taken)
+{
+    *taken = 0;
+
+    if (writer->error != BOOT_ST_OK)
+        return writer->error;
+
+    if (address < writer->start || address > writer->end || len > writer->end - address)
+        return BOOT_ST_ERR_ADDRESS;
+
+    while (len)
+    {
+        uint32_t page_addr = address & ~(FLASH_DRV_PAGE_SIZE - 1);
+        uint32_t offset = address - page_addr;
+        uint32_t chunk = FLASH_DRV_PAGE_SIZE - offset;
+
+        chunk = (chunk > len) ? len : chunk;
+
+        if (writer->filling == NULL || writer->filling->address != page_addr)
+        {
+            boot_page_t *page = boot_writer_get_free(writer);
+
+            /* no buffer left, the caller comes back once a page is programmed */
+            if (page == NULL && writer->filling != NULL)
+            {
+                boot_writer_queue_filling(writer);
+                return BOOT_ST_OK;
+            }
+            if (page == NULL)
+                return BOOT_ST_OK;
+
+            boot_writer_queue_filling(writer);
+
+            memset(page->data, 0xFF, FLASH_DRV_PAGE_SIZE);
+            page->address = page_addr;
+            page->in_scratch = 0;
+            page->state = BOOT_PAGE_FILLING;
+            writer->filling = page;
+        }
+
+        memcpy(&writer->filling->data[offset], data, chunk);
+
+        address += chunk;
+        data += chunk;
+        len -= chunk;
+        *taken += chunk;
+        writer->bytes += chunk;
+
+        if (address > writer->image_end)
+            writer->image_end = address;
+    }
+
+    return BOOT_ST_OK;
+}
+
+uint32_t boot_writer_image_crc(boot_writer_t *writer, uint32_t size)
+{
+    uint32_t crc = 0;   /* crc of nothing */
+    uint32_t to = writer->start + size;
+
+    for (uint32_t address = writer->start; address < to; address += FLASH_DRV_PAGE_SIZE)
+    {
+        uint32_t len = (to - address > FLASH_DRV_PAGE_SIZE) ? FLASH_DRV_PAGE_SIZE : to - address;
+        uint32_t page_crc;
+
+        /* size not announced, the page crc may cover more than the image */
+        if (boot_writer_is_verified(writer, address) && len == boot_writer_crc_len(writer, address))
+        {
+            page_crc = writer->page_crc[boot_writer_index(writer, address)];
+        }
+        else
+        {
+            boot_writer_dbg("crc from flash at 0x%08lx\r\n", (unsigned long)address);
+            page_crc = crc32_compute(flash_driver_map(address), len);
+        }
+
+        crc = crc32_combine(crc, page_crc, len);
+    }
+
+    return crc;
+}
+
+void boot_writer_resume(boot_writer_t *writer, uint32_t size)
+{
+    for (uint32_t address = writer->start; address < writer->start + size; address += FLASH_DRV_PAGE_SIZE)
+    {
+        uint32_t len = boot_writer_crc_len(writer, address);
+
+        boot_writer_set_erased(writer, address);
+        writer->page_crc[boot_writer_index(writer, address)] = crc32_compute(flash_driver_map(address), len);
+        boot_writer_set_verified(writer, address, len != 0);
+    }
+
+    writer->image_end = writer->start + size;
+}
+
+uint32_t boot_writer_committed(const boot_writer_t *writer)
+{
+    uint32_t committed = writer->image_end - writer->start;
+
+    /* last page queued and programmed, whole or not */
+    committed = writer->start + ((committed + FLASH_DRV_PAGE_SIZE - 1) & ~(FLASH_DRV_PAGE_SIZE - 1));
+
+    if (writer->filling != NULL && writer->filling->address < committed)
+        committed = writer->filling->address;
+
+    for (uint8_t i = 0; i < writer->queued; i++)
+    {
+        uint32_t address = writer->pages[writer->queue[i]].address;
+        if (address < committed)
+            committed = address;
+    }
+
+    return committed;
+}
+
+boot_status_t boot_writer_write_all(boot_writer_t *writer, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    uint32_t taken;
+    boot_status_t status;
+
+    while ((status = boot_writer_write(writer, address, data, len, &taken)) == BOOT_ST_OK && taken < len)
+    {
+        address += taken;
+        data += taken;
+        len -= taken;
+
+        if ((status = boot_writer_service(writer, 1)) != BOOT_ST_OK)
+            break;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Program what is buffered, then erase the pages of the image that
+ *        received no data, so the image CRC does not cover old contents.
+ *        Pages past the image are left alone, the boot metadata gives the
+ *        length the app is checked over. With keep_holes the pages without
+ *        data are the ones the host found unchanged, the image CRC covers
+ *        them as they are.
+ */
+boot_status_t boot_writer_flush(boot_writer_t *writer)
+{
+    uint32_t last = writer->image_end;
+
+    /* erase_end stays at end when the image size was not announced */
+    if (writer->erase_end != writer->end && writer->erase_end > last)
+        last = writer->erase_end;
+
+    boot_writer_queue_filling(writer);
+
+    while ((writer->queued || writer->flash != BOOT_FLASH_IDLE) && writer->error == BOOT_ST_OK)
+        boot_writer_service(writer, 1);
+
+    if (writer->keep_holes)
+        return writer->error;
+
+    for (uint32_t address = writer->start; address < last && writer->error == BOOT_ST_OK;
+         address += FLASH_DRV_PAGE_SIZE)
+    {
+        if (boot_writer_is_erased(writer, address))
+            continue;
+
+        if (boot_writer_flash_blank(address))
+        {
+            writer->erases_skipped++;
+        }
+        else if (boot_writer_touch(writer))
+        {
+            if (flash_driver_erase(address, 1) != FLASH_DRV_OK)
+                writer->error = BOOT_ST_ERR_FLASH;
+
+            writer->pages_erased++;
+        }
+
+        boot_writer_set_erased(writer, address);
+    }
+
+    return writer->error;
+}
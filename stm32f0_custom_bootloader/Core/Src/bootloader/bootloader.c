@@ -0,0 +1,84 @@
+/**
+ * @file bootloader.c
+ * @brief Bootloader application, runs the download FSM on the gateway link
+ */
+
+#include "bootloader.h"
+#include "crc32.h"
+#if defined(__arm__)
+#include "irq_priority.h"
+#include "irq_latency.h"
+#endif
+
+/* uart2: link to the gateway */
+extern uart_driver_t uart2;
+#if defined(__arm__) && IRQ_LATENCY_TRACE
+extern irq_latency_t link_rx_latency;
+#endif
+
+boot_fsm_t boot_fsm;
+boot_app_t boot_app;
+boot_mailbox_t boot_request;
+
+uint8_t bootloader_app_ready(void)
+{
+    /*RAM mailbox first, the app asked for BOOT MODE without a flash write*/
+    uint8_t requested = boot_mailbox_take(&boot_request);
+
+#if CRC32_ENGINE == CRC32_ENGINE_HW
+    /*log records and the image are checked before peripherals_init(), boot_app_jump() turns the clocks off again*/
+    crc32_hw_init();
+#endif
+
+    boot_meta_init();
+
+    if (requested)
+        return 0;
+
+    /*User App Integrity ok?*/
+    boot_app_check(&boot_app);
+
+    return boot_app.status == BOOT_APP_VALID && !boot_meta_boot_flag();
+}
+
+void bootloader_init(void)
+{
+    /*Clear Boot Flag, BOOT MODE until the server is done*/
+    if (boot_meta_boot_flag())
+        boot_meta_clear_boot_flag();
+
+    /*link settings negotiated with the app carry over*/
+    if (boot_request.baudrate)
+    {
+        uart_set_baudrate(&uart2, boot_request.baudrate);
+#if defined(__arm__) && IRQ_LATENCY_TRACE
+        /*byte time of the new baudrate*/
+        irq_latency_init(&link_rx_latency, &uart2.handle);
+#endif
+    }
+
+    boot_fsm_init(&boot_fsm, &uart2);
+
+    if (boot_request.magic == BOOT_MAILBOX_MAGIC)
+    {
+        boot_fsm_resume(&boot_fsm, boot_request.seq, (boot_request.flags & BOOT_MAILBOX_REPLY) != 0,
+                        boot_request.start_timeout);
+    }
+}
+
+void bootloader_exec(void)
+{
+    boot_fsm_run(&boot_fsm);
+}
+
+uint8_t bootloader_handoff_due(void)
+{
+    if (!boot_fsm_handoff_due(&boot_fsm))
+        return 0;
+
+    /*one try, the soft reset takes over if the app does not check out*/
+    boot_fsm.iface.handoff = 0;
+
+    /*User App Integrity ok? The record was verified at DOWNLOAD_FINISHED*/
+    return boot_app_check(&boot_app) == BOOT_APP_VALID;
+}
@@ -10,11 +10,15 @@
 #include "main.h"
 #include "peripherals_init.h"
 #include "led_animation.h"
+#include "bootloader.h"
+#include "flash_bench.h"
+#include "crc32_bench.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
+#define IRQ_LATENCY_REPORT_PERIOD     (5000)   /* ms */
 
 
 void print_startup_message(void)
@@ -34,13 +38,67 @@ void print_startup_message(void)
   */
 int main(void)
 {
+#if BOOT_FAST_TRACE
+  RCC->AHBENR |= RCC_AHBENR_GPIOAEN;
+  GPIOA->MODER = (GPIOA->MODER & ~GPIO_MODER_MODER15) | GPIO_MODER_MODER15_0;
+  GPIOA->BSRR = GPIO_BSRR_BS_15;
+#endif
+
+  /* Fast path: no mailbox request, verified app and no boot flag, jump before clocks, UARTs and printf */
+  if (bootloader_app_ready())
+  {
+#if BOOT_FAST_TRACE
+    GPIOA->BRR = GPIO_BRR_BR_15;
+#endif
+    boot_app_jump(&boot_app);
+  }
+
   peripherals_init();
   print_startup_message();
+
+#if FLASH_BENCH
+  /* the bench page is the delta scratch page, an interrupted update resumes from it */
+  static flash_bench_t flash_bench;
+  if (boot_meta_delta_staged())
+  {
+    printf("flash bench : skipped, delta update staged in the scratch page\r\n");
+  }
+  else
+  {
+    flash_bench_run(&flash_bench);
+    flash_bench_report(&flash_bench);
+  }
+#endif
+
+#if CRC32_BENCH
+  static crc32_bench_t crc32_bench;
+  crc32_bench_run(&crc32_bench);
+  crc32_bench_report(&crc32_bench);
+#endif
+
   led_breath_init();
+  bootloader_init();
   
   while (1)
   {
 	  led_breath_exec();
+	  bootloader_exec();
+
+	  /* New image verified and its reply out: start it without a reset */
+	  if (bootloader_handoff_due())
+	  {
+		  peripherals_deinit();
+		  boot_app_handoff(&boot_app, boot_fsm.iface.finished_us);
+	  }
+
+#if IRQ_LATENCY_TRACE
+	  static uint32_t report_tick = 0;
+	  if (HAL_GetTick() - report_tick > IRQ_LATENCY_REPORT_PERIOD)
+	  {
+		  report_tick = HAL_GetTick();
+		  irq_latency_report(&link_rx_latency);
+	  }
+#endif
   }
 }
 
@@ -1,9 +1,13 @@
 #include "peripherals_init.h"
+#include "irq_priority.h"
+#include "crc32.h"
+#include "boot_config.h"
 
 
 /* Private function prototypes -----------------------------------------------*/
 static void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void vector_table_to_sram(void);
 extern void Error_Handler(void);
 
 /*UART driver */
@@ -20,7 +24,17 @@ uint8_t uart1_rx_buff[UART1_RX_DATA_BUFF_SIZE];
 #define UART2_RX_DATA_BUFF_SIZE       (256)
 #define UART2_TX_DATA_BUFF_SIZE       (256)
 uint8_t uart2_tx_buff[UART2_TX_DATA_BUFF_SIZE];
-uint8_t uart2_rx_buff[UART2_TX_DATA_BUFF_SIZE];
+uint8_t uart2_rx_buff[UART2_RX_DATA_BUFF_SIZE];
+
+/*UART2 bytes taken while the flash is busy: a 40 ms page erase at 230400 baud */
+#define UART2_RX_STASH_SIZE           (1024)
+static uint8_t uart2_rx_stash[UART2_RX_STASH_SIZE];
+
+#if defined(__arm__)
+/*Vector table copy at the start of SRAM, see STM32F030CCTX_FLASH.ld */
+extern uint32_t _sram_vector[];
+extern uint32_t _eram_vector[];
+#endif
 
 /**
   * @brief System Clock Configuration
@@ -107,20 +121,94 @@ static void MX_GPIO_Init(void)
 }
 
 
+/**
+  * @brief Take exceptions from SRAM: the core stalls on any flash fetch while
+  *        the flash is busy, vector reads included. The remap must be undone
+  *        before jumping to the application.
+  * @retval None
+  */
+static void vector_table_to_sram(void)
+{
+#if defined(__arm__)
+  const uint32_t *flash_vector = (const uint32_t *)FLASH_BASE;
+  uint32_t words = (uint32_t)(_eram_vector - _sram_vector);
+
+  __disable_irq();
+
+  for (uint32_t i = 0; i < words; i++)
+  {
+    _sram_vector[i] = flash_vector[i];
+  }
+
+  __HAL_SYSCFG_REMAPMEMORY_SRAM();
+
+  __enable_irq();
+#endif
+}
+
+
 void peripherals_init(void)
 {
   /* MCU Configuration--------------------------------------------------------*/
   HAL_Init();
 
+  /* Vectors and the link rx path keep running while the flash is busy */
+  vector_table_to_sram();
+
   /* Configure the system clock */
   SystemClock_Config();
 
+  /* SysTick bookkeeping runs below every peripheral, see irq_priority.h */
+  HAL_InitTick(IRQ_PRIO_SYSTICK);
+
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
 
+  /* CRC unit and its DMA channel, crc32_update() */
+  crc32_hw_init();
+
   /* Init UART */
   uart_init_it(&uart1, uart1_rx_buff, UART1_RX_DATA_BUFF_SIZE, uart1_tx_buff, UART1_TX_DATA_BUFF_SIZE);
   uart_init_it(&uart2, uart2_rx_buff, UART2_RX_DATA_BUFF_SIZE, uart2_tx_buff, UART2_TX_DATA_BUFF_SIZE);
+  uart_rx_stash_init(&uart2, uart2_rx_stash, UART2_RX_STASH_SIZE);
+
+#if BOOT_LINK_XONXOFF
+  /* 2-wire gateway link, XOFF at 3/4 of the rx ring and while a page erases */
+  uart_flow_control_init(&uart2, 1, UART2_RX_DATA_BUFF_SIZE / 4, (UART2_RX_DATA_BUFF_SIZE * 3) / 4);
+#endif
+
+#if IRQ_LATENCY_TRACE
+  irq_latency_init(&link_rx_latency, &uart2.handle);
+#endif
 
 }
 
+/**
+  * @brief Undo peripherals_init() before a handoff to the app: only what it
+  *        set up, the rest is still at its reset state. SysTick, the NVIC
+  *        and the SRAM remap are left to boot_app_handoff().
+  * @note  Debug output still queued on uart1 is dropped.
+  * @retval None
+  */
+void peripherals_deinit(void)
+{
+  /* UARTs, HAL_UART_MspDeInit(): clock, pins, NVIC line */
+  if (uart1.handle.gState != HAL_UART_STATE_RESET)
+    HAL_UART_DeInit(&uart1.handle);
+
+  if (uart2.handle.gState != HAL_UART_STATE_RESET)
+    HAL_UART_DeInit(&uart2.handle);
+
+  /* CRC unit and its DMA channel */
+  DMA1_Channel1->CCR = 0;
+  __HAL_RCC_CRC_CLK_DISABLE();
+  __HAL_RCC_DMA1_CLK_DISABLE();
+
+  /* LEDs and button back to inputs */
+  HAL_GPIO_DeInit(LED1_GPIO_Port, LED1_Pin);
+  HAL_GPIO_DeInit(GPIOB, LED2_Pin|LED3_Pin|USER_BTN_Pin);
+
+  /* HSE back to HSI, only if SystemClock_Config() switched */
+  if (__HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_HSI)
+    HAL_RCC_DeInit();
+}
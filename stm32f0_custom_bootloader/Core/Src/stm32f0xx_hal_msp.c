@@ -19,6 +19,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "irq_priority.h"
 
 
 /* Private typedef -----------------------------------------------------------*/
@@ -69,7 +70,7 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
     /* USART1 interrupt Init */
-    HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_DEBUG_UART, 0);
     HAL_NVIC_EnableIRQ(USART1_IRQn);
 
   }
@@ -92,7 +93,7 @@ void HAL_UART_MspInit(UART_HandleTypeDef* huart)
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
     /* USART2 interrupt Init */
-    HAL_NVIC_SetPriority(USART2_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(USART2_IRQn, IRQ_PRIO_LINK_UART, 0);
     HAL_NVIC_EnableIRQ(USART2_IRQn);
 
   }
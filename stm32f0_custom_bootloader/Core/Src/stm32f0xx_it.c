@@ -20,16 +20,24 @@
 #include "main.h"
 #include "stm32f0xx_it.h"
 #include "peripherals_init.h"
+#include "ram_func.h"
 
 
 /* Private includes ----------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
+/* Flash erase/program running: the HAL handlers live in flash, only the SRAM
+   paths below may run until it is done (ram_func.h) */
+#define FLASH_IS_BUSY()   ((FLASH->SR & FLASH_SR_BSY) != 0U)
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 /* External variables --------------------------------------------------------*/
 
+#if IRQ_LATENCY_TRACE
+irq_latency_t link_rx_latency;
+#endif
+
 
 /******************************************************************************/
 /*           Cortex-M0 Processor Interruption and Exception Handlers          */
@@ -77,8 +85,24 @@ void PendSV_Handler(void)
 /**
   * @brief This function handles System tick timer.
   */
-void SysTick_Handler(void)
+RAM_FUNC void SysTick_Handler(void)
 {
+  if (FLASH_IS_BUSY())
+  {
+    /* keep the time base, the callback waits for the next tick */
+    uwTick += uwTickFreq;
+    return;
+  }
+
+  /* a transfer the uart busy paths parked goes on, whether or not more data is queued */
+  if (uart1.data.tx.parked || uart2.data.tx.parked)
+  {
+    __disable_irq();
+    uart_tx_resume(&uart1);
+    uart_tx_resume(&uart2);
+    __enable_irq();
+  }
+
   HAL_SYSTICK_Callback();
   HAL_IncTick();
 }
@@ -93,16 +117,43 @@ void SysTick_Handler(void)
 /**
   * @brief This function handles USART1 global interrupt.
   */
-void USART1_IRQHandler(void)
+RAM_FUNC void USART1_IRQHandler(void)
 {
+  if (FLASH_IS_BUSY())
+  {
+    /* debug port, a byte received meanwhile is dropped */
+    if (USART1->ISR & USART_ISR_RXNE)
+    {
+      (void)USART1->RDR;
+    }
+    USART1->ICR = USART_ICR_ORECF;
+    uart_tx_park(&uart1);
+    return;
+  }
+
   HAL_UART_IRQHandler(&uart1.handle);
 }
 
 /**
   * @brief This function handles USART2 global interrupt.
   */
-void USART2_IRQHandler(void)
+RAM_FUNC void USART2_IRQHandler(void)
 {
+  if (FLASH_IS_BUSY())
+  {
+    /* link rx keeps going, tx is parked until the flash is done */
+    if (USART2->ISR & USART_ISR_RXNE)
+    {
+      uart_rx_stash_put(&uart2, (uint8_t)USART2->RDR);
+    }
+    USART2->ICR = USART_ICR_ORECF;
+    uart_tx_park(&uart2);
+    return;
+  }
+
+#if IRQ_LATENCY_TRACE
+  irq_latency_rx_entry(&link_rx_latency, &uart2.handle);
+#endif
   HAL_UART_IRQHandler(&uart2.handle);
 }
 
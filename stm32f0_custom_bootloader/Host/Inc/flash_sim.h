@@ -0,0 +1,35 @@
+/**
+ * @file flash_sim.h
+ * @brief Host emulation of the STM32F030xC internal flash behind flash_driver.h
+ */
+
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t page_erase_us;     /* tERASE, one 2 KB page */
+    uint32_t halfword_prog_us;  /* tPROG, one half-word */
+    uint8_t  rx_from_ram;       /* vectors and link rx path in SRAM, bytes keep coming in (ram_func.h) */
+} flash_sim_cfg_t;
+
+typedef struct
+{
+    uint32_t pages_erased;
+    uint32_t halfwords_programmed;
+    uint32_t program_errors;    /* PGERR: half-word not erased */
+    uint64_t busy_us;           /* time the cpu was stalled by the flash */
+} flash_sim_stats_t;
+
+void flash_sim_init(const flash_sim_cfg_t *cfg);
+void flash_sim_get_stats(flash_sim_stats_t *stats);
+
+/** Flash contents before the run, e.g. a previous app; no time, no stats */
+void flash_sim_load(uint32_t address, const uint8_t *data, uint32_t len);
+
+/** Power cut right after the erase of page erases from now (1: the next one), cut() does not return */
+void flash_sim_power_cut(uint32_t erases, void (*cut)(void));
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file host_boot.h
+ * @brief Gateway side of the bootloader download, drives boot_fsm over a host_link
+ */
+
+#ifndef HOST_BOOT_H
+#define HOST_BOOT_H
+
+#include <stdint.h>
+#include "host_link.h"
+#include "boot_protocol.h"
+
+typedef struct
+{
+    uint32_t image_bytes;       /* user app size */
+    uint32_t stream_bytes;      /* sent as blocks, compressed in BOOT_MODE_BINARY_LZ, the patch in BOOT_MODE_DELTA, the list in BOOT_MODE_SEGMENTS */
+    uint32_t base_bytes;        /* BOOT_MODE_DELTA, image the patch applies to */
+    uint32_t pages_differ;      /* BOOT_MODE_BINARY_SPARSE, pages of the image unlike the manifest */
+    uint32_t pages_total;       /* pages of the image, 0 in the other modes */
+    uint32_t segments;          /* BOOT_MODE_SEGMENTS, segments in the list; image_bytes is their span */
+    uint32_t frames;            /* requests confirmed by the target */
+    uint32_t retries;           /* requests sent again after a timeout or a crc NACK */
+    uint32_t wire_bytes;        /* bytes written to the link, framing included */
+    uint64_t elapsed_us;        /* BOOT_START_DOWNLOAD -> DOWNLOAD_FINISHED reply */
+    uint64_t erase_us;          /* BOOT_START_DOWNLOAD round trip, the app area erase */
+    uint32_t baud;
+    uint32_t boot_version;      /* ENTER_BOOT_OK, 0 from a bootloader that does not tell */
+    uint8_t window;             /* blocks in flight, binary mode */
+    uint32_t resumed;           /* bytes the target kept from an interrupted download, not sent */
+    uint8_t status;             /* DOWNLOAD_FINISHED status, BOOT_ST_OK is BOOT_SUCCEED */
+    uint16_t pages_programmed;  /* DOWNLOAD_FINISHED summary */
+    uint16_t pages_skipped;     /* identical to the flash contents */
+    uint16_t erases_skipped;    /* pages already blank */
+} host_boot_report_t;
+
+/** Download an image to BOOT_APP_START_ADDR, window caps the blocks in flight (0: as advertised).
+ *  Binary downloads resume where an interrupted one of the same image stopped. cut > 0 drops the
+ *  session with CANCEL_BOOT once that many bytes are acked (resume tests). BOOT_MODE_BINARY_LZ
+ *  sends the image compressed, from the start. BOOT_MODE_DELTA sends a patch against base, the
+ *  image the target holds, from the page it resumes at; base is unused in the other modes.
+ *  BOOT_MODE_BINARY_SPARSE asks for the manifest first and sends the pages that differ.
+ *  BOOT_MODE_SEGMENTS sends image, a segment list (host_seg.h) of size bytes, as it is.
+ *  An image whose header (boot_image.h) asks for a newer bootloader than ENTER_BOOT_OK names
+ *  is not started.
+ *  Returns 0 on BOOT_SUCCEED, 1 if cut, -1 on failure. */
+int host_boot_download(host_link_t *link, const uint8_t *image, uint32_t size, const uint8_t *base, uint32_t base_size,
+                       boot_mode_t mode, uint8_t window, uint32_t cut, host_boot_report_t *report);
+
+void host_boot_print_report(const char *name, const host_boot_report_t *report);
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * @file host_delta.h
+ * @brief Gateway side patch generator for BOOT_MODE_DELTA (format in boot_delta.h)
+ */
+
+#ifndef HOST_DELTA_H
+#define HOST_DELTA_H
+
+#include <stdint.h>
+
+/** Worst case patch for a size byte image: inserts broken by the shortest copies */
+#define HOST_DELTA_BOUND(size)  ((size) + 3 * ((size) / 8 + (size) / 2048 + 2))
+
+/**
+ * Patch rebuilding image (size bytes) from old (old_size bytes) in place, into out
+ * (HOST_DELTA_BOUND(size) bytes). page_offsets[n] gets the patch offset of the op
+ * that starts page n of the image, (size + 2047) / 2048 entries. Returns the patch length.
+ */
+uint32_t host_delta_encode(const uint8_t *old, uint32_t old_size, const uint8_t *image, uint32_t size, uint8_t *out,
+                           uint32_t *page_offsets);
+
+#endif
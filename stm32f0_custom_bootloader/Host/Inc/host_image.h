@@ -0,0 +1,19 @@
+/**
+ * @file host_image.h
+ * @brief Post-link side of the image header (format in boot_image.h)
+ */
+
+#ifndef HOST_IMAGE_H
+#define HOST_IMAGE_H
+
+#include <stdint.h>
+
+/**
+ * Fill the header the app compiled in at BOOT_IMAGE_HEADER_OFFSET of image
+ * (size bytes from BOOT_APP_START_ADDR): image size, build id, image and
+ * header crcs. build_id 0 takes the image crc with a zero build id, the
+ * same build gives the same id. Returns 0, -1 if there is no header.
+ */
+int host_image_stamp(uint8_t *image, uint32_t size, uint32_t build_id);
+
+#endif
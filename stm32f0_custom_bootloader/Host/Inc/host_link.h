@@ -0,0 +1,57 @@
+/**
+ * @file host_link.h
+ * @brief Host (gateway) side of the simulated link, runs on the pty slave.
+ */
+
+#ifndef HOST_LINK_H
+#define HOST_LINK_H
+
+#include <stdint.h>
+
+#define HOST_LINK_TXQ_SIZE      (8192)
+
+typedef struct
+{
+    int fd;
+    uint32_t baud;              /* host uart pacing, 0 writes as fast as the pty takes it */
+    uint8_t xonxoff;            /* honour XON/XOFF from the target, escape binary data */
+    uint8_t tx_paused;          /* XOFF received */
+    uint8_t rx_escaped;         /* previous rx byte was an escape */
+    uint64_t wire_us;           /* time the host uart finishes its last byte */
+    uint8_t txq[HOST_LINK_TXQ_SIZE];
+    uint32_t txq_head;
+    uint32_t txq_len;
+} host_link_t;
+
+typedef struct
+{
+    uint32_t payload_bytes;     /* bytes the host wanted across */
+    uint32_t good_bytes;        /* bytes confirmed intact */
+    uint32_t bad_bytes;         /* bytes corrupted or lost */
+    uint64_t elapsed_us;        /* first byte sent -> last byte confirmed */
+    uint32_t baud;              /* simulated line rate, for efficiency */
+} host_link_report_t;
+
+/** Open the pty slave in raw mode */
+int host_link_open(host_link_t *link, const char *device, uint32_t baud, uint8_t xonxoff);
+void host_link_close(host_link_t *link);
+
+/** Queue payload bytes for the target, returns bytes accepted */
+uint32_t host_link_write(host_link_t *link, const uint8_t *data, uint32_t len);
+
+/** Free payload room in the host tx queue (worst case escaping) */
+uint32_t host_link_write_room(host_link_t *link);
+
+/** Push queued bytes to the pty at the host line rate, unless paused; -1 if the link is gone */
+int host_link_service(host_link_t *link);
+
+/** Wait up to timeout_ms and read payload bytes, link control is consumed; -1 if the link is gone */
+int host_link_read(host_link_t *link, uint8_t *data, uint32_t len, int timeout_ms);
+
+/** Stream a pattern to the target, at most window bytes unechoed, and check what comes back */
+int host_link_loopback(host_link_t *link, uint32_t bytes, uint32_t window, host_link_report_t *report);
+
+/** Print effective throughput of a finished run */
+void host_link_print_report(const char *name, const host_link_report_t *report);
+
+#endif
@@ -0,0 +1,17 @@
+/**
+ * @file host_lz.h
+ * @brief Gateway side LZ compressor for BOOT_MODE_BINARY_LZ (format in boot_lz.h)
+ */
+
+#ifndef HOST_LZ_H
+#define HOST_LZ_H
+
+#include <stdint.h>
+
+/** Worst case output for size input bytes: all literals */
+#define HOST_LZ_BOUND(size)     ((size) + (size) / 255 + 16)
+
+/** Compress size bytes into out (HOST_LZ_BOUND(size) bytes), returns the stream length */
+uint32_t host_lz_compress(const uint8_t *in, uint32_t size, uint8_t *out);
+
+#endif
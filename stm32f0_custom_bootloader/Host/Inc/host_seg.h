@@ -0,0 +1,42 @@
+/**
+ * @file host_seg.h
+ * @brief Gateway side packer for BOOT_MODE_SEGMENTS (format in boot_seg.h)
+ */
+
+#ifndef HOST_SEG_H
+#define HOST_SEG_H
+
+#include <stdint.h>
+
+#define HOST_SEG_MAX                    (256)
+#define HOST_SEG_MIN_GAP                (16)    /* shorter gaps cost more as a segment header, sent as 0xFF */
+
+/** Segment list for count segments of bytes data in total */
+#define HOST_SEG_BOUND(count, bytes)    (8 + 8 * (count) + (bytes))
+
+typedef struct
+{
+    uint32_t address;           /* load address */
+    uint32_t len;
+} host_seg_t;
+
+/**
+ * Load an ELF file (PT_LOAD program headers at their physical address),
+ * an Intel HEX file or a raw binary (at BOOT_APP_START_ADDR) into image,
+ * the app area (BOOT_APP_MAX_SIZE bytes, 0xFF where nothing loads). segs
+ * gets the ranges worth sending: what the file loads, without the runs of
+ * 0xFF in pages that get data anyway, the writer fills those with 0xFF.
+ * A page the file loads as all 0xFF is kept, it has to be erased. end
+ * gets the offset after the last byte the file loads.
+ * Returns the segment count, 0 if the file loads outside the app area.
+ */
+uint32_t host_seg_load(const uint8_t *file, uint32_t size, uint8_t *image, host_seg_t *segs, uint32_t max,
+                       uint32_t *end);
+
+/** Segment list of image into out (HOST_SEG_BOUND() bytes), returns its length */
+uint32_t host_seg_pack(const uint8_t *image, const host_seg_t *segs, uint32_t count, uint8_t *out);
+
+/** Span from BOOT_APP_START_ADDR to the end of the last segment of a segment list, 0 if malformed */
+uint32_t host_seg_span(const uint8_t *list, uint32_t len);
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file stm32f0xx_hal.h
+ * @brief Host replacement of the STM32F0 HAL header.
+ *
+ * @note  Only the subset of types and functions used by the portable
+ *        modules in Core/ is declared here. The hardware side is emulated
+ *        by uart_sim.c, so uart_driver.c and friends compile unmodified.
+ */
+
+#ifndef HOST_STM32F0XX_HAL_H
+#define HOST_STM32F0XX_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define __IO volatile
+
+typedef enum
+{
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY      0xFFFFFFFFU
+
+/* USART "registers": one simulated port per instance --------------------------*/
+typedef struct
+{
+    uint32_t id;
+} USART_TypeDef;
+
+extern USART_TypeDef sim_usart_regs[2];
+
+#define USART1 (&sim_usart_regs[0])
+#define USART2 (&sim_usart_regs[1])
+
+/* UART Init constants -------------------------------------------------------*/
+#define UART_WORDLENGTH_8B              0x00000000U
+#define UART_STOPBITS_1                 0x00000000U
+#define UART_PARITY_NONE                0x00000000U
+#define UART_MODE_TX_RX                 0x0000000CU
+#define UART_HWCONTROL_NONE             0x00000000U
+#define UART_OVERSAMPLING_16            0x00000000U
+#define UART_ONE_BIT_SAMPLE_DISABLE     0x00000000U
+#define UART_ADVFEATURE_NO_INIT         0x00000000U
+
+typedef uint32_t HAL_UART_StateTypeDef;
+
+#define HAL_UART_STATE_RESET            0x00000000U
+#define HAL_UART_STATE_READY            0x00000020U
+#define HAL_UART_STATE_BUSY_TX          0x00000021U
+#define HAL_UART_STATE_BUSY_RX          0x00000022U
+
+typedef struct
+{
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+    uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+typedef struct
+{
+    uint32_t AdvFeatureInit;
+} UART_AdvFeatureInitTypeDef;
+
+typedef struct __UART_HandleTypeDef
+{
+    USART_TypeDef              *Instance;
+    UART_InitTypeDef           Init;
+    UART_AdvFeatureInitTypeDef AdvancedInit;
+    uint8_t                    *pTxBuffPtr;
+    uint16_t                   TxXferSize;
+    __IO uint16_t              TxXferCount;
+    uint8_t                    *pRxBuffPtr;
+    uint16_t                   RxXferSize;
+    __IO uint16_t              RxXferCount;
+    __IO HAL_UART_StateTypeDef gState;
+    __IO HAL_UART_StateTypeDef RxState;
+    __IO uint32_t              ErrorCode;
+} UART_HandleTypeDef;
+
+/* HAL API emulated on the host ----------------------------------------------*/
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+
+uint32_t HAL_GetTick(void);
+void HAL_IncTick(void);
+void HAL_SYSTICK_Callback(void);
+
+/* Cortex-M core ------------------------------------------------------------*/
+void NVIC_SystemReset(void);
+
+#define __disable_irq() do { } while (0)
+#define __enable_irq()  do { } while (0)
+
+#endif
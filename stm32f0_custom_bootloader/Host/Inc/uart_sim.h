@@ -0,0 +1,58 @@
+/**
+ * @file uart_sim.h
+ * @brief Host emulation of the STM32 USART peripheral on top of a Linux
+ *        pseudo-terminal, with simulated line rate, latency and bit errors.
+ */
+
+#ifndef UART_SIM_H
+#define UART_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "stm32f0xx_hal.h"
+
+typedef struct
+{
+    uint32_t baud;              /* simulated line rate in bit/s (10 bits per byte on the wire) */
+    uint32_t latency_us;        /* one-way link latency added to every byte, e.g. a gateway hop */
+    double   bit_error_rate;    /* probability of a flipped bit, applied in both directions */
+} uart_sim_cfg_t;
+
+typedef struct
+{
+    uint32_t rx_bytes;          /* bytes delivered to the HAL rx callback */
+    uint32_t tx_bytes;          /* bytes put on the wire by the HAL */
+    uint32_t bit_errors;        /* bits flipped by the error injector */
+    uint32_t overruns;          /* bytes dropped because reception was not armed */
+} uart_sim_stats_t;
+
+/** Back an USART instance with a new pty, returns the slave device name */
+int  uart_sim_attach_pty(USART_TypeDef *instance, const uart_sim_cfg_t *cfg, char *slave, size_t slave_len);
+
+/** Back an USART instance with stdout (debug port), rx is never fed */
+void uart_sim_attach_stdout(USART_TypeDef *instance);
+
+/** Emulate the USART interrupts: move due bytes between the wire and the HAL */
+void uart_sim_poll(void);
+
+/** Read line counters of an USART instance */
+void uart_sim_get_stats(USART_TypeDef *instance, uart_sim_stats_t *stats);
+
+/** Time of one byte on the wire in microseconds */
+uint32_t uart_sim_byte_time_us(uint32_t baud);
+
+/** CPU stalled (flash erase/program from flash): no interrupt is served for us,
+ *  the rx data register keeps the first byte that arrives, the rest overrun */
+void uart_sim_stall(uint32_t us);
+
+/** Flash busy for us with the vectors and rx path in SRAM: the rx interrupt
+ *  still takes every byte, into the driver stash (uart_rx_stash_put()) */
+void uart_sim_busy(uint32_t us);
+
+/** Monotonic simulation clock in microseconds */
+uint64_t hal_sim_time_us(void);
+
+/** Emulate SysTick: raise HAL_SYSTICK_Callback() once per elapsed ms */
+void hal_sim_poll(void);
+
+#endif
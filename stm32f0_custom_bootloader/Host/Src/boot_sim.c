@@ -0,0 +1,646 @@
+/**
+ * @file boot_sim.c
+ * @brief Host build of the bootloader link: uart_driver and ring buffers run
+ *        unmodified over a pseudo-terminal, a forked host process drives the
+ *        other end and reports effective throughput.
+ *
+ * @note  usage: boot_sim [--mode loopback|hex|bin|lz|delta|sparse|seg] [--image FILE] [--baud N] [--latency-us N]
+ *                         [--ber P] [--bytes N] [--window N] [--boot-window N] [--interrupt N]
+ *                         [--power-cut N] [--min-boot N] [--xonxoff] [--external]
+ *        --mode hex/bin runs the bootloader and downloads FILE (raw binary),
+ *        or a random image of --bytes, as Intel HEX lines or binary blocks;
+ *        --mode lz sends the binary blocks LZ compressed, --mode delta a patch
+ *        against what --flash leaves in the app area, recorded as verified;
+ *        --mode sparse sends the pages that differ from the target's manifest.
+ *        --mode seg packs FILE (ELF, Intel HEX or raw binary) as a segment list,
+ *        the pages between segments have to keep what --flash left there.
+ *        --power-cut resets the target right after its Nth page erase, the
+ *        download is started again and has to finish from the journal.
+ *        --boot-window caps the binary blocks in flight, 1 is stop and wait.
+ *        --interrupt drops the first binary download after N bytes (CANCEL_BOOT,
+ *        the target resets) and starts it again, it resumes from the journal.
+ *        The random image carries an image header (boot_image.h), stamped
+ *        like the post-link step does, --min-boot sets the bootloader
+ *        version it asks for.
+ *        --xonxoff enables in-band flow control on both ends of the link, as
+ *        BOOT_LINK_XONXOFF does on the target: XOFF holds the host while a
+ *        page erases.
+ *        --external only prints the pty device, so any host tool can connect.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <setjmp.h>
+#include <sys/wait.h>
+#include "uart_driver.h"
+#include "uart_sim.h"
+#include "flash_sim.h"
+#include "host_link.h"
+#include "host_boot.h"
+#include "host_seg.h"
+#include "host_image.h"
+#include "boot_image.h"
+#include "bootloader.h"
+#include "boot_meta.h"
+#include "crc32.h"
+
+/*UART driver, same instances as peripherals_init.c */
+uart_driver_t uart1 = {.handle.Instance = USART1};
+uart_driver_t uart2 = {.handle.Instance = USART2};
+
+#define UART1_RX_DATA_BUFF_SIZE       (256)
+#define UART1_TX_DATA_BUFF_SIZE       (256)
+uint8_t uart1_tx_buff[UART1_TX_DATA_BUFF_SIZE];
+uint8_t uart1_rx_buff[UART1_RX_DATA_BUFF_SIZE];
+
+#define UART2_RX_DATA_BUFF_SIZE       (256)
+#define UART2_TX_DATA_BUFF_SIZE       (256)
+uint8_t uart2_tx_buff[UART2_TX_DATA_BUFF_SIZE];
+uint8_t uart2_rx_buff[UART2_RX_DATA_BUFF_SIZE];
+
+#define UART2_RX_STASH_SIZE           (1024)
+static uint8_t uart2_rx_stash[UART2_RX_STASH_SIZE];
+
+#define LOOPBACK_CHUNK_SIZE           (16)
+
+typedef enum
+{
+    BOOT_SIM_LOOPBACK = 0x00,
+    BOOT_SIM_HEX,
+    BOOT_SIM_BIN,
+    BOOT_SIM_LZ,
+    BOOT_SIM_DELTA,
+    BOOT_SIM_SPARSE,
+    BOOT_SIM_SEGMENTS,
+} boot_sim_mode_t;
+
+typedef enum
+{
+    BOOT_SIM_FLASH_OLD = 0x00,  /* a different app fills the app area */
+    BOOT_SIM_FLASH_BLANK,       /* erased chip */
+    BOOT_SIM_FLASH_SAME,        /* the image is already there */
+    BOOT_SIM_FLASH_PATCH,       /* the image with a few bytes changed, a minor version bump */
+    BOOT_SIM_FLASH_SHIFT,       /* the image without 64 bytes from a third in, code added in between */
+} boot_sim_flash_t;
+
+typedef struct
+{
+    boot_sim_mode_t mode;
+    const char *image_file;
+    uart_sim_cfg_t link;
+    uint32_t bytes;
+    uint32_t window;
+    uint32_t boot_window;
+    uint32_t interrupt;         /* bytes before the first download is dropped, 0 never */
+    uint32_t power_cut;         /* target page erases before a reset, 0 never */
+    uint32_t min_boot;          /* random image header, bootloader version it needs */
+    boot_sim_flash_t flash;
+    int xonxoff;
+    int external;
+} boot_sim_args_t;
+
+static jmp_buf boot_sim_reset;
+static uint32_t boot_sim_resets;
+static uint32_t boot_sim_stash_overruns;    /* link bytes the rx stash dropped before the last reset */
+static uint8_t boot_sim_app_ready;     /* main() fast path decision at the last reset */
+static const uint8_t *boot_sim_base;   /* app area before the run, the delta base */
+static uint32_t boot_sim_base_size;
+static uint8_t boot_sim_before[BOOT_APP_MAX_SIZE];     /* app area before the run */
+static host_seg_t boot_sim_segs[HOST_SEG_MAX];
+static uint32_t boot_sim_seg_count;
+static uint8_t *boot_sim_list;          /* segment list the host sends */
+static uint32_t boot_sim_list_size;
+
+void Error_Handler(void)
+{
+    fprintf(stderr, "boot sim : Error_Handler()\r\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Soft reset: the target restarts from main, flash contents persist
+ */
+void NVIC_SystemReset(void)
+{
+    boot_sim_resets++;
+    boot_sim_stash_overruns += uart2.data.rx.stash_overruns;
+    longjmp(boot_sim_reset, 1);
+}
+
+void HAL_SYSTICK_Callback(void)
+{
+    boot_fsm_update_timers(&boot_fsm);
+}
+
+/**
+ * @brief Target side of the loopback benchmark: everything received on the
+ *        link ring buffer is sent back through the tx ring buffer.
+ */
+static void target_loopback_exec(uart_driver_t *driver)
+{
+    uint8_t chunk[LOOPBACK_CHUNK_SIZE];
+    uint16_t len = uart_get_rx_data_len(driver);
+
+    if (len == 0)
+        return;
+
+    len = (len > LOOPBACK_CHUNK_SIZE) ? LOOPBACK_CHUNK_SIZE : len;
+    uart_fetch_rx_data(driver, chunk, len);
+
+    /* only consume what the tx ring accepted */
+    if (uart_transmit_it(driver, chunk, len))
+        uart_read_rx_data(driver, chunk, len);
+}
+
+static void boot_sim_usage(const char *prog)
+{
+    printf("usage: %s [--mode loopback|hex|bin|lz|delta|sparse|seg] [--image FILE] [--baud N] [--latency-us N] [--ber P]\r\n"
+           "       [--bytes N] [--window N] [--boot-window N] [--flash old|blank|same|patch|shift]\r\n"
+           "       [--interrupt N] [--power-cut N] [--min-boot N] [--xonxoff] [--external]\r\n", prog);
+}
+
+static int boot_sim_parse_args(int argc, char **argv, boot_sim_args_t *args)
+{
+    static const struct option options[] = {
+        {"mode",       required_argument, NULL, 'm'},
+        {"image",      required_argument, NULL, 'i'},
+        {"baud",       required_argument, NULL, 'b'},
+        {"latency-us", required_argument, NULL, 'l'},
+        {"ber",        required_argument, NULL, 'e'},
+        {"bytes",      required_argument, NULL, 'n'},
+        {"window",     required_argument, NULL, 'w'},
+        {"boot-window", required_argument, NULL, 'W'},
+        {"flash",      required_argument, NULL, 'F'},
+        {"interrupt",  required_argument, NULL, 'I'},
+        {"power-cut",  required_argument, NULL, 'P'},
+        {"min-boot",   required_argument, NULL, 'V'},
+        {"xonxoff",    no_argument,       NULL, 'f'},
+        {"external",   no_argument,       NULL, 'x'},
+        {"help",       no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:i:b:l:e:n:w:W:F:I:P:V:fxh", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            if (strcmp(optarg, "hex") == 0)
+                args->mode = BOOT_SIM_HEX;
+            else if (strcmp(optarg, "bin") == 0)
+                args->mode = BOOT_SIM_BIN;
+            else if (strcmp(optarg, "lz") == 0)
+                args->mode = BOOT_SIM_LZ;
+            else if (strcmp(optarg, "delta") == 0)
+                args->mode = BOOT_SIM_DELTA;
+            else if (strcmp(optarg, "sparse") == 0)
+                args->mode = BOOT_SIM_SPARSE;
+            else if (strcmp(optarg, "seg") == 0)
+                args->mode = BOOT_SIM_SEGMENTS;
+            else
+                args->mode = BOOT_SIM_LOOPBACK;
+            break;
+        case 'i': args->image_file = optarg; break;
+        case 'b': args->link.baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'l': args->link.latency_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'e': args->link.bit_error_rate = strtod(optarg, NULL); break;
+        case 'n': args->bytes = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'w': args->window = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'W': args->boot_window = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'I': args->interrupt = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'P': args->power_cut = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'V': args->min_boot = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'F':
+            if (strcmp(optarg, "blank") == 0)
+                args->flash = BOOT_SIM_FLASH_BLANK;
+            else if (strcmp(optarg, "same") == 0)
+                args->flash = BOOT_SIM_FLASH_SAME;
+            else if (strcmp(optarg, "patch") == 0)
+                args->flash = BOOT_SIM_FLASH_PATCH;
+            else if (strcmp(optarg, "shift") == 0)
+                args->flash = BOOT_SIM_FLASH_SHIFT;
+            else
+                args->flash = BOOT_SIM_FLASH_OLD;
+            break;
+        case 'f': args->xonxoff = 1; break;
+        case 'x': args->external = 1; break;
+        default:
+            boot_sim_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief User app image: raw binary file, or a reproducible random one
+ */
+static uint8_t *boot_sim_load_image(const boot_sim_args_t *args, uint32_t *size)
+{
+    uint8_t *image = NULL;
+
+    if (args->image_file != NULL)
+    {
+        FILE *f = fopen(args->image_file, "rb");
+        if (f == NULL)
+            return NULL;
+
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        image = (len > 0) ? malloc((size_t)len) : NULL;
+        if (image != NULL && fread(image, 1, (size_t)len, f) != (size_t)len)
+        {
+            free(image);
+            image = NULL;
+        }
+
+        fclose(f);
+        *size = (uint32_t)len;
+        return image;
+    }
+
+    image = malloc(args->bytes);
+    if (image == NULL)
+        return NULL;
+
+    uint32_t x = 0x1234567U;
+    for (uint32_t i = 0; i < args->bytes; i++)
+    {
+        x = x * 1103515245U + 12345U;
+        image[i] = (uint8_t)(x >> 16);
+    }
+
+    /* initial SP and reset handler the boot check accepts, the header the app would compile in */
+    if (args->bytes >= 0x200)
+    {
+        uint32_t vectors[2] = {BOOT_RAM_END, BOOT_APP_START_ADDR + 0x101U};
+        boot_image_header_t header = {.magic = BOOT_IMAGE_MAGIC,
+                                      .header_version = BOOT_IMAGE_HEADER_VERSION,
+                                      .header_size = sizeof(boot_image_header_t),
+                                      .entry = vectors[1],
+                                      .min_boot_version = args->min_boot};
+
+        memcpy(image, vectors, sizeof(vectors));
+        memcpy(&image[BOOT_IMAGE_HEADER_OFFSET], &header, sizeof(header));
+        host_image_stamp(image, args->bytes, 0);
+    }
+
+    *size = args->bytes;
+    return image;
+}
+
+/**
+ * @brief Segment mode: the file laid out over the app area becomes the
+ *        image to check against, its segment list what the host sends
+ */
+static uint8_t *boot_sim_pack_segments(uint8_t *file, uint32_t *size)
+{
+    static uint8_t image[BOOT_APP_MAX_SIZE];
+    uint32_t end;
+
+    boot_sim_seg_count = host_seg_load(file, *size, image, boot_sim_segs, HOST_SEG_MAX, &end);
+    free(file);
+    if (boot_sim_seg_count == 0)
+        return NULL;
+
+    uint32_t bytes = 0;
+    for (uint32_t n = 0; n < boot_sim_seg_count; n++)
+        bytes += boot_sim_segs[n].len;
+
+    boot_sim_list = malloc(HOST_SEG_BOUND(boot_sim_seg_count, bytes));
+    if (boot_sim_list == NULL)
+        return NULL;
+
+    boot_sim_list_size = host_seg_pack(image, boot_sim_segs, boot_sim_seg_count, boot_sim_list);
+    *size = host_seg_span(boot_sim_list, boot_sim_list_size);
+    return image;
+}
+
+/**
+ * @brief App area contents left by a previous download, recorded as a
+ *        verified image for a delta update
+ */
+static void boot_sim_preload_flash(const boot_sim_args_t *args, const uint8_t *image, uint32_t size)
+{
+    static uint8_t old[BOOT_APP_MAX_SIZE];
+    uint32_t x = 0x7654321U;
+    uint32_t third = size / 3;
+
+    switch (args->flash)
+    {
+    case BOOT_SIM_FLASH_OLD:
+        for (uint32_t i = 0; i < sizeof(old); i++)
+        {
+            x = x * 1103515245U + 12345U;
+            old[i] = (uint8_t)(x >> 16);
+        }
+        flash_sim_load(BOOT_APP_START_ADDR, old, sizeof(old));
+        boot_sim_base_size = sizeof(old);
+        break;
+
+    case BOOT_SIM_FLASH_SAME:
+    case BOOT_SIM_FLASH_PATCH:
+        if (size > sizeof(old))
+            break;
+        memcpy(old, image, size);
+        if (args->flash == BOOT_SIM_FLASH_PATCH)
+        {
+            for (uint32_t i = size / 2; i < size / 2 + 16 && i < size; i++)
+                old[i] ^= 0x5A;
+        }
+        flash_sim_load(BOOT_APP_START_ADDR, old, size);
+        boot_sim_base_size = size;
+        break;
+
+    case BOOT_SIM_FLASH_SHIFT:
+        if (size > sizeof(old) || size < 3 * 64)
+            break;
+        memcpy(old, image, third);
+        memcpy(&old[third], &image[third + 64], size - third - 64);
+        flash_sim_load(BOOT_APP_START_ADDR, old, size - 64);
+        boot_sim_base_size = size - 64;
+        break;
+
+    default:
+        break;
+    }
+
+    boot_sim_base = old;
+
+    if (args->mode == BOOT_SIM_DELTA && boot_sim_base_size)
+    {
+        boot_meta_t meta;
+
+        boot_meta_init();
+        if (boot_meta_save(boot_sim_base_size, crc32_compute(old, boot_sim_base_size)) != FLASH_DRV_OK ||
+            !boot_meta_load(&meta) || boot_meta_set_verified(&meta) != FLASH_DRV_OK)
+            fprintf(stderr, "boot sim : base image record not written\r\n");
+    }
+}
+
+/**
+ * @brief Forked host process, drives the link and exits with the run status
+ */
+static int host_process(const char *device, const boot_sim_args_t *args, const uint8_t *image, uint32_t size)
+{
+    host_link_report_t report;
+    host_boot_report_t boot_report;
+    host_link_t link;
+    int st;
+
+    if (host_link_open(&link, device, args->link.baud, args->xonxoff) != 0)
+    {
+        perror("host link");
+        return EXIT_FAILURE;
+    }
+
+    if (args->mode == BOOT_SIM_LOOPBACK)
+    {
+        /* with flow control the target paces the host, no window needed */
+        uint32_t window = args->xonxoff ? args->bytes : args->window;
+
+        st = host_link_loopback(&link, args->bytes, window, &report);
+        host_link_print_report(args->xonxoff ? "xon/xoff" : "loopback", &report);
+    }
+    else
+    {
+        static const boot_mode_t modes[] = {BOOT_MODE_BINARY, BOOT_MODE_HEX_LINE, BOOT_MODE_BINARY, BOOT_MODE_BINARY_LZ,
+                                            BOOT_MODE_DELTA, BOOT_MODE_BINARY_SPARSE, BOOT_MODE_SEGMENTS};
+        static const char *const names[] = {"binary", "hex line", "binary", "binary lz", "delta", "sparse", "segments"};
+        boot_mode_t mode = modes[args->mode];
+
+        /* the host sends the list, the image stays for the check */
+        if (args->mode == BOOT_SIM_SEGMENTS)
+        {
+            image = boot_sim_list;
+            size = boot_sim_list_size;
+        }
+
+        if (args->interrupt)
+        {
+            st = host_boot_download(&link, image, size, boot_sim_base, boot_sim_base_size, mode,
+                                    (uint8_t)args->boot_window, args->interrupt, &boot_report);
+            printf("%-10s dropped after %lu bytes, %.3f s: %s\r\n", "", (unsigned long)args->interrupt,
+                   (double)boot_report.elapsed_us / 1e6, (st == 1) ? "target reset" : "ran to the end");
+
+            /* the target journals what it has and resets into BOOT MODE, the app is invalid */
+            usleep((BOOT_RESET_DELAY + 50) * 1000);
+        }
+
+        if (args->power_cut)
+        {
+            /* the target loses the session at the cut, its blocks are refused from then on */
+            st = host_boot_download(&link, image, size, boot_sim_base, boot_sim_base_size, mode,
+                                    (uint8_t)args->boot_window, 0, &boot_report);
+            printf("%-10s power cut after %lu erases: %s\r\n", "", (unsigned long)args->power_cut,
+                   (st == 0) ? "ran to the end" : "target reset");
+        }
+
+        st = host_boot_download(&link, image, size, boot_sim_base, boot_sim_base_size, mode,
+                                (uint8_t)args->boot_window, 0, &boot_report);
+        host_boot_print_report(names[args->mode], &boot_report);
+
+        /* the target hands off to the app or resets meanwhile */
+        usleep((BOOT_RESET_DELAY + 50) * 1000);
+    }
+
+    host_link_close(&link);
+    return (st == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Segment mode: the pages with data hold the image, 0xFF padded,
+ *        the others what was there before the run
+ */
+static int boot_sim_verify_segments(const uint8_t *image, uint32_t size)
+{
+    const uint8_t *flash = flash_driver_map(BOOT_APP_START_ADDR);
+    uint32_t kept = 0;
+    uint32_t n = 0;
+    int st = 0;
+
+    for (uint32_t page = 0; page < size; page += FLASH_DRV_PAGE_SIZE)
+    {
+        while (n < boot_sim_seg_count && boot_sim_segs[n].address + boot_sim_segs[n].len <= BOOT_APP_START_ADDR + page)
+            n++;
+
+        uint8_t touched = n < boot_sim_seg_count && boot_sim_segs[n].address < BOOT_APP_START_ADDR + page + FLASH_DRV_PAGE_SIZE;
+        const uint8_t *expected = touched ? &image[page] : &boot_sim_before[page];
+
+        if (memcmp(&flash[page], expected, FLASH_DRV_PAGE_SIZE) != 0)
+            st = -1;
+        kept += !touched;
+    }
+
+    printf("boot sim : %lu segments, %lu pages between them left as they were\r\n", (unsigned long)boot_sim_seg_count,
+           (unsigned long)kept);
+    return st;
+}
+
+/**
+ * @brief Bit exact check of the programmed user app
+ */
+static int boot_sim_verify(const uint8_t *image, uint32_t size)
+{
+    flash_sim_stats_t stats;
+    int st = (size <= BOOT_APP_MAX_SIZE && memcmp(flash_driver_map(BOOT_APP_START_ADDR), image, size) == 0) ? 0 : -1;
+
+    if (boot_sim_seg_count)
+        st = boot_sim_verify_segments(image, size);
+
+    flash_sim_get_stats(&stats);
+    printf("boot sim : flash %s, %lu pages erased, %lu half-words programmed, %.3f s busy, %lu resets\r\n",
+           (st == 0) ? "matches image" : "DIFFERS from image", (unsigned long)stats.pages_erased,
+           (unsigned long)stats.halfwords_programmed, (double)stats.busy_us / 1e6, (unsigned long)boot_sim_resets);
+
+    /* boot check of the last target reset */
+    static const char *const app_status[] = {"missing", "CORRUPT", "valid", "INCOMPATIBLE"};
+    printf("boot sim : app %s, generation %lu, %s, %s\r\n", app_status[boot_app.status],
+           (unsigned long)boot_app.meta.generation, boot_app.scanned ? "image scanned" : "record verified",
+           boot_sim_app_ready ? "fast path to the app" : "BOOT MODE");
+
+    return st;
+}
+
+/**
+ * @brief Target reset sequence, peripherals come back to their reset state
+ */
+static void boot_sim_target_init(const boot_sim_args_t *args)
+{
+    memset(&uart1, 0, sizeof(uart1));
+    memset(&uart2, 0, sizeof(uart2));
+    uart1.handle.Instance = USART1;
+    uart2.handle.Instance = USART2;
+
+    uart_init_it(&uart1, uart1_rx_buff, UART1_RX_DATA_BUFF_SIZE, uart1_tx_buff, UART1_TX_DATA_BUFF_SIZE);
+    uart_init_it(&uart2, uart2_rx_buff, UART2_RX_DATA_BUFF_SIZE, uart2_tx_buff, UART2_TX_DATA_BUFF_SIZE);
+    uart_rx_stash_init(&uart2, uart2_rx_stash, UART2_RX_STASH_SIZE);
+
+    if (args->xonxoff)
+        uart_flow_control_init(&uart2, 1, UART2_RX_DATA_BUFF_SIZE / 4, (UART2_RX_DATA_BUFF_SIZE * 3) / 4);
+
+    /* main() would jump to the app here, the sim stays in BOOT MODE */
+    if (args->mode != BOOT_SIM_LOOPBACK)
+    {
+        boot_sim_app_ready = bootloader_app_ready();
+        bootloader_init();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static boot_sim_args_t args = {
+        .mode = BOOT_SIM_LOOPBACK,
+        .image_file = NULL,
+        .link = {.baud = 115200, .latency_us = 0, .bit_error_rate = 0.0},
+        .bytes = 64 * 1024,
+        .window = UART2_RX_DATA_BUFF_SIZE,
+        .min_boot = BOOT_VERSION,
+        .xonxoff = 0,
+        .external = 0};
+    static char device[64];
+    static uint8_t *image;
+    static uint32_t size;
+    static pid_t host = -1;
+
+    if (boot_sim_parse_args(argc, argv, &args) != 0)
+        return EXIT_FAILURE;
+
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (args.mode != BOOT_SIM_LOOPBACK)
+    {
+        image = boot_sim_load_image(&args, &size);
+        if (image != NULL && args.mode == BOOT_SIM_SEGMENTS)
+            image = boot_sim_pack_segments(image, &size);
+        if (image == NULL)
+        {
+            perror("image");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* uart1: debug port on stdout, uart2: link to the gateway */
+    uart_sim_attach_stdout(USART1);
+    if (uart_sim_attach_pty(USART2, &args.link, device, sizeof(device)) != 0)
+    {
+        perror("pty");
+        return EXIT_FAILURE;
+    }
+
+    /* same flash timings as flash_sim.c, rx path placement from boot_config.h */
+    flash_sim_cfg_t flash_cfg = {.page_erase_us = 30000, .halfword_prog_us = 53, .rx_from_ram = !BOOT_FLASH_STALLS_RX};
+    flash_sim_init(&flash_cfg);
+    boot_sim_preload_flash(&args, image, size);
+    memcpy(boot_sim_before, flash_driver_map(BOOT_APP_START_ADDR), sizeof(boot_sim_before));
+    if (args.power_cut)
+        flash_sim_power_cut(args.power_cut, NVIC_SystemReset);
+
+    printf("boot sim : link on %s, %lu baud, %lu us latency, ber %g\r\n", device,
+           (unsigned long)args.link.baud, (unsigned long)args.link.latency_us, args.link.bit_error_rate);
+
+    if (!args.external)
+    {
+        host = fork();
+        if (host == 0)
+            _exit(host_process(device, &args, image, size));
+    }
+
+    /* NVIC_SystemReset() lands here */
+    setjmp(boot_sim_reset);
+    boot_sim_target_init(&args);
+
+    while (1)
+    {
+        uart_sim_poll();
+        hal_sim_poll();
+
+        if (args.mode == BOOT_SIM_LOOPBACK)
+            target_loopback_exec(&uart2);
+        else
+        {
+            bootloader_exec();
+
+            /* main() tears down and jumps, the sim resets into the fast path */
+            if (bootloader_handoff_due())
+            {
+                /* HAL tick lags behind the flash stalls here, no latency figure */
+                printf("boot sim : app handoff after DOWNLOAD_FINISHED, frames truncated %lu, crc errors %lu, replies dropped %lu\r\n",
+                       (unsigned long)boot_fsm.iface.parser.truncated, (unsigned long)boot_fsm.iface.parser.crc_errors,
+                       (unsigned long)boot_fsm.iface.replies_dropped);
+                boot_app_handoff(&boot_app, boot_fsm.iface.finished_us);
+            }
+        }
+
+        int status;
+        if (host > 0 && waitpid(host, &status, WNOHANG) == host)
+        {
+            uart_sim_stats_t stats;
+            uint32_t stash_overruns = boot_sim_stash_overruns + uart2.data.rx.stash_overruns;
+
+            uart_sim_get_stats(USART2, &stats);
+            printf("boot sim : rx %lu tx %lu bit errors %lu overruns %lu stash overruns %lu\r\n",
+                   (unsigned long)stats.rx_bytes, (unsigned long)stats.tx_bytes,
+                   (unsigned long)stats.bit_errors, (unsigned long)stats.overruns,
+                   (unsigned long)stash_overruns);
+
+            /* the stash covers an erase up to 230400 baud, past that bytes go missing behind crc errors */
+            if (stash_overruns)
+                printf("boot sim : LINK BYTES LOST, the rx stash dropped %lu bytes during flash stalls\r\n",
+                       (unsigned long)stash_overruns);
+
+            int st = WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+
+            if (args.mode != BOOT_SIM_LOOPBACK && boot_sim_verify(image, size) != 0)
+                st = EXIT_FAILURE;
+
+            return st;
+        }
+    }
+}
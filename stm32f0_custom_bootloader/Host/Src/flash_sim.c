@@ -0,0 +1,130 @@
+/**
+ * @file flash_sim.c
+ * @brief Host emulation of the STM32F030xC internal flash behind flash_driver.h
+ *
+ * @note  Replaces Core/Src/API/flash_driver.c in the host build. Contents
+ *        survive NVIC_SystemReset(), erase/program times stall the cpu the
+ *        way code executing from flash is stalled on the target, only the
+ *        SRAM rx path runs meanwhile when rx_from_ram is set.
+ */
+
+#include <string.h>
+#include "flash_driver.h"
+#include "flash_sim.h"
+#include "uart_sim.h"
+
+static uint8_t flash_sim_mem[FLASH_DRV_SIZE] __attribute__((aligned(4)));
+static flash_sim_cfg_t flash_sim_cfg = {.page_erase_us = 30000, .halfword_prog_us = 53};
+static flash_sim_stats_t flash_sim_stats;
+static uint32_t flash_sim_cut_erases;
+static void (*flash_sim_cut)(void);
+
+void flash_sim_init(const flash_sim_cfg_t *cfg)
+{
+    memset(flash_sim_mem, 0xFF, sizeof(flash_sim_mem));
+    memset(&flash_sim_stats, 0, sizeof(flash_sim_stats));
+
+    if (cfg != NULL)
+        flash_sim_cfg = *cfg;
+}
+
+void flash_sim_get_stats(flash_sim_stats_t *stats)
+{
+    *stats = flash_sim_stats;
+}
+
+void flash_sim_load(uint32_t address, const uint8_t *data, uint32_t len)
+{
+    memcpy(&flash_sim_mem[address - FLASH_DRV_BASE_ADDR], data, len);
+}
+
+void flash_sim_power_cut(uint32_t erases, void (*cut)(void))
+{
+    flash_sim_cut_erases = erases;
+    flash_sim_cut = cut;
+}
+
+static uint8_t flash_sim_in_range(uint32_t address, uint32_t len)
+{
+    return (address >= FLASH_DRV_BASE_ADDR) && (address + len <= FLASH_DRV_END_ADDR) && (address + len >= address);
+}
+
+static void flash_sim_busy(uint32_t us)
+{
+    flash_sim_stats.busy_us += us;
+
+    if (flash_sim_cfg.rx_from_ram)
+        uart_sim_busy(us);
+    else
+        uart_sim_stall(us);
+}
+
+flash_drv_st_t flash_driver_erase(uint32_t address, uint32_t pages)
+{
+    if ((address % FLASH_DRV_PAGE_SIZE) != 0 || !flash_sim_in_range(address, pages * FLASH_DRV_PAGE_SIZE))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    memset(&flash_sim_mem[address - FLASH_DRV_BASE_ADDR], 0xFF, pages * FLASH_DRV_PAGE_SIZE);
+    flash_sim_stats.pages_erased += pages;
+    flash_sim_busy(pages * flash_sim_cfg.page_erase_us);
+
+    /* page blank, nothing programmed yet: the worst moment for an in-place update */
+    if (flash_sim_cut_erases)
+    {
+        flash_sim_cut_erases = (pages < flash_sim_cut_erases) ? flash_sim_cut_erases - pages : 0;
+        if (flash_sim_cut_erases == 0)
+            flash_sim_cut();
+    }
+
+    return FLASH_DRV_OK;
+}
+
+flash_drv_st_t flash_driver_erase_start(uint32_t address)
+{
+    /* the driver waits for the erase in SRAM */
+    return flash_driver_erase(address, 1);
+}
+
+flash_drv_st_t flash_driver_poll(void)
+{
+    return FLASH_DRV_OK;
+}
+
+flash_drv_st_t flash_driver_program(uint32_t address, const uint8_t *data, uint32_t len)
+{
+    flash_drv_st_t status = FLASH_DRV_OK;
+    uint32_t i;
+
+    if ((address & 1U) || (len & 1U) || !flash_sim_in_range(address, len))
+        return FLASH_DRV_BAD_ADDRESS;
+
+    uint8_t *dst = &flash_sim_mem[address - FLASH_DRV_BASE_ADDR];
+
+    for (i = 0; i < len; i += 2)
+    {
+        /* PGERR unless the target half-word reads erased (0x0000 is allowed too) */
+        uint16_t value = (uint16_t)data[i] | ((uint16_t)data[i + 1] << 8);
+        uint16_t old = (uint16_t)dst[i] | ((uint16_t)dst[i + 1] << 8);
+
+        if (old != FLASH_DRV_ERASED_HALFWORD && value != 0x0000)
+        {
+            flash_sim_stats.program_errors++;
+            status = FLASH_DRV_ERROR;
+            break;
+        }
+
+        dst[i] = (uint8_t)value;
+        dst[i + 1] = (uint8_t)(value >> 8);
+
+        /* the cpu stalls per half-word, pending interrupts run in between */
+        flash_sim_stats.halfwords_programmed++;
+        flash_sim_busy(flash_sim_cfg.halfword_prog_us);
+    }
+
+    return status;
+}
+
+const uint8_t *flash_driver_map(uint32_t address)
+{
+    return &flash_sim_mem[address - FLASH_DRV_BASE_ADDR];
+}
@@ -0,0 +1,56 @@
+/**
+ * @file hal_sim.c
+ * @brief Host emulation of the HAL time base (HAL_GetTick / SysTick).
+ */
+
+#include <time.h>
+#include "uart_sim.h"
+
+static volatile uint32_t uwTick;
+static uint64_t next_tick_us;
+
+uint64_t hal_sim_time_us(void)
+{
+    static uint64_t start_us;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+
+    if (start_us == 0)
+        start_us = now;
+
+    return now - start_us;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return uwTick;
+}
+
+void HAL_IncTick(void)
+{
+    uwTick++;
+}
+
+/**
+ * @brief Default SysTick hook, overridden by the module under test
+ */
+__attribute__((weak)) void HAL_SYSTICK_Callback(void)
+{
+}
+
+/**
+ * @brief Emulate the SysTick handler, one call per elapsed millisecond
+ */
+void hal_sim_poll(void)
+{
+    uint64_t now = hal_sim_time_us();
+
+    while (next_tick_us <= now)
+    {
+        next_tick_us += 1000;
+        HAL_SYSTICK_Callback();
+        HAL_IncTick();
+    }
+}
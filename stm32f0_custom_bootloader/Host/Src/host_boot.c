@@ -0,0 +1,648 @@
+/**
+ * @file host_boot.c
+ * @brief Gateway side of the bootloader download, drives boot_fsm over a host_link
+ *
+ * @note  Control requests and hex lines are stop and wait: a timeout or a crc
+ *        NACK sends the same frame again with the same seq, the target
+ *        confirms a repeated frame without writing it twice. Binary blocks
+ *        use the window the target advertises at BOOT_START_DOWNLOAD, and
+ *        start at the resume offset of its reply. In BOOT_MODE_BINARY_LZ the
+ *        blocks carry the compressed image (host_lz.h), addressed by their
+ *        offset in the stream, in BOOT_MODE_DELTA a patch (host_delta.h).
+ *        BOOT_MODE_BINARY_SPARSE leaves out the blocks, one page each, whose
+ *        crc matches the manifest of the flash.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_boot.h"
+#include "boot_config.h"
+#include "boot_window.h"
+#include "crc32.h"
+#include "host_lz.h"
+#include "host_delta.h"
+#include "host_seg.h"
+#include "boot_image.h"
+#include "uart_sim.h"
+
+#define HOST_BOOT_RETRIES           (5)
+#define HOST_BOOT_REPLY_TIMEOUT_MS  (1000)
+#define HOST_BOOT_ACK_MARGIN_US     (100000)    /* target processing on top of the measured rtt */
+#define HOST_BOOT_HEX_RECORD_DATA   (16)
+#define HOST_BOOT_HEX_LINE_SIZE     (1 + 2 * (4 + HOST_BOOT_HEX_RECORD_DATA + 1))
+
+/* a request and its retries end before the target gives the download up */
+_Static_assert((HOST_BOOT_RETRIES + 1) * HOST_BOOT_REPLY_TIMEOUT_MS < BOOT_BLOCK_TIMEOUT,
+               "DOWNLOAD_FINISHED retries have to reach the download");
+
+typedef struct
+{
+    uint64_t deadline_us;       /* retransmit if not acked by then */
+    uint8_t acked;
+} host_boot_block_t;
+
+typedef struct
+{
+    host_link_t *link;
+    uint64_t rto_us;            /* ack timeout after the block left the host uart */
+    boot_frame_parser_t parser;
+    uint16_t seq;
+    uint8_t frame[BOOT_FRAME_MAX_SIZE];
+    host_boot_report_t *report;
+} host_boot_t;
+
+/**
+ * @brief Send a request and wait for its reply
+ * @return int reply status, -1 if the target never answered
+ */
+static int host_boot_request(host_boot_t *hb, uint8_t cmd, const uint8_t *payload, uint16_t len, int timeout_ms)
+{
+    uint16_t seq = ++hb->seq;
+    uint16_t size = boot_frame_encode(hb->frame, cmd, seq, payload, len);
+    uint8_t chunk[256];
+
+    /* frame on the wire and its reply, on top of the target processing time */
+    timeout_ms += (int)(2 * (uint64_t)(size + BOOT_FRAME_OVERHEAD + BOOT_REPLY_MAX_PAYLOAD) *
+                        uart_sim_byte_time_us(hb->link->baud) / 1000);
+
+    for (int attempt = 0; attempt <= HOST_BOOT_RETRIES; attempt++)
+    {
+        /* a reply that lost bytes would take the next one as its rest */
+        if (attempt)
+        {
+            hb->report->retries++;
+            boot_frame_parser_idle(&hb->parser);
+        }
+
+        for (uint32_t sent = 0; sent < size;)
+        {
+            sent += host_link_write(hb->link, &hb->frame[sent], size - sent);
+            if (host_link_service(hb->link) != 0)
+                return -1;
+        }
+        hb->report->wire_bytes += size;
+
+        uint64_t deadline = hal_sim_time_us() + (uint64_t)timeout_ms * 1000ULL;
+        int nack = 0;
+
+        while (!nack && hal_sim_time_us() < deadline)
+        {
+            int n = host_link_read(hb->link, chunk, sizeof(chunk), (int)((deadline - hal_sim_time_us()) / 1000) + 1);
+            if (n < 0)
+                return -1;
+
+            for (int i = 0; i < n; i++)
+            {
+                if (boot_frame_parse(&hb->parser, chunk[i]) != BOOT_PARSE_FRAME)
+                    continue;
+
+                boot_frame_t *reply = &hb->parser.frame;
+                if (reply->cmd != (cmd | BOOT_CMD_REPLY) || reply->seq != seq || reply->len == 0)
+                {
+                    /* crc NACK of a frame whose header got hit, or a late reply */
+                    if (reply->cmd & BOOT_CMD_REPLY && reply->len && reply->payload[0] == BOOT_ST_ERR_CRC)
+                        nack = 1;
+                    continue;
+                }
+
+                if (reply->payload[0] == BOOT_ST_ERR_CRC)
+                {
+                    nack = 1;
+                    break;
+                }
+
+                hb->report->frames++;
+                return reply->payload[0];
+            }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Intel HEX record, as the legacy gateway sends it
+ */
+static uint16_t host_boot_hex_record(char *line, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t len)
+{
+    uint8_t sum = (uint8_t)(len + (offset >> 8) + offset + type);
+    int n = sprintf(line, ":%02X%04X%02X", len, offset, type);
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        n += sprintf(&line[n], "%02X", data[i]);
+        sum += data[i];
+    }
+
+    n += sprintf(&line[n], "%02X", (uint8_t)(0x100 - sum));
+    return (uint16_t)n;
+}
+
+static int host_boot_send_hex(host_boot_t *hb, const uint8_t *image, uint32_t size)
+{
+    char line[HOST_BOOT_HEX_LINE_SIZE + 1];
+    uint32_t upper = 0xFFFFFFFFUL;
+
+    for (uint32_t off = 0; off < size; off += HOST_BOOT_HEX_RECORD_DATA)
+    {
+        uint32_t address = BOOT_APP_START_ADDR + off;
+        uint8_t len = (size - off > HOST_BOOT_HEX_RECORD_DATA) ? HOST_BOOT_HEX_RECORD_DATA : (uint8_t)(size - off);
+        uint16_t n;
+
+        if ((address >> 16) != upper)
+        {
+            uint8_t ela[2] = {(uint8_t)(address >> 24), (uint8_t)(address >> 16)};
+            upper = address >> 16;
+            n = host_boot_hex_record(line, 0x04, 0, ela, 2);
+            if (host_boot_request(hb, BOOT_CMD_DOWNLOAD_LINE, (uint8_t *)line, n, HOST_BOOT_REPLY_TIMEOUT_MS) != BOOT_ST_OK)
+                return -1;
+        }
+
+        n = host_boot_hex_record(line, 0x00, (uint16_t)address, &image[off], len);
+        if (host_boot_request(hb, BOOT_CMD_DOWNLOAD_LINE, (uint8_t *)line, n, HOST_BOOT_REPLY_TIMEOUT_MS) != BOOT_ST_OK)
+            return -1;
+    }
+
+    uint16_t n = host_boot_hex_record(line, 0x01, 0, NULL, 0);
+    return (host_boot_request(hb, BOOT_CMD_DOWNLOAD_LINE, (uint8_t *)line, n, HOST_BOOT_REPLY_TIMEOUT_MS) == BOOT_ST_OK) ? 0 : -1;
+}
+
+/**
+ * @brief Apply an ack to the blocks in flight, a NACK (BOOT_ST_ERR_CRC)
+ *        also names one to send again
+ * @return int -1 if the target reported an error
+ */
+static int host_boot_window_ack(host_boot_t *hb, host_boot_block_t *blocks, uint32_t count, uint16_t first_seq,
+                                uint32_t *base, uint32_t *limit)
+{
+    boot_frame_t *reply = &hb->parser.frame;
+
+    /* the target reset meanwhile, no download to ack any more */
+    if (reply->len >= 1 && reply->len < 1 + BOOT_WINDOW_ACK_SIZE && reply->payload[0] == BOOT_ST_ERR_STATE)
+    {
+        fprintf(stderr, "host boot : download session lost\r\n");
+        return -1;
+    }
+
+    if (reply->len < 1 + BOOT_WINDOW_ACK_SIZE)
+        return 0;
+
+    uint8_t status = reply->payload[0];
+    uint32_t nacked = (uint16_t)(reply->seq - first_seq);
+
+    /* that block arrived corrupted, send it again now rather than on its timeout; a NACK of a
+       retransmit already acked or of a seq outside this download only carries the ack */
+    if (status == BOOT_ST_ERR_CRC)
+    {
+        if (nacked < count && !blocks[nacked].acked)
+            blocks[nacked].deadline_us = 0;
+    }
+    else if (status != BOOT_ST_OK && status != BOOT_ST_ERR_SEQUENCE)
+    {
+        fprintf(stderr, "host boot : block ack status %u\r\n", status);
+        return -1;
+    }
+
+    uint32_t next = (uint16_t)(boot_get_u16(&reply->payload[1]) - first_seq);
+    uint16_t sack = boot_get_u16(&reply->payload[3]);
+    uint8_t window = reply->payload[5];
+
+    /* stale ack from before a wrap of the 16 bit seq, ignore */
+    if (next > count)
+        return 0;
+
+    for (uint32_t i = *base; i < next; i++)
+        blocks[i].acked = 1;
+    for (uint32_t i = 0; i < 16 && next + 1 + i < count; i++)
+    {
+        if (sack & (1U << i))
+            blocks[next + 1 + i].acked = 1;
+    }
+
+    if (next > *base)
+        *base = next;
+    if (next + window > *limit)
+        *limit = next + window;
+
+    return 0;
+}
+
+/**
+ * @brief Page crcs of the app area, send[n] is set for the pages of the
+ *        image that differ, the last one padded with 0xFF like the writer
+ * @return int the pages that differ, -1 if the manifest did not come
+ */
+static int host_boot_manifest(host_boot_t *hb, const uint8_t *image, uint32_t size, uint8_t *send)
+{
+    uint32_t pages = (size + FLASH_DRV_PAGE_SIZE - 1) / FLASH_DRV_PAGE_SIZE;
+    uint8_t page[FLASH_DRV_PAGE_SIZE];
+    uint8_t payload[3];
+    int differ = 0;
+
+    for (uint32_t n = 0; n < pages;)
+    {
+        boot_put_u16(payload, (uint16_t)n);
+        payload[2] = (uint8_t)((pages - n > BOOT_MANIFEST_MAX_PAGES) ? BOOT_MANIFEST_MAX_PAGES : pages - n);
+
+        if (host_boot_request(hb, BOOT_CMD_GET_MANIFEST, payload, sizeof(payload), HOST_BOOT_REPLY_TIMEOUT_MS) != BOOT_ST_OK)
+            return -1;
+
+        boot_frame_t *reply = &hb->parser.frame;
+        uint32_t got = (reply->len > 1 + BOOT_MANIFEST_HEADER_SIZE) ? (reply->len - 1 - BOOT_MANIFEST_HEADER_SIZE) / 4 : 0;
+
+        if (got == 0 || boot_get_u16(&reply->payload[1]) != n)
+            return -1;
+
+        for (uint32_t i = 0; i < got && n < pages; i++, n++)
+        {
+            uint32_t off = n * FLASH_DRV_PAGE_SIZE;
+            uint32_t len = (size - off > FLASH_DRV_PAGE_SIZE) ? FLASH_DRV_PAGE_SIZE : size - off;
+
+            memset(page, 0xFF, sizeof(page));
+            memcpy(page, &image[off], len);
+
+            send[n] = crc32_compute(page, sizeof(page)) !=
+                      boot_get_u32(&reply->payload[1 + BOOT_MANIFEST_HEADER_SIZE + 4 * i]);
+            differ += send[n];
+        }
+    }
+
+    return differ;
+}
+
+/**
+ * @brief Sliding window: up to the advertised number of blocks in flight,
+ *        cumulative and selective acks, timeout driven retransmission.
+ *        Blocks start at image offset from, the first seq after the start,
+ *        a block address is origin + its offset. With send, only the blocks
+ *        it flags go, their seqs still consecutive.
+ * @return int 1 once the blocks before cut are acked, cut 0 never stops
+ */
+static int host_boot_send_blocks(host_boot_t *hb, const uint8_t *image, uint32_t size, uint32_t origin,
+                                 uint8_t window, uint32_t from, uint32_t cut, const uint8_t *send)
+{
+    uint8_t payload[BOOT_FRAME_MAX_PAYLOAD];
+    uint8_t chunk[256];
+    uint32_t count = 0;
+    uint16_t first_seq = (uint16_t)(hb->seq + 1);
+    uint32_t byte_time = uart_sim_byte_time_us(hb->link->baud);
+    uint32_t base = 0;          /* oldest block not acked cumulatively */
+    uint32_t sent = 0;          /* blocks sent at least once */
+    uint32_t limit = window;    /* target accepts blocks before this one */
+    uint64_t wire_end = 0;      /* estimated time the host uart drains what was queued */
+    uint64_t heard = hal_sim_time_us();     /* last block reply */
+
+    uint32_t *offsets = malloc(((size - from) / BOOT_BLOCK_MAX_DATA + 1) * sizeof(uint32_t));
+    host_boot_block_t *blocks = calloc((size - from) / BOOT_BLOCK_MAX_DATA + 1, sizeof(host_boot_block_t));
+    if (blocks == NULL || offsets == NULL)
+    {
+        free(offsets);
+        free(blocks);
+        return -1;
+    }
+
+    for (uint32_t off = from; off < size; off += BOOT_BLOCK_MAX_DATA)
+    {
+        if (send == NULL || send[off / BOOT_BLOCK_MAX_DATA])
+            offsets[count++] = off;
+    }
+
+    hb->seq = (uint16_t)(first_seq + count - 1);
+
+    while (base < count)
+    {
+        uint64_t now = hal_sim_time_us();
+
+        if (cut && offsets[base] >= cut)
+        {
+            free(offsets);
+            free(blocks);
+            return 1;
+        }
+
+        /* retransmissions and probes got no reply for as long as a request gets its retries */
+        if (now - heard > (uint64_t)(HOST_BOOT_RETRIES + 1) * HOST_BOOT_REPLY_TIMEOUT_MS * 1000ULL)
+        {
+            fprintf(stderr, "host boot : no block reply, link lost\r\n");
+            free(offsets);
+            free(blocks);
+            return -1;
+        }
+
+        /* retransmit what timed out, then fill the window with new blocks */
+        for (uint32_t i = base; i < count && i < limit && i < base + window; i++)
+        {
+            host_boot_block_t *block = &blocks[i];
+
+            if (block->acked || (i < sent && now < block->deadline_us))
+                continue;
+
+            uint32_t off = offsets[i];
+            uint32_t len = (size - off > BOOT_BLOCK_MAX_DATA) ? BOOT_BLOCK_MAX_DATA : size - off;
+
+            boot_put_u32(payload, origin + off);
+            memcpy(&payload[BOOT_BLOCK_ADDR_SIZE], &image[off], len);
+            uint16_t frame_len = boot_frame_encode(hb->frame, BOOT_CMD_DOWNLOAD_BLOCK, (uint16_t)(first_seq + i),
+                                                   payload, (uint16_t)(BOOT_BLOCK_ADDR_SIZE + len));
+
+            if (host_link_write_room(hb->link) < frame_len)
+                break;
+
+            host_link_write(hb->link, hb->frame, frame_len);
+            hb->report->wire_bytes += frame_len;
+
+            if (i < sent)
+                hb->report->retries++;
+            else
+                sent = i + 1;
+
+            wire_end = ((wire_end > now) ? wire_end : now) + (uint64_t)frame_len * byte_time;
+            block->deadline_us = wire_end + hb->rto_us;
+        }
+
+        /* nothing in flight and the window is closed: an empty block asks for the window */
+        if (sent == base && base < count && base >= limit && now > wire_end + hb->rto_us)
+        {
+            uint16_t frame_len = boot_frame_encode(hb->frame, BOOT_CMD_DOWNLOAD_BLOCK, (uint16_t)(first_seq + base), NULL, 0);
+
+            host_link_write(hb->link, hb->frame, frame_len);
+            hb->report->wire_bytes += frame_len;
+            wire_end = now + (uint64_t)frame_len * byte_time;
+            continue;
+        }
+
+        int n = host_link_read(hb->link, chunk, sizeof(chunk), 1);
+        if (n < 0)
+        {
+            fprintf(stderr, "host boot : link lost\r\n");
+            free(offsets);
+            free(blocks);
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            if (boot_frame_parse(&hb->parser, chunk[i]) != BOOT_PARSE_FRAME)
+                continue;
+
+            if (hb->parser.frame.cmd != (BOOT_CMD_DOWNLOAD_BLOCK | BOOT_CMD_REPLY))
+                continue;
+
+            hb->report->frames++;
+            heard = hal_sim_time_us();
+            if (host_boot_window_ack(hb, blocks, count, first_seq, &base, &limit) != 0)
+            {
+                free(offsets);
+                free(blocks);
+                return -1;
+            }
+        }
+
+        /* skip blocks acked selectively */
+        while (base < count && blocks[base].acked)
+            base++;
+    }
+
+    free(offsets);
+    free(blocks);
+    return 0;
+}
+
+static uint32_t host_boot_hex_lines(uint32_t size)
+{
+    uint32_t records = (size + HOST_BOOT_HEX_RECORD_DATA - 1) / HOST_BOOT_HEX_RECORD_DATA;
+    uint32_t first = BOOT_APP_START_ADDR >> 16;
+    uint32_t last = (BOOT_APP_START_ADDR + (size ? size - 1 : 0)) >> 16;
+
+    /* data records, extended linear address records, end of file */
+    return records + (last - first + 1) + 1;
+}
+
+int host_boot_download(host_link_t *link, const uint8_t *image, uint32_t size, const uint8_t *base, uint32_t base_size,
+                       boot_mode_t mode, uint8_t window, uint32_t cut, host_boot_report_t *report)
+{
+    static host_boot_t hb;
+    uint8_t payload[21];
+    uint8_t *stream = NULL;
+    uint32_t *pages = NULL;
+    uint8_t *send = NULL;
+    int status;
+
+    memset(report, 0, sizeof(host_boot_report_t));
+    memset(&hb, 0, sizeof(hb));
+    hb.link = link;
+    hb.report = report;
+    boot_frame_parser_init(&hb.parser);
+
+    report->image_bytes = size;
+    report->baud = link->baud;
+    report->status = 0xFF;
+
+    /*ENTER_BOOT_MODE, its round trip sets the ack timeout*/
+    uint64_t rtt = hal_sim_time_us();
+    if (host_boot_request(&hb, BOOT_CMD_ENTER_BOOT, NULL, 0, HOST_BOOT_REPLY_TIMEOUT_MS) != BOOT_ST_OK)
+    {
+        fprintf(stderr, "host boot : no ENTER_BOOT_OK\r\n");
+        return -1;
+    }
+    rtt = hal_sim_time_us() - rtt;
+    hb.rto_us = 2 * rtt + HOST_BOOT_ACK_MARGIN_US;
+
+    /*the image header tells before anything is erased if the image runs on that bootloader*/
+    if (hb.parser.frame.len >= 1 + BOOT_ENTER_REPLY_SIZE)
+        report->boot_version = boot_get_u32(&hb.parser.frame.payload[1]);
+
+    const boot_image_header_t *header = (mode != BOOT_MODE_SEGMENTS) ? boot_image_find(image, size) : NULL;
+    if (header != NULL && report->boot_version != 0 && header->min_boot_version > report->boot_version)
+    {
+        fprintf(stderr, "host boot : image needs bootloader 0x%06lx, target has 0x%06lx\r\n",
+                (unsigned long)header->min_boot_version, (unsigned long)report->boot_version);
+        report->status = BOOT_ST_ERR_VERSION;
+        return -1;
+    }
+
+    /*compressed blocks, the size and the crc stay those of the image*/
+    report->stream_bytes = size;
+    if (mode == BOOT_MODE_BINARY_LZ)
+    {
+        stream = malloc(HOST_LZ_BOUND(size));
+        report->stream_bytes = (stream != NULL) ? host_lz_compress(image, size, stream) : 0;
+        if (report->stream_bytes == 0)
+        {
+            free(stream);
+            return -1;
+        }
+    }
+    else if (mode == BOOT_MODE_BINARY_SPARSE)
+    {
+        /*GET_MANIFEST, only the pages the flash does not hold yet*/
+        report->pages_total = (size + FLASH_DRV_PAGE_SIZE - 1) / FLASH_DRV_PAGE_SIZE;
+        send = malloc(report->pages_total + 1);
+        status = (send != NULL) ? host_boot_manifest(&hb, image, size, send) : -1;
+        if (status < 0)
+        {
+            fprintf(stderr, "host boot : no manifest\r\n");
+            free(send);
+            return -1;
+        }
+
+        report->pages_differ = (uint32_t)status;
+        report->stream_bytes = 0;
+        for (uint32_t n = 0; n < report->pages_total; n++)
+        {
+            if (send[n])
+                report->stream_bytes += (size - n * FLASH_DRV_PAGE_SIZE > FLASH_DRV_PAGE_SIZE) ? FLASH_DRV_PAGE_SIZE
+                                                                                            : size - n * FLASH_DRV_PAGE_SIZE;
+        }
+    }
+    else if (mode == BOOT_MODE_DELTA)
+    {
+        /*where each page starts in the patch, the target resumes at one*/
+        stream = malloc(HOST_DELTA_BOUND(size));
+        pages = malloc(((size + FLASH_DRV_PAGE_SIZE - 1) / FLASH_DRV_PAGE_SIZE + 1) * sizeof(uint32_t));
+        report->base_bytes = base_size;
+        report->stream_bytes = (stream != NULL && pages != NULL && size != 0)
+                                   ? host_delta_encode(base, base_size, image, size, stream, pages)
+                                   : 0;
+        if (report->stream_bytes == 0)
+        {
+            free(stream);
+            free(pages);
+            return -1;
+        }
+    }
+    else if (mode == BOOT_MODE_SEGMENTS)
+    {
+        /*the list goes as it is, the size announced is its span*/
+        report->image_bytes = host_seg_span(image, size);
+        report->segments = (report->image_bytes != 0) ? boot_get_u32(&image[4]) : 0;
+        if (report->image_bytes == 0)
+            return -1;
+    }
+
+    uint32_t count = (mode == BOOT_MODE_HEX_LINE) ? host_boot_hex_lines(size)
+                                                  : (report->stream_bytes + BOOT_BLOCK_MAX_DATA - 1) / BOOT_BLOCK_MAX_DATA;
+    payload[0] = (uint8_t)mode;
+    boot_put_u32(&payload[1], count);
+    boot_put_u32(&payload[5], report->image_bytes);
+    boot_put_u32(&payload[9], crc32_compute(image, size));
+    boot_put_u32(&payload[13], base_size);
+    boot_put_u32(&payload[17], (mode == BOOT_MODE_DELTA) ? crc32_compute(base, base_size) : 0);
+
+    uint16_t start_len = (mode == BOOT_MODE_DELTA) ? 21 : (mode == BOOT_MODE_BINARY || mode == BOOT_MODE_BINARY_SPARSE) ? 13 : 9;
+    uint64_t start = hal_sim_time_us();
+
+    /*BOOT_START_DOWNLOAD, the target erases the metadata and the first pages before replying*/
+    status = host_boot_request(&hb, BOOT_CMD_START_DOWNLOAD, payload, start_len, HOST_BOOT_REPLY_TIMEOUT_MS);
+    report->erase_us = hal_sim_time_us() - start;
+    if (status != BOOT_ST_OK)
+    {
+        fprintf(stderr, "host boot : start download status %d\r\n", status);
+        free(stream);
+        free(pages);
+        free(send);
+        return -1;
+    }
+
+    /*START_DOWNLOAD_OK: window and biggest block the target accepts, what it kept from last time*/
+    uint8_t target_window = (hb.parser.frame.len >= 2) ? hb.parser.frame.payload[1] : 1;
+    report->window = (window && window < target_window) ? window : target_window;
+
+    if (hb.parser.frame.len >= 1 + BOOT_START_REPLY_SIZE)
+        report->resumed = boot_get_u32(&hb.parser.frame.payload[4]);
+    if (report->resumed > size || (report->resumed % BOOT_BLOCK_MAX_DATA && report->resumed != size))
+        report->resumed = 0;
+
+    if (mode == BOOT_MODE_BINARY)
+    {
+        status = host_boot_send_blocks(&hb, image, size, BOOT_APP_START_ADDR, report->window, report->resumed, cut, NULL);
+    }
+    else if (mode == BOOT_MODE_BINARY_SPARSE)
+    {
+        status = host_boot_send_blocks(&hb, image, size, BOOT_APP_START_ADDR, report->window, report->resumed, cut, send);
+    }
+    else if (mode == BOOT_MODE_BINARY_LZ)
+    {
+        status = host_boot_send_blocks(&hb, stream, report->stream_bytes, 0, report->window, 0, cut, NULL);
+    }
+    else if (mode == BOOT_MODE_SEGMENTS)
+    {
+        status = host_boot_send_blocks(&hb, image, size, 0, report->window, 0, cut, NULL);
+    }
+    else if (mode == BOOT_MODE_DELTA)
+    {
+        /*the rest of the patch, from the op that starts the page the target resumes at*/
+        uint32_t from = (report->resumed == size) ? report->stream_bytes : pages[report->resumed / FLASH_DRV_PAGE_SIZE];
+        status = host_boot_send_blocks(&hb, &stream[from], report->stream_bytes - from, 0, report->window, 0, cut, NULL);
+    }
+    else
+    {
+        status = host_boot_send_hex(&hb, image, size);
+    }
+
+    free(stream);
+    free(pages);
+    free(send);
+
+    if (status == 1)
+    {
+        /*link dropped on purpose, the target journals its progress and resets*/
+        host_boot_request(&hb, BOOT_CMD_CANCEL_BOOT, NULL, 0, HOST_BOOT_REPLY_TIMEOUT_MS);
+        report->elapsed_us = hal_sim_time_us() - start;
+        return 1;
+    }
+
+    if (status != 0)
+        return -1;
+
+    /*DOWNLOAD_FINISHED, CRC SRV == CRC GW: nothing left to erase, the page crcs are combined*/
+    boot_put_u32(payload, crc32_compute(image, size));
+    status = host_boot_request(&hb, BOOT_CMD_DOWNLOAD_FINISHED, payload, 4, HOST_BOOT_REPLY_TIMEOUT_MS);
+    report->elapsed_us = hal_sim_time_us() - start;
+    report->status = (uint8_t)status;
+
+    if (hb.parser.frame.len >= 1 + BOOT_FINISHED_SUMMARY_SIZE)
+    {
+        report->pages_programmed = boot_get_u16(&hb.parser.frame.payload[1]);
+        report->pages_skipped = boot_get_u16(&hb.parser.frame.payload[3]);
+        report->erases_skipped = boot_get_u16(&hb.parser.frame.payload[5]);
+    }
+
+    return (status == BOOT_ST_OK) ? 0 : -1;
+}
+
+void host_boot_print_report(const char *name, const host_boot_report_t *report)
+{
+    double seconds = (double)report->elapsed_us / 1e6;
+    double transfer = (double)(report->elapsed_us - report->erase_us) / 1e6;
+    double rate = (transfer > 0.0) ? (report->image_bytes - report->resumed) / transfer : 0.0;
+    double line = report->baud / 10.0;
+
+    printf("%-10s %8lu bytes  %8.3f s (erase %.3f s)  %9.1f B/s", name, (unsigned long)report->image_bytes,
+           seconds, (double)report->erase_us / 1e6, rate);
+
+    if (line > 0.0)
+        printf("  %5.1f%% of line", 100.0 * rate / line);
+
+    printf("  window %u  frames %lu  retries %lu  wire %lu B  %s\r\n", report->window, (unsigned long)report->frames, (unsigned long)report->retries,
+           (unsigned long)report->wire_bytes, (report->status == BOOT_ST_OK) ? "BOOT_SUCCEED" : "BOOT_FAIL");
+    printf("%-10s pages programmed %u, identical %u, erases skipped %u\r\n", "", report->pages_programmed,
+           report->pages_skipped, report->erases_skipped);
+
+    if (report->resumed)
+        printf("%-10s resumed at %lu bytes, not sent again\r\n", "", (unsigned long)report->resumed);
+
+    if (report->pages_total)
+        printf("%-10s manifest: %lu of %lu pages differ, %lu bytes sent\r\n", "", (unsigned long)report->pages_differ,
+               (unsigned long)report->pages_total, (unsigned long)report->stream_bytes);
+    else if (report->segments)
+        printf("%-10s %lu segments, list of %lu bytes, %.1f%% of the span\r\n", "", (unsigned long)report->segments,
+               (unsigned long)report->stream_bytes, 100.0 * report->stream_bytes / report->image_bytes);
+    else if (report->base_bytes)
+        printf("%-10s patch of %lu bytes against a %lu byte base, %.1f%%\r\n", "", (unsigned long)report->stream_bytes,
+               (unsigned long)report->base_bytes, 100.0 * report->stream_bytes / report->image_bytes);
+    else if (report->stream_bytes != report->image_bytes && report->image_bytes)
+        printf("%-10s compressed to %lu bytes, %.1f%%\r\n", "", (unsigned long)report->stream_bytes,
+               100.0 * report->stream_bytes / report->image_bytes);
+}
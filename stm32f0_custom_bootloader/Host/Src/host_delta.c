@@ -0,0 +1,149 @@
+/**
+ * @file host_delta.c
+ * @brief Gateway side patch generator for BOOT_MODE_DELTA (format in boot_delta.h)
+ *
+ * @note  Greedy, page by page of the new image. At each position the copy
+ *        from the same offset, the one going on with the shift of the last
+ *        copy and the hash chain of the old image are tried, the longest
+ *        one wins. Copies only read from the page being rebuilt on, as the
+ *        target requires; data moved forward across a page boundary is
+ *        inserted again.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_delta.h"
+#include "boot_delta.h"
+#include "flash_driver.h"
+
+#define HOST_DELTA_HASH_BITS    (16)
+#define HOST_DELTA_CHAIN_DEPTH  (64)    /* candidates tried per position */
+#define HOST_DELTA_MIN_COPY     (12)    /* shorter ones cost more than the bytes, and split the insert */
+#define HOST_DELTA_KEY          (4)     /* bytes hashed */
+
+static uint32_t host_delta_hash(const uint8_t *p)
+{
+    return (boot_get_u32(p) * 2654435761U) >> (32 - HOST_DELTA_HASH_BITS);
+}
+
+static uint8_t *host_delta_insert(uint8_t *out, const uint8_t *data, uint32_t len)
+{
+    if (len == 0)
+        return out;
+
+    *out++ = BOOT_DELTA_INSERT;
+    boot_put_u16(out, (uint16_t)len);
+    memcpy(out + 2, data, len);
+
+    return out + 2 + len;
+}
+
+static uint8_t *host_delta_copy(uint8_t *out, uint32_t source, uint32_t len)
+{
+    *out++ = BOOT_DELTA_COPY;
+    boot_put_u16(out, (uint16_t)len);
+    boot_put_u32(out + 2, source);
+
+    return out + 6;
+}
+
+/** Bytes of image at d matching old at source, up to end */
+static uint32_t host_delta_match(const uint8_t *old, uint32_t old_size, const uint8_t *image, uint32_t d,
+                                 uint32_t end, uint32_t source)
+{
+    uint32_t len = 0;
+
+    while (d + len < end && source + len < old_size && old[source + len] == image[d + len])
+        len++;
+
+    return len;
+}
+
+uint32_t host_delta_encode(const uint8_t *old, uint32_t old_size, const uint8_t *image, uint32_t size, uint8_t *out,
+                           uint32_t *page_offsets)
+{
+    int32_t *head = malloc(sizeof(int32_t) << HOST_DELTA_HASH_BITS);
+    int32_t *prev = malloc(((size_t)old_size + 1) * sizeof(int32_t));
+    uint8_t *o = out;
+    int64_t shift = 0;          /* source - destination of the last copy */
+
+    if (head == NULL || prev == NULL)
+    {
+        free(head);
+        free(prev);
+        return 0;
+    }
+
+    /* ascending insertion, the chains run from the highest offset down */
+    memset(head, 0xFF, sizeof(int32_t) << HOST_DELTA_HASH_BITS);
+    for (uint32_t i = 0; i + HOST_DELTA_KEY <= old_size; i++)
+    {
+        uint32_t h = host_delta_hash(&old[i]);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    }
+
+    for (uint32_t page = 0; page < size; page += FLASH_DRV_PAGE_SIZE)
+    {
+        uint32_t end = (size - page > FLASH_DRV_PAGE_SIZE) ? page + FLASH_DRV_PAGE_SIZE : size;
+        uint32_t anchor = page;
+        uint32_t d = page;
+
+        page_offsets[page / FLASH_DRV_PAGE_SIZE] = (uint32_t)(o - out);
+
+        while (d < end)
+        {
+            uint32_t best = 0;
+            uint32_t best_source = 0;
+            int64_t guess[2] = {d, (int64_t)d + shift};
+
+            for (uint32_t g = 0; g < 2; g++)
+            {
+                if (guess[g] < page || guess[g] >= old_size)
+                    continue;
+
+                uint32_t len = host_delta_match(old, old_size, image, d, end, (uint32_t)guess[g]);
+                if (len > best)
+                {
+                    best = len;
+                    best_source = (uint32_t)guess[g];
+                }
+            }
+
+            if (best < end - d && d + HOST_DELTA_KEY <= size)
+            {
+                uint32_t depth = 0;
+
+                for (int32_t c = head[host_delta_hash(&image[d])]; c >= (int32_t)page && depth < HOST_DELTA_CHAIN_DEPTH;
+                     c = prev[c], depth++)
+                {
+                    uint32_t len = host_delta_match(old, old_size, image, d, end, (uint32_t)c);
+                    if (len > best)
+                    {
+                        best = len;
+                        best_source = (uint32_t)c;
+                    }
+                }
+            }
+
+            if (best < HOST_DELTA_MIN_COPY)
+            {
+                d++;
+                continue;
+            }
+
+            o = host_delta_insert(o, &image[anchor], d - anchor);
+            o = host_delta_copy(o, best_source, best);
+
+            shift = (int64_t)best_source - d;
+            d += best;
+            anchor = d;
+        }
+
+        o = host_delta_insert(o, &image[anchor], end - anchor);
+    }
+
+    free(head);
+    free(prev);
+    return (uint32_t)(o - out);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file host_image.c
+ * @brief Post-link side of the image header (format in boot_image.h)
+ *
+ * @note  The header is filled in place, field by field in the order the
+ *        crcs need: size and build id, image crc, header crc last. The
+ *        bootloader's own boot_image.c does the crcs, so both ends agree.
+ */
+
+#include <string.h>
+#include "host_image.h"
+#include "boot_image.h"
+
+int host_image_stamp(uint8_t *image, uint32_t size, uint32_t build_id)
+{
+    boot_image_header_t header;
+
+    if (size < BOOT_IMAGE_HEADER_OFFSET + sizeof(header))
+        return -1;
+
+    memcpy(&header, &image[BOOT_IMAGE_HEADER_OFFSET], sizeof(header));
+    if (header.magic != BOOT_IMAGE_MAGIC || header.header_size < sizeof(header) ||
+        BOOT_IMAGE_HEADER_OFFSET + header.header_size > size)
+        return -1;
+
+    header.image_size = size;
+    header.build_id = 0;
+    memcpy(&image[BOOT_IMAGE_HEADER_OFFSET], &header, sizeof(header));
+
+    header.build_id = build_id ? build_id : boot_image_crc(image, size, NULL);
+    memcpy(&image[BOOT_IMAGE_HEADER_OFFSET], &header, sizeof(header));
+
+    header.image_crc = boot_image_crc(image, size, NULL);
+    memcpy(&image[BOOT_IMAGE_HEADER_OFFSET], &header, sizeof(header));
+
+    header.header_crc = boot_image_header_crc((const boot_image_header_t *)(const void *)&image[BOOT_IMAGE_HEADER_OFFSET]);
+    memcpy(&image[BOOT_IMAGE_HEADER_OFFSET], &header, sizeof(header));
+
+    return 0;
+}
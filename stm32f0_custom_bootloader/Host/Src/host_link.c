@@ -0,0 +1,250 @@
+/**
+ * @file host_link.c
+ * @brief Host (gateway) side of the simulated link, runs on the pty slave.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include "host_link.h"
+#include "uart_sim.h"
+
+#define HOST_LINK_IDLE_TIMEOUT_MS   (1000)
+#define HOST_LINK_FIFO_BYTES        (64)        /* usb-serial tx buffer, bytes written ahead of the wire */
+
+#define HOST_XON_CHAR               (0x11)
+#define HOST_XOFF_CHAR              (0x13)
+#define HOST_ESC_CHAR               (0x7D)
+#define HOST_ESC_MASK               (0x20)
+
+int host_link_open(host_link_t *link, const char *device, uint32_t baud, uint8_t xonxoff)
+{
+    struct termios tio;
+
+    memset(link, 0, sizeof(host_link_t));
+    link->baud = baud;
+    link->xonxoff = xonxoff;
+
+    link->fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (link->fd < 0)
+        return -1;
+
+    if (tcgetattr(link->fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(link->fd, TCSANOW, &tio);
+    }
+
+    return 0;
+}
+
+void host_link_close(host_link_t *link)
+{
+    if (link->fd >= 0)
+        close(link->fd);
+    link->fd = -1;
+}
+
+static void host_link_txq_put(host_link_t *link, uint8_t byte)
+{
+    link->txq[(link->txq_head + link->txq_len) % HOST_LINK_TXQ_SIZE] = byte;
+    link->txq_len++;
+}
+
+uint32_t host_link_write_room(host_link_t *link)
+{
+    uint32_t room = HOST_LINK_TXQ_SIZE - link->txq_len;
+    return link->xonxoff ? room / 2 : room;
+}
+
+uint32_t host_link_write(host_link_t *link, const uint8_t *data, uint32_t len)
+{
+    uint32_t room = host_link_write_room(link);
+    len = (len > room) ? room : len;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint8_t byte = data[i];
+
+        if (link->xonxoff && (byte == HOST_XON_CHAR || byte == HOST_XOFF_CHAR || byte == HOST_ESC_CHAR))
+        {
+            host_link_txq_put(link, HOST_ESC_CHAR);
+            byte ^= HOST_ESC_MASK;
+        }
+
+        host_link_txq_put(link, byte);
+    }
+
+    return len;
+}
+
+int host_link_service(host_link_t *link)
+{
+    uint8_t chunk[256];
+    uint64_t now = hal_sim_time_us();
+    uint32_t byte_time = uart_sim_byte_time_us(link->baud);
+    uint32_t n = 0;
+
+    if (link->tx_paused || link->txq_len == 0)
+        return 0;
+
+    if (link->wire_us < now)
+        link->wire_us = now;
+
+    /* the host uart only takes what its fifo can hold ahead of the wire */
+    while (n < sizeof(chunk) && n < link->txq_len &&
+           link->wire_us + (uint64_t)n * byte_time <= now + (uint64_t)HOST_LINK_FIFO_BYTES * byte_time)
+    {
+        chunk[n] = link->txq[(link->txq_head + n) % HOST_LINK_TXQ_SIZE];
+        n++;
+    }
+
+    if (n == 0)
+        return 0;
+
+    ssize_t written = write(link->fd, chunk, n);
+    if (written < 0)
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    if (written == 0)
+        return 0;
+
+    link->txq_head = (link->txq_head + (uint32_t)written) % HOST_LINK_TXQ_SIZE;
+    link->txq_len -= (uint32_t)written;
+    link->wire_us += (uint64_t)written * byte_time;
+    return 0;
+}
+
+int host_link_read(host_link_t *link, uint8_t *data, uint32_t len, int timeout_ms)
+{
+    uint8_t chunk[256];
+    uint64_t deadline = hal_sim_time_us() + (uint64_t)timeout_ms * 1000ULL;
+
+    while (1)
+    {
+        if (host_link_service(link) != 0)
+            return -1;
+
+        /* short naps while the tx queue drains at line rate */
+        struct pollfd pfd = {.fd = link->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, (link->txq_len && !link->tx_paused) ? 0 : 1);
+
+        if (ready < 0 && errno != EINTR)
+            return -1;
+
+        /* the other end is gone */
+        if (ready > 0 && !(pfd.revents & POLLIN) && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+            return -1;
+
+        if (ready > 0 && (pfd.revents & POLLIN))
+        {
+            uint32_t max = (len > sizeof(chunk)) ? sizeof(chunk) : len;
+            ssize_t n = read(link->fd, chunk, max);
+            uint32_t out = 0;
+
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                return -1;
+
+            for (ssize_t i = 0; i < n; i++)
+            {
+                uint8_t byte = chunk[i];
+
+                if (link->xonxoff)
+                {
+                    if (byte == HOST_XOFF_CHAR) { link->tx_paused = 1; continue; }
+                    if (byte == HOST_XON_CHAR)  { link->tx_paused = 0; continue; }
+
+                    if (link->rx_escaped)
+                    {
+                        link->rx_escaped = 0;
+                        byte ^= HOST_ESC_MASK;
+                    }
+                    else if (byte == HOST_ESC_CHAR)
+                    {
+                        link->rx_escaped = 1;
+                        continue;
+                    }
+                }
+
+                data[out++] = byte;
+            }
+
+            if (out > 0)
+                return (int)out;
+        }
+
+        if (hal_sim_time_us() >= deadline)
+            return 0;
+    }
+}
+
+static uint8_t host_link_pattern(uint32_t idx)
+{
+    return (uint8_t)((idx * 7U) ^ (idx >> 8));
+}
+
+int host_link_loopback(host_link_t *link, uint32_t bytes, uint32_t window, host_link_report_t *report)
+{
+    uint8_t chunk[256];
+    uint32_t sent = 0;
+    uint32_t received = 0;
+
+    memset(report, 0, sizeof(host_link_report_t));
+    report->payload_bytes = bytes;
+    report->baud = link->baud;
+
+    uint64_t start = hal_sim_time_us();
+
+    while (received < bytes)
+    {
+        /* bytes in flight are bounded, the target rings hold only so much */
+        uint32_t len = bytes - sent;
+        uint32_t room = window - (sent - received);
+
+        len = (len > room) ? room : len;
+        len = (len > sizeof(chunk)) ? sizeof(chunk) : len;
+
+        for (uint32_t i = 0; i < len; i++)
+            chunk[i] = host_link_pattern(sent + i);
+
+        sent += host_link_write(link, chunk, len);
+
+        int n = host_link_read(link, chunk, sizeof(chunk), (sent < bytes && sent - received < window) ? 0 : HOST_LINK_IDLE_TIMEOUT_MS);
+        if (n < 0)
+            break;
+
+        if (n == 0 && sent - received >= window)
+            break; /* remaining bytes were lost on the way */
+
+        if (n == 0 && sent == bytes)
+            break;
+
+        for (int i = 0; i < n && received < bytes; i++, received++)
+        {
+            if (chunk[i] == host_link_pattern(received))
+                report->good_bytes++;
+        }
+    }
+
+    report->elapsed_us = hal_sim_time_us() - start;
+    report->bad_bytes = bytes - report->good_bytes;
+
+    return (report->bad_bytes == 0) ? 0 : -1;
+}
+
+void host_link_print_report(const char *name, const host_link_report_t *report)
+{
+    double seconds = (double)report->elapsed_us / 1e6;
+    double rate = (seconds > 0.0) ? report->good_bytes / seconds : 0.0;
+    double line = report->baud / 10.0;
+
+    printf("%-10s %8lu bytes  %8.3f s  %9.1f B/s", name, (unsigned long)report->payload_bytes, seconds, rate);
+
+    if (line > 0.0)
+        printf("  %5.1f%% of line", 100.0 * rate / line);
+
+    printf("  bad %lu\r\n", (unsigned long)report->bad_bytes);
+}
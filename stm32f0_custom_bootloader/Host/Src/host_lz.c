@@ -0,0 +1,127 @@
+/**
+ * @file host_lz.c
+ * @brief Gateway side LZ compressor for BOOT_MODE_BINARY_LZ (format in boot_lz.h)
+ *
+ * @note  Greedy parse over hash chains of 4 byte prefixes, matches no
+ *        farther back than BOOT_LZ_WINDOW. The last sequence is literals
+ *        only, unless the image ends with a match.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "host_lz.h"
+#include "boot_lz.h"
+
+#define HOST_LZ_HASH_BITS       (13)
+#define HOST_LZ_CHAIN_DEPTH     (256)   /* candidates tried per position */
+
+static uint32_t host_lz_hash(const uint8_t *p)
+{
+    return (boot_get_u32(p) * 2654435761U) >> (32 - HOST_LZ_HASH_BITS);
+}
+
+/** Length extension bytes after a nibble of 15 */
+static uint8_t *host_lz_length(uint8_t *out, uint32_t len)
+{
+    for (; len >= 255; len -= 255)
+        *out++ = 255;
+    *out++ = (uint8_t)len;
+
+    return out;
+}
+
+static uint8_t *host_lz_sequence(uint8_t *out, const uint8_t *literals, uint32_t literal_len, uint32_t offset,
+                                 uint32_t match)
+{
+    uint8_t *token = out++;
+    uint32_t match_len = match ? match - BOOT_LZ_MIN_MATCH : 0;
+
+    *token = (uint8_t)(((literal_len < 15) ? literal_len : 15) << 4);
+    if (literal_len >= 15)
+        out = host_lz_length(out, literal_len - 15);
+
+    memcpy(out, literals, literal_len);
+    out += literal_len;
+
+    if (match == 0)
+        return out;
+
+    *token |= (uint8_t)((match_len < 15) ? match_len : 15);
+    boot_put_u16(out, (uint16_t)offset);
+    out += 2;
+
+    if (match_len >= 15)
+        out = host_lz_length(out, match_len - 15);
+
+    return out;
+}
+
+uint32_t host_lz_compress(const uint8_t *in, uint32_t size, uint8_t *out)
+{
+    int32_t *head = malloc(sizeof(int32_t) << HOST_LZ_HASH_BITS);
+    int32_t *prev = malloc(((size_t)size + 1) * sizeof(int32_t));
+    uint8_t *o = out;
+    uint32_t anchor = 0;
+    uint32_t i = 0;
+
+    if (head == NULL || prev == NULL)
+    {
+        free(head);
+        free(prev);
+        return 0;
+    }
+
+    memset(head, 0xFF, sizeof(int32_t) << HOST_LZ_HASH_BITS);
+
+    while (i + BOOT_LZ_MIN_MATCH <= size)
+    {
+        uint32_t h = host_lz_hash(&in[i]);
+        uint32_t best = 0;
+        uint32_t best_offset = 0;
+        uint32_t depth = 0;
+
+        for (int32_t c = head[h]; c >= 0 && i - (uint32_t)c <= BOOT_LZ_WINDOW && depth < HOST_LZ_CHAIN_DEPTH;
+             c = prev[c], depth++)
+        {
+            uint32_t len = 0;
+
+            while (i + len < size && in[c + len] == in[i + len])
+                len++;
+
+            if (len > best)
+            {
+                best = len;
+                best_offset = i - (uint32_t)c;
+            }
+        }
+
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+
+        if (best < BOOT_LZ_MIN_MATCH)
+        {
+            i++;
+            continue;
+        }
+
+        o = host_lz_sequence(o, &in[anchor], i - anchor, best_offset, best);
+
+        /* positions inside the match are candidates for the next ones */
+        for (uint32_t k = i + 1; k < i + best && k + BOOT_LZ_MIN_MATCH <= size; k++)
+        {
+            h = host_lz_hash(&in[k]);
+            prev[k] = head[h];
+            head[h] = (int32_t)k;
+        }
+
+        i += best;
+        anchor = i;
+    }
+
+    if (anchor < size)
+        o = host_lz_sequence(o, &in[anchor], size - anchor, 0, 0);
+
+    free(head);
+    free(prev);
+    return (uint32_t)(o - out);
+}
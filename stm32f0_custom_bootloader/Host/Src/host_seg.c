@@ -0,0 +1,212 @@
+/**
+ * @file host_seg.c
+ * @brief Gateway side packer for BOOT_MODE_SEGMENTS (format in boot_seg.h)
+ *
+ * @note  The file is laid out over a map of the app area first, what it
+ *        loads is marked byte by byte. Pages with data drop their 0xFF
+ *        runs, then the marks become segments, gaps shorter than
+ *        HOST_SEG_MIN_GAP are sent as they are. Hex records go through the
+ *        target's own decoder (boot_hex.c).
+ */
+
+#include <string.h>
+#include "host_seg.h"
+#include "boot_seg.h"
+#include "boot_hex.h"
+#include "boot_config.h"
+
+static uint8_t host_seg_loaded[BOOT_APP_MAX_SIZE];
+static uint32_t host_seg_end;
+
+static int host_seg_place(uint8_t *image, uint32_t address, const uint8_t *data, uint32_t len)
+{
+    if (address < BOOT_APP_START_ADDR || address > BOOT_APP_END_ADDR || len > BOOT_APP_END_ADDR - address)
+        return -1;
+
+    memcpy(&image[address - BOOT_APP_START_ADDR], data, len);
+    memset(&host_seg_loaded[address - BOOT_APP_START_ADDR], 1, len);
+    if (address + len - BOOT_APP_START_ADDR > host_seg_end)
+        host_seg_end = address + len - BOOT_APP_START_ADDR;
+    return 0;
+}
+
+/** ELF32 little endian, PT_LOAD program headers with file contents */
+static int host_seg_load_elf(const uint8_t *file, uint32_t size, uint8_t *image)
+{
+    if (size < 52 || file[4] != 1 || file[5] != 1)
+        return -1;
+
+    uint32_t phoff = boot_get_u32(&file[0x1C]);
+    uint16_t phentsize = boot_get_u16(&file[0x2A]);
+    uint16_t phnum = boot_get_u16(&file[0x2C]);
+
+    for (uint16_t n = 0; n < phnum; n++)
+    {
+        uint32_t ph = phoff + (uint32_t)n * phentsize;
+
+        if (phentsize < 32 || ph > size || 32 > size - ph)
+            return -1;
+
+        uint32_t type = boot_get_u32(&file[ph]);
+        uint32_t offset = boot_get_u32(&file[ph + 4]);
+        uint32_t paddr = boot_get_u32(&file[ph + 12]);
+        uint32_t filesz = boot_get_u32(&file[ph + 16]);
+
+        if (type != 1 || filesz == 0)
+            continue;
+
+        if (offset > size || filesz > size - offset || host_seg_place(image, paddr, &file[offset], filesz) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int host_seg_load_hex(const uint8_t *file, uint32_t size, uint8_t *image)
+{
+    static boot_hex_record_t record;
+    boot_hex_t hex;
+    uint32_t i = 0;
+
+    boot_hex_init(&hex);
+
+    while (i < size)
+    {
+        uint32_t end = i;
+
+        while (end < size && file[end] != '\n')
+            end++;
+
+        if (file[i] == ':')
+        {
+            if (end - i > 0xFFFF || !boot_hex_decode(&file[i], (uint16_t)(end - i), &record))
+                return -1;
+
+            uint32_t address = boot_hex_address(&hex, &record);
+
+            if (record.type == BOOT_HEX_EOF)
+                break;
+            if (record.type == BOOT_HEX_DATA && host_seg_place(image, address, record.data, record.len) != 0)
+                return -1;
+        }
+
+        i = end + 1;
+    }
+
+    return 0;
+}
+
+uint32_t host_seg_load(const uint8_t *file, uint32_t size, uint8_t *image, host_seg_t *segs, uint32_t max,
+                       uint32_t *end)
+{
+    int st;
+
+    memset(image, 0xFF, BOOT_APP_MAX_SIZE);
+    memset(host_seg_loaded, 0, sizeof(host_seg_loaded));
+    host_seg_end = 0;
+
+    if (size >= 4 && file[0] == 0x7F && memcmp(&file[1], "ELF", 3) == 0)
+        st = host_seg_load_elf(file, size, image);
+    else if (size >= 1 && file[0] == ':')
+        st = host_seg_load_hex(file, size, image);
+    else
+        st = host_seg_place(image, BOOT_APP_START_ADDR, file, size);
+
+    if (st != 0)
+        return 0;
+
+    *end = host_seg_end;
+
+    /* the writer pads a page it programs with 0xFF, a page without data has to come whole to be erased */
+    for (uint32_t page = 0; page < BOOT_APP_MAX_SIZE; page += FLASH_DRV_PAGE_SIZE)
+    {
+        uint8_t data = 0;
+
+        for (uint32_t i = page; i < page + FLASH_DRV_PAGE_SIZE && !data; i++)
+            data = host_seg_loaded[i] && image[i] != 0xFF;
+
+        for (uint32_t i = page; i < page + FLASH_DRV_PAGE_SIZE && data; i++)
+            host_seg_loaded[i] = host_seg_loaded[i] && image[i] != 0xFF;
+    }
+
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    while (i < BOOT_APP_MAX_SIZE)
+    {
+        if (!host_seg_loaded[i])
+        {
+            i++;
+            continue;
+        }
+
+        uint32_t gap = i - (count ? segs[count - 1].address - BOOT_APP_START_ADDR + segs[count - 1].len : 0);
+
+        if (count && gap < HOST_SEG_MIN_GAP)
+        {
+            segs[count - 1].len += gap;
+        }
+        else
+        {
+            if (count == max)
+                return 0;
+            segs[count].address = BOOT_APP_START_ADDR + i;
+            segs[count].len = 0;
+            count++;
+        }
+
+        while (i < BOOT_APP_MAX_SIZE && host_seg_loaded[i])
+        {
+            segs[count - 1].len++;
+            i++;
+        }
+    }
+
+    return count;
+}
+
+uint32_t host_seg_pack(const uint8_t *image, const host_seg_t *segs, uint32_t count, uint8_t *out)
+{
+    uint8_t *p = out;
+
+    boot_put_u32(p, BOOT_SEG_MAGIC);
+    boot_put_u32(p + 4, count);
+    p += BOOT_SEG_HEADER_SIZE;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        boot_put_u32(p, segs[n].address);
+        boot_put_u32(p + 4, segs[n].len);
+        memcpy(p + BOOT_SEG_ENTRY_SIZE, &image[segs[n].address - BOOT_APP_START_ADDR], segs[n].len);
+        p += BOOT_SEG_ENTRY_SIZE + segs[n].len;
+    }
+
+    return (uint32_t)(p - out);
+}
+
+uint32_t host_seg_span(const uint8_t *list, uint32_t len)
+{
+    uint32_t end = 0;
+    uint32_t i = BOOT_SEG_HEADER_SIZE;
+
+    if (len < BOOT_SEG_HEADER_SIZE || boot_get_u32(list) != BOOT_SEG_MAGIC)
+        return 0;
+
+    for (uint32_t n = boot_get_u32(&list[4]); n; n--)
+    {
+        if (len - i < BOOT_SEG_ENTRY_SIZE)
+            return 0;
+
+        uint32_t address = boot_get_u32(&list[i]);
+        uint32_t size = boot_get_u32(&list[i + 4]);
+
+        i += BOOT_SEG_ENTRY_SIZE;
+        if (size > len - i || address < BOOT_APP_START_ADDR)
+            return 0;
+
+        i += size;
+        end = address + size - BOOT_APP_START_ADDR;
+    }
+
+    return end;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file image_stamp.c
+ * @brief Post-link step of the user app: fills its image header (boot_image.h)
+ *
+ * @note  usage: image_stamp [--build-id N] APP.elf [APP.bin]
+ *        The ELF is laid out over the app area like a download would
+ *        program it (host_seg.c), the header the app compiled in at
+ *        BOOT_IMAGE_HEADER_OFFSET gets its image size, build id and crcs,
+ *        and is written back into the ELF where its load segment holds it.
+ *        APP.bin, if given, gets the stamped image as a raw binary from
+ *        BOOT_APP_START_ADDR. Without --build-id the id is derived from the
+ *        image contents.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "host_seg.h"
+#include "host_image.h"
+#include "boot_image.h"
+#include "boot_config.h"
+#include "boot_protocol.h"
+
+static uint8_t image[BOOT_APP_MAX_SIZE];
+static host_seg_t segs[HOST_SEG_MAX];
+
+static uint8_t *image_stamp_read(const char *path, uint32_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = NULL;
+
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (len > 0) ? malloc((size_t)len) : NULL;
+    if (data != NULL && fread(data, 1, (size_t)len, f) != (size_t)len)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(f);
+    *size = (uint32_t)len;
+    return data;
+}
+
+/** File offset of a load address in the PT_LOAD program header holding it, 0 if none */
+static uint32_t image_stamp_elf_offset(const uint8_t *elf, uint32_t size, uint32_t address, uint32_t len)
+{
+    uint32_t phoff = boot_get_u32(&elf[0x1C]);
+    uint16_t phentsize = boot_get_u16(&elf[0x2A]);
+    uint16_t phnum = boot_get_u16(&elf[0x2C]);
+
+    for (uint16_t n = 0; n < phnum; n++)
+    {
+        const uint8_t *ph = &elf[phoff + (uint32_t)n * phentsize];
+        uint32_t offset = boot_get_u32(&ph[4]);
+        uint32_t paddr = boot_get_u32(&ph[12]);
+        uint32_t filesz = boot_get_u32(&ph[16]);
+
+        if (boot_get_u32(ph) == 1 && address >= paddr && address - paddr + len <= filesz &&
+            offset + filesz <= size)
+            return offset + (address - paddr);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"build-id", required_argument, NULL, 'b'},
+        {NULL, 0, NULL, 0}};
+    uint32_t build_id = 0;
+    uint32_t size;
+    uint32_t end;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "b:", options, NULL)) != -1)
+    {
+        if (opt != 'b')
+        {
+            fprintf(stderr, "usage: %s [--build-id N] APP.elf [APP.bin]\r\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        build_id = (uint32_t)strtoul(optarg, NULL, 0);
+    }
+
+    if (optind >= argc)
+    {
+        fprintf(stderr, "usage: %s [--build-id N] APP.elf [APP.bin]\r\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t *elf = image_stamp_read(argv[optind], &size);
+    if (elf == NULL || size < 4 || elf[0] != 0x7F || memcmp(&elf[1], "ELF", 3) != 0)
+    {
+        fprintf(stderr, "image stamp : %s is no ELF file\r\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (host_seg_load(elf, size, image, segs, HOST_SEG_MAX, &end) == 0 || host_image_stamp(image, end, build_id) != 0)
+    {
+        fprintf(stderr, "image stamp : no image header at 0x%08lx\r\n",
+                (unsigned long)(BOOT_APP_START_ADDR + BOOT_IMAGE_HEADER_OFFSET));
+        return EXIT_FAILURE;
+    }
+
+    const boot_image_header_t *header = (const boot_image_header_t *)(const void *)&image[BOOT_IMAGE_HEADER_OFFSET];
+    uint32_t at = image_stamp_elf_offset(elf, size, BOOT_APP_START_ADDR + BOOT_IMAGE_HEADER_OFFSET, header->header_size);
+    FILE *f = (at != 0) ? fopen(argv[optind], "r+b") : NULL;
+
+    if (f == NULL || fseek(f, (long)at, SEEK_SET) != 0 ||
+        fwrite(header, 1, header->header_size, f) != header->header_size || fclose(f) != 0)
+    {
+        fprintf(stderr, "image stamp : header not written to %s\r\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (optind + 1 < argc)
+    {
+        f = fopen(argv[optind + 1], "wb");
+        if (f == NULL || fwrite(image, 1, end, f) != end || fclose(f) != 0)
+        {
+            fprintf(stderr, "image stamp : %s not written\r\n", argv[optind + 1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("image stamp : %lu bytes, crc 0x%08lx, build id 0x%08lx, entry 0x%08lx, needs bootloader 0x%06lx\r\n",
+           (unsigned long)header->image_size, (unsigned long)header->image_crc, (unsigned long)header->build_id,
+           (unsigned long)header->entry, (unsigned long)header->min_boot_version);
+
+    free(elf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,511 @@
+/**
+ * @file uart_sim.c
+ * @brief Host emulation of the USART peripheral and the HAL UART IT API.
+ *
+ * @note  Each simulated port owns the master side of a pseudo-terminal. Bytes
+ *        written by the host on the slave side are placed on a "wire" delay line
+ *        and handed to HAL_UART_RxCpltCallback() one by one, paced at the
+ *        configured baud rate plus latency, exactly like the rx interrupt would.
+ *        Transmissions started with HAL_UART_Transmit_IT() hold gState busy for
+ *        their wire time and then raise HAL_UART_TxCpltCallback().
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include "uart_sim.h"
+#include "uart_driver.h"
+
+/**@brief Enable/Disable debug messages */
+#define UART_SIM_DEBUG 0
+#define UART_SIM_TAG "uart sim : "
+
+#if UART_SIM_DEBUG
+#define uart_sim_dbg(format, ...) printf(UART_SIM_TAG format, ##__VA_ARGS__)
+#else
+#define uart_sim_dbg(format, ...) \
+    do                            \
+    { /* Do nothing */            \
+    } while (0)
+#endif
+
+#define SIM_PORTS               (2)
+#define SIM_LINE_SIZE           (4096)     /* bytes in flight per direction */
+#define SIM_TX_XFER_SIZE        (2048)     /* biggest HAL_UART_Transmit_IT() transfer */
+#define SIM_BITS_PER_BYTE       (10)       /* start + 8 data + stop */
+
+typedef struct
+{
+    uint64_t due_us[SIM_LINE_SIZE];
+    uint8_t  byte[SIM_LINE_SIZE];
+    uint16_t head;
+    uint16_t tail;
+    uint16_t count;
+    uint64_t last_due_us;
+} sim_line_t;
+
+typedef enum
+{
+    SIM_PORT_UNUSED = 0x00,
+    SIM_PORT_PTY,
+    SIM_PORT_STDOUT,
+} sim_port_type_t;
+
+typedef struct
+{
+    sim_port_type_t type;
+    int fd;
+    uart_sim_cfg_t cfg;
+    UART_HandleTypeDef *huart;
+    sim_line_t rx_line;
+    sim_line_t tx_line;
+    uint64_t tx_wire_free_us;           /* time the tx shift register becomes idle */
+    uint64_t tx_cplt_due_us;            /* time the ongoing IT transfer completes */
+    uint64_t stall_rdr_us;              /* stall window whose first byte is already held in RDR */
+    uint64_t rx_fetch_us;               /* last pty read, pending bytes were written after it */
+    uint32_t rand_state;
+    uart_sim_stats_t stats;
+} sim_port_t;
+
+USART_TypeDef sim_usart_regs[SIM_PORTS] = {{.id = 1}, {.id = 2}};
+static sim_port_t sim_ports[SIM_PORTS];
+
+/* last cpu stall window, bytes completed inside it find RDR already full */
+static uint64_t sim_stall_begin_us;
+static uint64_t sim_stall_end_us;
+
+static sim_port_t *sim_port_get(USART_TypeDef *instance)
+{
+    if (instance == NULL || instance->id == 0 || instance->id > SIM_PORTS)
+        return NULL;
+
+    return &sim_ports[instance->id - 1];
+}
+
+uint32_t uart_sim_byte_time_us(uint32_t baud)
+{
+    if (baud == 0)
+        return 0;
+
+    return (SIM_BITS_PER_BYTE * 1000000UL + baud - 1) / baud;
+}
+
+/**
+ * @brief xorshift32, reproducible error pattern for a given run
+ */
+static uint32_t sim_rand(sim_port_t *port)
+{
+    uint32_t x = port->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    port->rand_state = x;
+    return x;
+}
+
+static uint8_t sim_inject_errors(sim_port_t *port, uint8_t byte)
+{
+    if (port->cfg.bit_error_rate <= 0.0)
+        return byte;
+
+    uint32_t threshold = (uint32_t)(port->cfg.bit_error_rate * 4294967295.0);
+
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+        if (sim_rand(port) < threshold)
+        {
+            byte ^= (uint8_t)(1U << bit);
+            port->stats.bit_errors++;
+        }
+    }
+
+    return byte;
+}
+
+static uint16_t sim_line_free(sim_line_t *line)
+{
+    return SIM_LINE_SIZE - line->count;
+}
+
+/**
+ * @brief Put a byte on the wire, it arrives after latency and one byte time,
+ *        never before the previous byte has been fully shifted.
+ */
+static void sim_line_put(sim_line_t *line, uint64_t start_us, uint32_t byte_time_us, uint8_t byte)
+{
+    uint64_t due = start_us + byte_time_us;
+
+    if (due < line->last_due_us + byte_time_us)
+        due = line->last_due_us + byte_time_us;
+
+    line->last_due_us = due;
+    line->due_us[line->head] = due;
+    line->byte[line->head] = byte;
+    line->head = (line->head + 1) % SIM_LINE_SIZE;
+    line->count++;
+}
+
+static int sim_line_get_due(sim_line_t *line, uint64_t now_us, uint8_t *byte)
+{
+    if (line->count == 0 || line->due_us[line->tail] > now_us)
+        return 0;
+
+    *byte = line->byte[line->tail];
+    line->tail = (line->tail + 1) % SIM_LINE_SIZE;
+    line->count--;
+    return 1;
+}
+
+int uart_sim_attach_pty(USART_TypeDef *instance, const uart_sim_cfg_t *cfg, char *slave, size_t slave_len)
+{
+    sim_port_t *port = sim_port_get(instance);
+    struct termios tio;
+
+    if (port == NULL)
+        return -1;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+        return -1;
+
+    /* raw line: no echo, no CR/LF mangling and no IXON, XON/XOFF must reach both ends */
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (slave != NULL && ptsname_r(fd, slave, slave_len) != 0)
+        return -1;
+
+    memset(port, 0, sizeof(sim_port_t));
+    port->type = SIM_PORT_PTY;
+    port->fd = fd;
+    port->cfg = *cfg;
+    port->rand_state = 0x2545F491U ^ instance->id;
+
+    uart_sim_dbg("usart%lu attached to %s\r\n", (unsigned long)instance->id, slave ? slave : "pty");
+    return 0;
+}
+
+void uart_sim_attach_stdout(USART_TypeDef *instance)
+{
+    sim_port_t *port = sim_port_get(instance);
+
+    if (port == NULL)
+        return;
+
+    memset(port, 0, sizeof(sim_port_t));
+    port->type = SIM_PORT_STDOUT;
+    port->fd = STDOUT_FILENO;
+}
+
+void uart_sim_get_stats(USART_TypeDef *instance, uart_sim_stats_t *stats)
+{
+    sim_port_t *port = sim_port_get(instance);
+
+    if (port != NULL && stats != NULL)
+        *stats = port->stats;
+}
+
+/**
+ * @brief Host -> target: read pending pty bytes onto the wire
+ */
+static void sim_port_rx_fetch(sim_port_t *port, uint64_t now)
+{
+    uint8_t chunk[256];
+    uint32_t byte_time = uart_sim_byte_time_us(port->cfg.baud);
+
+    /*
+     * The far end already paces its writes at the line rate; bytes found now
+     * went out at the earliest after the previous read. Timing them from
+     * that read keeps a slow main loop pass from stretching the wire.
+     */
+    uint64_t start = (port->rx_fetch_us != 0) ? port->rx_fetch_us : now;
+    port->rx_fetch_us = now;
+
+    size_t room = sim_line_free(&port->rx_line);
+    while (room > 0)
+    {
+        ssize_t n = read(port->fd, chunk, room < sizeof(chunk) ? room : sizeof(chunk));
+        if (n <= 0)
+            break;
+
+        for (ssize_t i = 0; i < n; i++)
+            sim_line_put(&port->rx_line, start + port->cfg.latency_us, byte_time, chunk[i]);
+
+        room -= (size_t)n;
+    }
+}
+
+/**
+ * @brief Hand every byte that has finished arriving to the rx complete callback
+ */
+static void sim_port_rx_poll(sim_port_t *port, uint64_t now)
+{
+    uint8_t byte;
+
+    sim_port_rx_fetch(port, now);
+
+    while (port->rx_line.count && port->rx_line.due_us[port->rx_line.tail] <= now)
+    {
+        UART_HandleTypeDef *huart = port->huart;
+        uint64_t due = port->rx_line.due_us[port->rx_line.tail];
+
+        sim_line_get_due(&port->rx_line, now, &byte);
+        byte = sim_inject_errors(port, byte);
+
+        if (due > sim_stall_begin_us && due <= sim_stall_end_us)
+        {
+            /* cpu was stalled: RDR holds the first byte, later ones set ORE */
+            if (port->stall_rdr_us == sim_stall_end_us)
+            {
+                port->stats.overruns++;
+                continue;
+            }
+            port->stall_rdr_us = sim_stall_end_us;
+        }
+
+        if (huart == NULL || huart->RxState != HAL_UART_STATE_BUSY_RX)
+        {
+            /* nobody armed the receiver: RDR is overwritten, ORE */
+            port->stats.overruns++;
+            continue;
+        }
+
+        *huart->pRxBuffPtr++ = byte;
+        port->stats.rx_bytes++;
+
+        if (--huart->RxXferCount == 0)
+        {
+            huart->RxState = HAL_UART_STATE_READY;
+            HAL_UART_RxCpltCallback(huart);
+        }
+    }
+}
+
+/**
+ * @brief Target -> host: raise tx complete once the transfer left the shift
+ *        register, and deliver bytes that reached the far end of the wire.
+ */
+static void sim_port_tx_poll(sim_port_t *port, uint64_t now)
+{
+    UART_HandleTypeDef *huart = port->huart;
+    uint8_t chunk[256];
+    size_t n = 0;
+    uint16_t idx = port->tx_line.tail;
+
+    /* peek what reached the far end, the pty may accept only part of it */
+    while (n < sizeof(chunk) && n < port->tx_line.count && port->tx_line.due_us[idx] <= now)
+    {
+        chunk[n++] = port->tx_line.byte[idx];
+        idx = (idx + 1) % SIM_LINE_SIZE;
+    }
+
+    if (n > 0)
+    {
+        ssize_t written = write(port->fd, chunk, n);
+        uint8_t byte;
+
+        for (ssize_t i = 0; i < written; i++)
+            sim_line_get_due(&port->tx_line, now, &byte);
+    }
+
+    if (huart != NULL && huart->gState == HAL_UART_STATE_BUSY_TX && now >= port->tx_cplt_due_us)
+    {
+        huart->gState = HAL_UART_STATE_READY;
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
+
+void uart_sim_poll(void)
+{
+    uint64_t now = hal_sim_time_us();
+
+    for (int i = 0; i < SIM_PORTS; i++)
+    {
+        sim_port_t *port = &sim_ports[i];
+
+        if (port->type == SIM_PORT_PTY)
+            sim_port_rx_poll(port, now);
+
+        if (port->type != SIM_PORT_UNUSED)
+            sim_port_tx_poll(port, now);
+    }
+}
+
+void uart_sim_stall(uint32_t us)
+{
+    uint64_t begin = hal_sim_time_us();
+
+    /* bytes already due were served before the stall */
+    uart_sim_poll();
+
+    /* the wire keeps running, nobody reads it */
+    uint64_t now;
+    while ((now = hal_sim_time_us()) < begin + us)
+    {
+        for (int i = 0; i < SIM_PORTS; i++)
+        {
+            if (sim_ports[i].type == SIM_PORT_PTY)
+                sim_port_rx_fetch(&sim_ports[i], now);
+        }
+    }
+
+    sim_stall_begin_us = begin;
+    sim_stall_end_us = begin + us;
+}
+
+void uart_sim_busy(uint32_t us)
+{
+    uint64_t begin = hal_sim_time_us();
+    uint64_t now;
+    uint8_t byte;
+
+    uart_sim_poll();
+
+    /* USARTx_IRQHandler from SRAM: RDR goes to the stash, nothing else runs */
+    while ((now = hal_sim_time_us()) < begin + us)
+    {
+        for (int i = 0; i < SIM_PORTS; i++)
+        {
+            sim_port_t *port = &sim_ports[i];
+
+            if (port->type != SIM_PORT_PTY)
+                continue;
+
+            sim_port_rx_fetch(port, now);
+
+            while (sim_line_get_due(&port->rx_line, now, &byte))
+            {
+                byte = sim_inject_errors(port, byte);
+
+                if (port->huart == NULL)
+                {
+                    port->stats.overruns++;
+                    continue;
+                }
+
+                uart_driver_t *driver = (uart_driver_t *)((uint8_t *)port->huart - offsetof(uart_driver_t, handle));
+
+                if (driver->data.rx.stash == NULL)
+                {
+                    port->stats.overruns++;
+                    continue;
+                }
+
+                uart_rx_stash_put(driver, byte);
+                port->stats.rx_bytes++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Queue bytes on the tx wire, returns the time the last one is shifted out
+ */
+static uint64_t sim_port_tx_queue(sim_port_t *port, const uint8_t *data, uint16_t size)
+{
+    uint64_t now = hal_sim_time_us();
+    uint32_t byte_time = uart_sim_byte_time_us(port->cfg.baud);
+
+    if (port->tx_wire_free_us < now)
+        port->tx_wire_free_us = now;
+
+    for (uint16_t i = 0; i < size; i++)
+    {
+        /* a full wire behaves like a stalled shift register */
+        while (sim_line_free(&port->tx_line) == 0)
+            uart_sim_poll();
+
+        uint8_t byte = (port->type == SIM_PORT_PTY) ? sim_inject_errors(port, data[i]) : data[i];
+
+        port->tx_wire_free_us += byte_time;
+        sim_line_put(&port->tx_line, port->tx_wire_free_us - byte_time + port->cfg.latency_us, byte_time, byte);
+    }
+
+    port->stats.tx_bytes += size;
+    return port->tx_wire_free_us;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    sim_port_t *port = sim_port_get(huart->Instance);
+
+    if (port == NULL)
+        return HAL_ERROR;
+
+    if (port->type == SIM_PORT_UNUSED || port->type == SIM_PORT_STDOUT)
+    {
+        port->type = SIM_PORT_STDOUT;
+        port->fd = STDOUT_FILENO;
+        port->cfg.baud = huart->Init.BaudRate;
+    }
+
+    port->huart = huart;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    sim_port_t *port = sim_port_get(huart->Instance);
+    (void)Timeout;
+
+    if (port == NULL || pData == NULL || Size == 0)
+        return HAL_ERROR;
+
+    if (huart->gState != HAL_UART_STATE_READY)
+        return HAL_BUSY;
+
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    uint64_t done = sim_port_tx_queue(port, pData, Size);
+
+    /* polling transfer, interrupts keep being served meanwhile */
+    while (hal_sim_time_us() < done)
+        uart_sim_poll();
+
+    huart->gState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    sim_port_t *port = sim_port_get(huart->Instance);
+
+    if (port == NULL || pData == NULL || Size == 0 || Size > SIM_TX_XFER_SIZE)
+        return HAL_ERROR;
+
+    if (huart->gState != HAL_UART_STATE_READY)
+        return HAL_BUSY;
+
+    huart->pTxBuffPtr = pData;
+    huart->TxXferSize = Size;
+    huart->TxXferCount = 0;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    /* bytes are latched now, the TXE interrupt would read them while shifting */
+    port->tx_cplt_due_us = sim_port_tx_queue(port, pData, Size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (pData == NULL || Size == 0)
+        return HAL_ERROR;
+
+    if (huart->RxState != HAL_UART_STATE_READY)
+        return HAL_BUSY;
+
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->RxXferCount = Size;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    return HAL_OK;
+}
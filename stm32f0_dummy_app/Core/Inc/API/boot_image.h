@@ -0,0 +1,38 @@
+/**
+ * @file boot_image.h
+ * @brief Image header the bootloader reads at a fixed offset of the app
+ *
+ * Placed by the linker script right after the 48 vectors, at
+ * BOOT_APP_START_ADDR + 0xC0. The app compiles in what it knows, the
+ * post-link step (stm32f0_custom_bootloader/Host/build/image_stamp) fills
+ * the image size, build id and crcs in the ELF and the binary.
+ * Same layout as stm32f0_custom_bootloader/Core/Inc/bootloader/boot_image.h.
+ */
+
+#ifndef BOOT_IMAGE_H
+#define BOOT_IMAGE_H
+
+#include <stdint.h>
+
+#define BOOT_IMAGE_MAGIC                (0x474D4942UL)  /* "BIMG" */
+#define BOOT_IMAGE_HEADER_VERSION       (1)
+
+/* oldest bootloader this app runs on, major (8) minor (8) patch (8): ENTER_BOOT_MODE and the mailbox handoff */
+#define BOOT_IMAGE_MIN_BOOT_VERSION     (0x00010000UL)
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_IMAGE_MAGIC */
+    uint16_t header_version;    /* BOOT_IMAGE_HEADER_VERSION */
+    uint16_t header_size;       /* sizeof(boot_image_header_t) */
+    uint32_t header_crc;        /* post-link */
+    uint32_t image_crc;         /* post-link */
+    uint32_t image_size;        /* post-link */
+    void (*entry)(void);        /* Reset_Handler */
+    uint32_t build_id;          /* post-link */
+    uint32_t min_boot_version;  /* BOOT_IMAGE_MIN_BOOT_VERSION */
+} boot_image_header_t;
+
+extern const boot_image_header_t boot_image_header;
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file boot_mailbox.h
+ * @brief "JUMP TO BOOT": BOOT MODE request to the bootloader through SRAM
+ *
+ * The mailbox is filled and the core soft-resets, no boot flag written to
+ * flash. It sits in .noinit at the top of RAM (linker script), the
+ * bootloader reads it before any other init and takes the link settings
+ * over. After a download the bootloader leaves the handoff latency there.
+ * Same layout as stm32f0_custom_bootloader/Core/Inc/bootloader/boot_mailbox.h.
+ */
+
+#ifndef BOOT_MAILBOX_H
+#define BOOT_MAILBOX_H
+
+#include <stdint.h>
+#include "uart_driver.h"
+
+#define BOOT_MAILBOX_ADDR               (0x20007FE0UL)  /* .noinit, 32 bytes */
+#define BOOT_MAILBOX_MAGIC              (0xB0075E55UL)
+#define BOOT_HANDOFF_MAGIC              (0xB0074A4DUL)
+
+/* flags */
+#define BOOT_MAILBOX_REPLY              (0x0001U)       /* answer ENTER_BOOT_MODE seq from the bootloader */
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_MAILBOX_MAGIC: BOOT MODE requested */
+    uint32_t baudrate;          /* gateway link, 0 keeps the default */
+    uint16_t seq;               /* of the ENTER_BOOT_MODE frame taken here */
+    uint16_t flags;
+    uint32_t start_timeout;     /* ms to BOOT_START_DOWNLOAD, 0 keeps the default */
+    uint32_t check;             /* inverted xor of the words above */
+} boot_mailbox_t;
+
+typedef struct
+{
+    uint32_t magic;             /* BOOT_HANDOFF_MAGIC: started by the bootloader without a reset */
+    uint32_t latency_us;        /* DOWNLOAD_FINISHED handled to our reset handler */
+    uint32_t check;             /* inverted xor of the words above */
+} boot_handoff_t;
+
+/** Handoff latency left by the bootloader, 0 if there is none. Always cleared. */
+uint8_t boot_mailbox_handoff(uint32_t *latency_us);
+
+/** Fill the mailbox and reset into the bootloader */
+void boot_mailbox_request(uint32_t baudrate, uint16_t seq, uint16_t flags, uint32_t start_timeout) __attribute__((noreturn));
+
+/**
+ * Watch the gateway link for ENTER_BOOT_MODE (optional payload: link baud
+ * (4) for the bootloader) and request BOOT MODE when one arrives intact.
+ */
+void boot_mailbox_poll(uart_driver_t *link);
+
+#endif
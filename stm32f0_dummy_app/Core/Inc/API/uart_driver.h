@@ -6,6 +6,26 @@
 
 #define MAX_DATA_CHUNK_SIZE           (20) 
 
+/* Software flow control (XON/XOFF) */
+#define UART_XON_CHAR                 (0x11)
+#define UART_XOFF_CHAR                (0x13)
+#define UART_ESC_CHAR                 (0x7D)   /* binary mode: ESC, byte ^ UART_ESC_MASK */
+#define UART_ESC_MASK                 (0x20)
+
+typedef struct
+{
+    uint8_t enabled;                /* in-band XON/XOFF active on this link */
+    uint8_t binary;                 /* escape XON/XOFF/ESC data bytes on the wire */
+    uint16_t high_watermark;        /* rx ring level that sends XOFF */
+    uint16_t low_watermark;         /* rx ring level that sends XON again */
+    volatile uint8_t rx_paused;     /* XOFF sent, peer must stop */
+    volatile uint8_t tx_paused;     /* XOFF received, we must stop */
+    volatile uint8_t hold;          /* peer paused on request, e.g. flash erase */
+    volatile uint8_t rx_escaped;    /* previous rx byte was UART_ESC_CHAR */
+    volatile uint8_t ctrl_pending;  /* XON/XOFF waiting for the transmitter */
+    uint8_t ctrl_byte;              /* XON/XOFF being transmitted */
+} uart_flow_t;
+
 
 typedef struct
 {
@@ -20,6 +40,7 @@ typedef struct
     {
         uint8_t *buffer;       /* Data to be transmitted via UART are stored in this buffer */
         c_buff_handle_t cb;    /* pointer typedef to circular buffer struct */
+        uint8_t chunk[MAX_DATA_CHUNK_SIZE]; /* data chunk being transmitted in it mode */
     } tx;
 
 }uart_data_t;
@@ -31,6 +52,7 @@ typedef struct
 typedef struct
 {
     uart_data_t data;
+    uart_flow_t flow;
     UART_HandleTypeDef handle;
     
 }uart_driver_t;
@@ -38,12 +60,14 @@ typedef struct
 
 uint8_t uart_init_it(uart_driver_t *driver, uint8_t *rx_buff, uint16_t rx_len,
                      uint8_t *tx_buff, uint16_t tx_len);
-uint8_t uart_get_rx_data_len(uart_driver_t *driver);
+uint16_t uart_get_rx_data_len(uart_driver_t *driver);
 uint8_t uart_read_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_fetch_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_clear_rx_data(uart_driver_t *driver);
 uint8_t uart_transmit(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len);
 uint8_t uart_write_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len);
+void uart_flow_control_init(uart_driver_t *driver, uint8_t binary, uint16_t low_watermark, uint16_t high_watermark);
+void uart_flow_hold(uart_driver_t *driver, uint8_t hold);
 
 #endif
\ No newline at end of file
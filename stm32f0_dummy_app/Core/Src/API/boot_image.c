@@ -0,0 +1,20 @@
+/**
+ * @file boot_image.c
+ * @brief Image header the bootloader reads at a fixed offset of the app
+ *
+ * @note  The fields left at 0 are filled by the post-link step, the
+ *        bootloader ignores a header whose crc does not match.
+ */
+
+#include "boot_image.h"
+
+extern void Reset_Handler(void);
+
+/* placed by the linker script at BOOT_APP_START_ADDR + 0xC0 */
+const boot_image_header_t boot_image_header __attribute__((section(".image_header"), used)) = {
+    .magic = BOOT_IMAGE_MAGIC,
+    .header_version = BOOT_IMAGE_HEADER_VERSION,
+    .header_size = sizeof(boot_image_header_t),
+    .entry = Reset_Handler,
+    .min_boot_version = BOOT_IMAGE_MIN_BOOT_VERSION,
+};
@@ -0,0 +1,119 @@
+/**
+ * @file boot_mailbox.c
+ * @brief "JUMP TO BOOT": BOOT MODE request to the bootloader through SRAM
+ *
+ * @note  Only ENTER_BOOT_MODE is recognized on the link, a frame is
+ *        | 0xA5 | cmd | seq (2) | len (2) | payload | crc32 (4) |, little
+ *        endian, crc over cmd to the end of the payload. Everything else is
+ *        dropped. The bootloader answers the frame after the reset.
+ */
+
+#include "boot_mailbox.h"
+
+#define BOOT_FRAME_SOF                  (0xA5)
+#define BOOT_FRAME_HEADER_SIZE          (6)         /* sof, cmd, seq, len */
+#define BOOT_FRAME_CRC_SIZE             (4)
+#define BOOT_CMD_ENTER_BOOT             (0x01)
+#define BOOT_ENTER_MAX_PAYLOAD          (4)         /* link baud */
+
+typedef struct
+{
+    boot_mailbox_t request;     /* app to bootloader */
+    boot_handoff_t handoff;     /* bootloader to app */
+} boot_noinit_t;
+
+/* placed by the linker script at BOOT_MAILBOX_ADDR, not zeroed at startup */
+static boot_noinit_t boot_noinit __attribute__((section(".noinit")));
+
+static uint8_t boot_frame[BOOT_FRAME_HEADER_SIZE + BOOT_ENTER_MAX_PAYLOAD + BOOT_FRAME_CRC_SIZE];
+static uint8_t boot_frame_idx;
+
+static uint32_t boot_mailbox_crc32(const uint8_t *data, uint32_t len)
+{
+    uint32_t crc = 0xFFFFFFFFUL;
+
+    while (len--)
+    {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0U - (crc & 1U)));
+    }
+
+    return ~crc;
+}
+
+static uint32_t boot_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t boot_mailbox_handoff(uint32_t *latency_us)
+{
+    boot_handoff_t *handoff = &boot_noinit.handoff;
+    uint8_t valid = handoff->magic == BOOT_HANDOFF_MAGIC && handoff->check == ~(handoff->magic ^ handoff->latency_us);
+
+    *latency_us = valid ? handoff->latency_us : 0;
+    handoff->magic = 0;
+
+    return valid;
+}
+
+void boot_mailbox_request(uint32_t baudrate, uint16_t seq, uint16_t flags, uint32_t start_timeout)
+{
+    boot_mailbox_t *mailbox = &boot_noinit.request;
+
+    __disable_irq();
+
+    mailbox->magic = BOOT_MAILBOX_MAGIC;
+    mailbox->baudrate = baudrate;
+    mailbox->seq = seq;
+    mailbox->flags = flags;
+    mailbox->start_timeout = start_timeout;
+    mailbox->check = ~(mailbox->magic ^ mailbox->baudrate ^ ((uint32_t)flags << 16 | seq) ^ mailbox->start_timeout);
+
+    /*SRAM keeps its contents through a system reset*/
+    NVIC_SystemReset();
+
+    while (1)
+    {
+    }
+}
+
+void boot_mailbox_poll(uart_driver_t *link)
+{
+    uint8_t byte;
+
+    while (uart_get_rx_data_len(link) && uart_read_rx_data(link, &byte, 1))
+    {
+        if (boot_frame_idx == 0 && byte != BOOT_FRAME_SOF)
+            continue;
+
+        boot_frame[boot_frame_idx++] = byte;
+
+        if (boot_frame_idx < BOOT_FRAME_HEADER_SIZE)
+            continue;
+
+        uint16_t len = (uint16_t)(boot_frame[4] | (boot_frame[5] << 8));
+
+        if (boot_frame[1] != BOOT_CMD_ENTER_BOOT || (len != 0 && len != BOOT_ENTER_MAX_PAYLOAD))
+        {
+            boot_frame_idx = 0;
+            continue;
+        }
+
+        if (boot_frame_idx < BOOT_FRAME_HEADER_SIZE + len + BOOT_FRAME_CRC_SIZE)
+            continue;
+
+        boot_frame_idx = 0;
+
+        if (boot_get_u32(&boot_frame[BOOT_FRAME_HEADER_SIZE + len]) !=
+            boot_mailbox_crc32(&boot_frame[1], BOOT_FRAME_HEADER_SIZE - 1 + len))
+            continue;
+
+        uint32_t baudrate = len ? boot_get_u32(&boot_frame[BOOT_FRAME_HEADER_SIZE]) : link->handle.Init.BaudRate;
+        uint16_t seq = (uint16_t)(boot_frame[2] | (boot_frame[3] << 8));
+
+        /*the bootloader sends ENTER_BOOT_OK*/
+        boot_mailbox_request(baudrate, seq, BOOT_MAILBOX_REPLY, 0);
+    }
+}
@@ -9,6 +9,7 @@
  * 
  */
 #include "uart_driver.h"
+#include <string.h>
 
 #define USE_UART1 
 #define USE_UART2 
@@ -44,6 +45,131 @@ extern void Error_Handler(void);
 #endif
 
 
+/**
+ * @brief Start transmission of the next pending data chunk.
+ * @note  A pending XON/XOFF always goes first, data waits while the peer
+ *        holds us paused. Must be called with uart interrupts masked or from
+ *        the uart interrupt itself.
+ */
+static void uart_tx_kick(uart_driver_t *driver)
+{
+    if (driver->handle.gState != HAL_UART_STATE_READY)
+        return;
+
+    if (driver->flow.ctrl_pending)
+    {
+        driver->flow.ctrl_byte = driver->flow.ctrl_pending;
+        driver->flow.ctrl_pending = 0;
+        HAL_UART_Transmit_IT(&driver->handle, &driver->flow.ctrl_byte, 1);
+        return;
+    }
+
+    if (driver->flow.tx_paused)
+        return;
+
+    /*check for pendings transfers */
+    uint16_t data_len = circular_buff_get_data_len(driver->data.tx.cb);
+
+    if (data_len)
+    {
+        data_len = (data_len >= MAX_DATA_CHUNK_SIZE) ? (MAX_DATA_CHUNK_SIZE - 1) : data_len;
+        circular_buff_read(driver->data.tx.cb, driver->data.tx.chunk, data_len);
+        HAL_UART_Transmit_IT(&driver->handle, driver->data.tx.chunk, data_len);
+    }
+}
+
+static void uart_flow_send(uart_driver_t *driver, uint8_t ctrl)
+{
+    driver->flow.ctrl_pending = ctrl;
+    uart_tx_kick(driver);
+}
+
+/**
+ * @brief Send XON once the rx ring drained below the low watermark
+ */
+static void uart_flow_rx_release(uart_driver_t *driver)
+{
+    if (!driver->flow.enabled || !driver->flow.rx_paused || driver->flow.hold)
+        return;
+
+    if (circular_buff_get_data_len(driver->data.rx.cb) <= driver->flow.low_watermark)
+    {
+        __disable_irq();
+        driver->flow.rx_paused = 0;
+        uart_flow_send(driver, UART_XON_CHAR);
+        __enable_irq();
+        uart_driver_dbg("comm driver info:\t xon sent\r\n");
+    }
+}
+
+/**
+ * @brief Consume XON/XOFF and escapes from the rx stream
+ * @return uint8_t 1 if byte is payload data, 0 if it was link control
+ */
+static uint8_t uart_flow_rx_filter(uart_driver_t *driver, uint8_t *byte)
+{
+    if (*byte == UART_XOFF_CHAR)
+    {
+        driver->flow.tx_paused = 1;
+        return 0;
+    }
+
+    if (*byte == UART_XON_CHAR)
+    {
+        driver->flow.tx_paused = 0;
+        uart_tx_kick(driver);
+        return 0;
+    }
+
+    if (driver->flow.binary)
+    {
+        if (driver->flow.rx_escaped)
+        {
+            driver->flow.rx_escaped = 0;
+            *byte ^= UART_ESC_MASK;
+        }
+        else if (*byte == UART_ESC_CHAR)
+        {
+            driver->flow.rx_escaped = 1;
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Write data in tx ring escaping bytes that collide with link control
+ */
+static circular_buff_st_t uart_write_tx_escaped(uart_driver_t *driver, uint8_t *data, uint8_t len)
+{
+    size_t wire_len = len;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] == UART_XON_CHAR || data[i] == UART_XOFF_CHAR || data[i] == UART_ESC_CHAR)
+            wire_len++;
+    }
+
+    if (circular_buff_get_free_space(driver->data.tx.cb) < wire_len)
+        return CIRCUILAR_BUFF_NOT_ENOUGH_SPACE;
+
+    for (uint8_t i = 0; i < len; i++)
+    {
+        if (data[i] == UART_XON_CHAR || data[i] == UART_XOFF_CHAR || data[i] == UART_ESC_CHAR)
+        {
+            circular_buff_put(driver->data.tx.cb, UART_ESC_CHAR);
+            circular_buff_put(driver->data.tx.cb, data[i] ^ UART_ESC_MASK);
+        }
+        else
+        {
+            circular_buff_put(driver->data.tx.cb, data[i]);
+        }
+    }
+
+    return CIRCULAR_BUFF_OK;
+}
+
 /**
  * @brief Init host comm peripheral interface
  * 
@@ -82,7 +208,7 @@ uint8_t uart_init_it(uart_driver_t *driver, uint8_t *rx_buff, uint16_t rx_len, u
     return 1;
 }
 
-uint8_t uart_get_rx_data_len(uart_driver_t *driver)
+uint16_t uart_get_rx_data_len(uart_driver_t *driver)
 {
     return circular_buff_get_data_len(driver->data.rx.cb);
 }
@@ -90,7 +216,9 @@ uint8_t uart_get_rx_data_len(uart_driver_t *driver)
 
 uint8_t uart_read_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len)
 {
-    return circular_buff_read(driver->data.rx.cb, data, len);
+    uint8_t status = circular_buff_read(driver->data.rx.cb, data, len);
+    uart_flow_rx_release(driver);
+    return status;
 }
 
 
@@ -103,6 +231,7 @@ uint8_t uart_fetch_rx_data(uart_driver_t *driver, uint8_t *data, uint8_t len)
 uint8_t uart_clear_rx_data(uart_driver_t *driver)
 {
     circular_buff_reset(driver->data.rx.cb);
+    uart_flow_rx_release(driver);
     return 1;
 }
 
@@ -113,20 +242,25 @@ uint8_t uart_transmit(uart_driver_t *driver, uint8_t *data, uint8_t len)
 
 uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len)
 {
+    circular_buff_st_t status;
+
     /* Write data to circular buffer */
-    if (circular_buff_write(driver->data.tx.cb, data, len) == CIRCULAR_BUFF_OK)
+    if (driver->flow.enabled && driver->flow.binary)
+        status = uart_write_tx_escaped(driver, data, len);
+    else
+        status = circular_buff_write(driver->data.tx.cb, data, len);
+
+    if (status == CIRCULAR_BUFF_OK)
     {
-        if (driver->handle.gState == HAL_UART_STATE_READY)
-        {
-            uint8_t byte;
-            circular_buff_get(driver->data.tx.cb, &byte);
-            HAL_UART_Transmit_IT(&driver->handle, &byte, 1);
-        }
-        else
+        if (driver->handle.gState != HAL_UART_STATE_READY)
         {
             uart_driver_dbg("comm driver warning:\t uart busy\r\n");
         }
 
+        __disable_irq();
+        uart_tx_kick(driver);
+        __enable_irq();
+
         return 1;
     }
 
@@ -136,7 +270,6 @@ uint8_t uart_transmit_it(uart_driver_t *driver, uint8_t *data, uint8_t len)
 
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-  static uint8_t data_chunk[MAX_DATA_CHUNK_SIZE];
   uart_driver_t *driver = NULL;
 
 #ifdef USE_UART1
@@ -153,15 +286,7 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 
   if(driver != NULL)
   {
-    /*check for pendings transfers */
-    uint16_t data_len = circular_buff_get_data_len(driver->data.tx.cb);
-
-    if(data_len)
-    {
-        data_len = (data_len >= MAX_DATA_CHUNK_SIZE ) ? (MAX_DATA_CHUNK_SIZE - 1) : data_len;
-        circular_buff_read(driver->data.tx.cb, data_chunk, data_len);
-        HAL_UART_Transmit_IT(&driver->handle, data_chunk, data_len);
-    }
+    uart_tx_kick(driver);
 
     uart_driver_dbg("comm driver info:\t irq uart tx complete\r\n");
   }
@@ -185,14 +310,73 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 
     if(driver != NULL)
     {
+        uint8_t byte = driver->data.rx.byte;
+
         /*Set Uart Data reception for next byte*/
         HAL_UART_Receive_IT(&driver->handle, &driver->data.rx.byte, 1);
 
-        if(circular_buff_write(driver->data.rx.cb, &driver->data.rx.byte, 1) !=  CIRCULAR_BUFF_OK)
+        if (driver->flow.enabled && !uart_flow_rx_filter(driver, &byte))
+            return;
+
+        if(circular_buff_write(driver->data.rx.cb, &byte, 1) !=  CIRCULAR_BUFF_OK)
         {
             /*Reinit ring buffer*/
             circular_buff_reset(driver->data.rx.cb);
         }
+
+        /*Ask the peer to stop before the ring overflows*/
+        if (driver->flow.enabled && !driver->flow.rx_paused &&
+            circular_buff_get_data_len(driver->data.rx.cb) >= driver->flow.high_watermark)
+        {
+            driver->flow.rx_paused = 1;
+            uart_flow_send(driver, UART_XOFF_CHAR);
+        }
+    }
+}
+
+/**
+ * @brief Enable in-band XON/XOFF flow control driven by rx ring watermarks
+ * 
+ * @param binary  escape XON/XOFF/ESC data bytes, required when payload is not text
+ * @param low_watermark  rx ring level at which XON is sent again
+ * @param high_watermark rx ring level at which XOFF is sent, leave room for
+ *                       the bytes the peer sends before it reacts
+ */
+void uart_flow_control_init(uart_driver_t *driver, uint8_t binary, uint16_t low_watermark, uint16_t high_watermark)
+{
+    __disable_irq();
+    memset(&driver->flow, 0, sizeof(uart_flow_t));
+    driver->flow.binary = binary;
+    driver->flow.low_watermark = low_watermark;
+    driver->flow.high_watermark = high_watermark;
+    driver->flow.enabled = 1;
+    __enable_irq();
+}
+
+/**
+ * @brief Pause the peer regardless of ring level, e.g. while flash is erased
+ *        and the rx interrupt cannot be served.
+ */
+void uart_flow_hold(uart_driver_t *driver, uint8_t hold)
+{
+    if (!driver->flow.enabled)
+        return;
+
+    driver->flow.hold = hold;
+
+    if (hold)
+    {
+        __disable_irq();
+        if (!driver->flow.rx_paused)
+        {
+            driver->flow.rx_paused = 1;
+            uart_flow_send(driver, UART_XOFF_CHAR);
+        }
+        __enable_irq();
+    }
+    else
+    {
+        uart_flow_rx_release(driver);
     }
 }
 
@@ -9,6 +9,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 #include "peripherals_init.h"
+#include "boot_mailbox.h"
 
 /* Private includes ----------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
@@ -23,6 +24,12 @@ void print_startup_message(void)
 	printf("Author:\t Bayron Cabrera \r\n");
 	printf("Board:\t STM32F0 - M0 \r\n");
 	printf("Date:\t %s\r\n", __DATE__);
+
+	/* started right after a download, no reset in between */
+	uint32_t handoff_us;
+	if (boot_mailbox_handoff(&handoff_us))
+		printf("Handoff: %lu us from DOWNLOAD_FINISHED\r\n", (unsigned long)handoff_us);
+
 	printf("**************************************\r\n");
 }
 
@@ -37,7 +44,8 @@ int main(void)
 
   while (1)
   {
-
+    /* uart2: gateway link, ENTER_BOOT_MODE resets into the bootloader */
+    boot_mailbox_poll(&uart2);
   }
 }
 
@@ -4,6 +4,7 @@
 /* Private function prototypes -----------------------------------------------*/
 static void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void vector_table_to_sram(void);
 extern void Error_Handler(void);
 
 /*UART driver */
@@ -22,6 +23,11 @@ uint8_t uart1_rx_buff[UART1_RX_DATA_BUFF_SIZE];
 uint8_t uart2_tx_buff[UART2_TX_DATA_BUFF_SIZE];
 uint8_t uart2_rx_buff[UART2_TX_DATA_BUFF_SIZE];
 
+/*App vector table in flash (startup), its copy at the start of SRAM (STM32F030CCTX_FLASH.ld) */
+extern const uint32_t g_pfnVectors[];
+extern uint32_t _sram_vector[];
+extern uint32_t _eram_vector[];
+
 /**
   * @brief System Clock Configuration
   * @retval None
@@ -107,8 +113,36 @@ static void MX_GPIO_Init(void)
 }
 
 
+/**
+  * @brief Take exceptions from the app vector table: the M0 has no VTOR and
+  *        fetches vectors at 0x00000000, the bootloader's table in flash.
+  *        Copied to SRAM and SRAM mapped at 0x00000000, vector reads are
+  *        then zero wait state too. Runs before HAL_Init() starts SysTick.
+  * @retval None
+  */
+static void vector_table_to_sram(void)
+{
+  uint32_t words = (uint32_t)(_eram_vector - _sram_vector);
+
+  __disable_irq();
+
+  for (uint32_t i = 0; i < words; i++)
+  {
+    _sram_vector[i] = g_pfnVectors[i];
+  }
+
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  __HAL_SYSCFG_REMAPMEMORY_SRAM();
+
+  __enable_irq();
+}
+
+
 void peripherals_init(void)
 {
+  /* App vectors, before any interrupt is enabled */
+  vector_table_to_sram();
+
   /* MCU Configuration--------------------------------------------------------*/
   HAL_Init();
 